@@ -0,0 +1,360 @@
+#include <stdlib.h>
+#include <string.h>
+#include "h/audio_stats.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#define HAVE_NEON_KERNEL 1
+#endif
+
+#define SEARCH_SPAN 64
+
+static void block_stats_scalar(const short *samples, size_t count, BlockStats *stats)
+{
+    int peak = 0;
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        int sample = samples[i];
+        int magnitude = abs(sample);
+        if (magnitude > peak)
+            peak = magnitude;
+        sum += (uint64_t)(sample * sample);
+    }
+
+    stats->peak = peak;
+    stats->sum_squares = sum;
+}
+
+static void deinterleave_stereo_scalar(const short *input, size_t frames, short *left, short *right)
+{
+    for (size_t i = 0; i < frames; i++)
+    {
+        left[i] = input[2 * i];
+        right[i] = input[2 * i + 1];
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+// Peak is taken as max(max, -min) so -32768 needs no saturating abs. The
+// pairwise products from madd can reach 2^31, so they are widened as unsigned.
+__attribute__((target("sse2"))) static void block_stats_sse2(const short *samples, size_t count, BlockStats *stats)
+{
+    __m128i vmax = _mm_setzero_si128();
+    __m128i vmin = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(samples + i));
+        vmax = _mm_max_epi16(vmax, x);
+        vmin = _mm_min_epi16(vmin, x);
+
+        __m128i sq = _mm_madd_epi16(x, x);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sq, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sq, zero));
+    }
+
+    short maxs[8], mins[8];
+    uint64_t sums[2];
+    _mm_storeu_si128((__m128i *)maxs, vmax);
+    _mm_storeu_si128((__m128i *)mins, vmin);
+    _mm_storeu_si128((__m128i *)sums, acc);
+
+    BlockStats tail;
+    block_stats_scalar(samples + i, count - i, &tail);
+
+    int peak = tail.peak;
+    for (int k = 0; k < 8; k++)
+    {
+        if (maxs[k] > peak)
+            peak = maxs[k];
+        if (-mins[k] > peak)
+            peak = -mins[k];
+    }
+
+    stats->peak = peak;
+    stats->sum_squares = sums[0] + sums[1] + tail.sum_squares;
+}
+
+__attribute__((target("avx2"))) static void block_stats_avx2(const short *samples, size_t count, BlockStats *stats)
+{
+    __m256i vmax = _mm256_setzero_si256();
+    __m256i vmin = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(samples + i));
+        vmax = _mm256_max_epi16(vmax, x);
+        vmin = _mm256_min_epi16(vmin, x);
+
+        __m256i sq = _mm256_madd_epi16(x, x);
+        acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(sq, zero));
+        acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(sq, zero));
+    }
+
+    // Fold to 128 bits before the horizontal reduction
+    __m128i max128 = _mm_max_epi16(_mm256_castsi256_si128(vmax), _mm256_extracti128_si256(vmax, 1));
+    __m128i min128 = _mm_min_epi16(_mm256_castsi256_si128(vmin), _mm256_extracti128_si256(vmin, 1));
+    __m128i acc128 = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+
+    short maxs[8], mins[8];
+    uint64_t sums[2];
+    _mm_storeu_si128((__m128i *)maxs, max128);
+    _mm_storeu_si128((__m128i *)mins, min128);
+    _mm_storeu_si128((__m128i *)sums, acc128);
+
+    BlockStats tail;
+    block_stats_scalar(samples + i, count - i, &tail);
+
+    int peak = tail.peak;
+    for (int k = 0; k < 8; k++)
+    {
+        if (maxs[k] > peak)
+            peak = maxs[k];
+        if (-mins[k] > peak)
+            peak = -mins[k];
+    }
+
+    stats->peak = peak;
+    stats->sum_squares = sums[0] + sums[1] + tail.sum_squares;
+}
+
+// Each 32-bit lane holds one L/R pair: sign-extending the low half gives left,
+// an arithmetic shift gives right, and packs never saturates the results.
+__attribute__((target("sse2"))) static void deinterleave_stereo_sse2(const short *input, size_t frames, short *left, short *right)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= frames; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(input + 2 * i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(input + 2 * i + 8));
+
+        __m128i l = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+        __m128i r = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+        _mm_storeu_si128((__m128i *)(left + i), l);
+        _mm_storeu_si128((__m128i *)(right + i), r);
+    }
+
+    deinterleave_stereo_scalar(input + 2 * i, frames - i, left + i, right + i);
+}
+
+// packs works per 128-bit lane, so the 64-bit quarters are put back in order
+__attribute__((target("avx2"))) static void deinterleave_stereo_avx2(const short *input, size_t frames, short *left, short *right)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= frames; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(input + 2 * i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(input + 2 * i + 16));
+
+        __m256i l = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16), _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16));
+        __m256i r = _mm256_packs_epi32(_mm256_srai_epi32(a, 16), _mm256_srai_epi32(b, 16));
+        _mm256_storeu_si256((__m256i *)(left + i), _mm256_permute4x64_epi64(l, 0xD8));
+        _mm256_storeu_si256((__m256i *)(right + i), _mm256_permute4x64_epi64(r, 0xD8));
+    }
+
+    for (; i < frames; i++)
+    {
+        left[i] = input[2 * i];
+        right[i] = input[2 * i + 1];
+    }
+}
+#endif
+
+#ifdef HAVE_NEON_KERNEL
+static void block_stats_neon(const short *samples, size_t count, BlockStats *stats)
+{
+    int16x8_t vmax = vdupq_n_s16(0);
+    int16x8_t vmin = vdupq_n_s16(0);
+    int64x2_t acc = vdupq_n_s64(0);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        int16x8_t x = vld1q_s16(samples + i);
+        vmax = vmaxq_s16(vmax, x);
+        vmin = vminq_s16(vmin, x);
+
+        acc = vpadalq_s32(acc, vmull_s16(vget_low_s16(x), vget_low_s16(x)));
+        acc = vpadalq_s32(acc, vmull_s16(vget_high_s16(x), vget_high_s16(x)));
+    }
+
+    short maxs[8], mins[8];
+    int64_t sums[2];
+    vst1q_s16(maxs, vmax);
+    vst1q_s16(mins, vmin);
+    vst1q_s64(sums, acc);
+
+    BlockStats tail;
+    block_stats_scalar(samples + i, count - i, &tail);
+
+    int peak = tail.peak;
+    for (int k = 0; k < 8; k++)
+    {
+        if (maxs[k] > peak)
+            peak = maxs[k];
+        if (-mins[k] > peak)
+            peak = -mins[k];
+    }
+
+    stats->peak = peak;
+    stats->sum_squares = (uint64_t)(sums[0] + sums[1]) + tail.sum_squares;
+}
+
+static void deinterleave_stereo_neon(const short *input, size_t frames, short *left, short *right)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= frames; i += 8)
+    {
+        int16x8x2_t pair = vld2q_s16(input + 2 * i);
+        vst1q_s16(left + i, pair.val[0]);
+        vst1q_s16(right + i, pair.val[1]);
+    }
+
+    deinterleave_stereo_scalar(input + 2 * i, frames - i, left + i, right + i);
+}
+
+static int neon_supported(void)
+{
+#if defined(__aarch64__)
+    return 1;
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+}
+#endif
+
+static block_stats_fn active_kernel = block_stats_scalar;
+static const char *active_name = "scalar";
+static deinterleave_stereo_fn active_deinterleave = deinterleave_stereo_scalar;
+
+int block_stats_variants(BlockStatsVariant *variants, int max_variants)
+{
+    int n = 0;
+
+    if (n < max_variants)
+        variants[n++] = (BlockStatsVariant){"scalar", block_stats_scalar};
+
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (n < max_variants && __builtin_cpu_supports("sse2"))
+        variants[n++] = (BlockStatsVariant){"sse2", block_stats_sse2};
+    if (n < max_variants && __builtin_cpu_supports("avx2"))
+        variants[n++] = (BlockStatsVariant){"avx2", block_stats_avx2};
+#endif
+
+#ifdef HAVE_NEON_KERNEL
+    if (n < max_variants && neon_supported())
+        variants[n++] = (BlockStatsVariant){"neon", block_stats_neon};
+#endif
+
+    return n;
+}
+
+int deinterleave_variants(DeinterleaveVariant *variants, int max_variants)
+{
+    int n = 0;
+
+    if (n < max_variants)
+        variants[n++] = (DeinterleaveVariant){"scalar", deinterleave_stereo_scalar};
+
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (n < max_variants && __builtin_cpu_supports("sse2"))
+        variants[n++] = (DeinterleaveVariant){"sse2", deinterleave_stereo_sse2};
+    if (n < max_variants && __builtin_cpu_supports("avx2"))
+        variants[n++] = (DeinterleaveVariant){"avx2", deinterleave_stereo_avx2};
+#endif
+
+#ifdef HAVE_NEON_KERNEL
+    if (n < max_variants && neon_supported())
+        variants[n++] = (DeinterleaveVariant){"neon", deinterleave_stereo_neon};
+#endif
+
+    return n;
+}
+
+// Picks the widest kernels the running CPU supports
+void audio_stats_init(void)
+{
+    BlockStatsVariant variants[4];
+    int n = block_stats_variants(variants, 4);
+
+    active_kernel = variants[n - 1].fn;
+    active_name = variants[n - 1].name;
+
+    DeinterleaveVariant splitters[4];
+    n = deinterleave_variants(splitters, 4);
+    active_deinterleave = splitters[n - 1].fn;
+}
+
+const char *block_stats_backend(void)
+{
+    return active_name;
+}
+
+void block_stats(const short *samples, size_t count, BlockStats *stats)
+{
+    active_kernel(samples, count, stats);
+}
+
+// Index of the first sample whose magnitude exceeds threshold, or -1. Spans
+// are rejected with the vector kernel; only the hit span is scanned per sample.
+long block_find_first_above(const short *samples, size_t count, int threshold)
+{
+    for (size_t start = 0; start < count; start += SEARCH_SPAN)
+    {
+        size_t n = count - start < SEARCH_SPAN ? count - start : SEARCH_SPAN;
+
+        BlockStats stats;
+        active_kernel(samples + start, n, &stats);
+        if (stats.peak <= threshold)
+            continue;
+
+        for (size_t i = start; i < start + n; i++)
+        {
+            if (abs(samples[i]) > threshold)
+                return (long)i;
+        }
+    }
+    return -1;
+}
+
+void deinterleave(const short *input, size_t frames, int channels, short *const *outputs)
+{
+    if (channels == 1)
+    {
+        memcpy(outputs[0], input, frames * sizeof(short));
+        return;
+    }
+    if (channels == 2)
+    {
+        active_deinterleave(input, frames, outputs[0], outputs[1]);
+        return;
+    }
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        for (int c = 0; c < channels; c++)
+            outputs[c][i] = input[i * channels + c];
+    }
+}
@@ -0,0 +1,628 @@
+// Microbenchmarks for the signal-processing kernels used by the recorder.
+//
+//   gcc -O2 -o benchmark benchmark.c audio_stats.c fft.c vad.c resampler.c wav_codec.c flac.c dsp.c spectrogram.c config.c -lm -lpthread
+//   ./benchmark [name]
+//
+// Without an argument every benchmark is run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "h/audio_stats.h"
+#include "h/vad.h"
+#include "h/resampler.h"
+#include "h/wav_codec.h"
+#include "h/flac.h"
+#include "h/dsp.h"
+#include "h/spectrogram.h"
+#include "h/config.h"
+
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_TARGET_SAMPLES (64L * 1024 * 1024)
+
+static volatile uint64_t bench_sink;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Speech-like test signal: a few harmonics with slow amplitude modulation and noise
+static void fill_test_signal(short *samples, size_t count)
+{
+    srand(1);
+    for (size_t i = 0; i < count; i++)
+    {
+        double t = (double)i / BENCH_SAMPLE_RATE;
+        double envelope = 0.5 + 0.5 * sin(2 * M_PI * 3 * t);
+        double v = envelope * (6000 * sin(2 * M_PI * 220 * t) + 3000 * sin(2 * M_PI * 660 * t) + 1500 * sin(2 * M_PI * 1320 * t));
+        v += (rand() % 2001) - 1000;
+        samples[i] = (short)v;
+    }
+}
+
+static void bench_block_stats(void)
+{
+    static const size_t chunk_sizes[] = {256, 512, 1024, 2048, 4096};
+    size_t max_chunk = chunk_sizes[sizeof(chunk_sizes) / sizeof(chunk_sizes[0]) - 1];
+
+    short *samples = malloc(max_chunk * sizeof(short));
+    if (!samples)
+        return;
+    fill_test_signal(samples, max_chunk);
+    samples[max_chunk / 3] = -32768;
+
+    BlockStatsVariant variants[4];
+    int n = block_stats_variants(variants, 4);
+    audio_stats_init();
+
+    printf("== block_stats (peak + sum of squares), runtime pick: %s ==\n", block_stats_backend());
+    printf("%-8s", "variant");
+    for (size_t c = 0; c < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); c++)
+        printf("  %8zu", chunk_sizes[c]);
+    printf("   (ns/frame per CHUNK_SIZE)\n");
+
+    for (int v = 0; v < n; v++)
+    {
+        printf("%-8s", variants[v].name);
+        for (size_t c = 0; c < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); c++)
+        {
+            size_t chunk = chunk_sizes[c];
+            BlockStats reference, stats;
+            variants[0].fn(samples, chunk, &reference);
+            variants[v].fn(samples, chunk, &stats);
+            if (stats.peak != reference.peak || stats.sum_squares != reference.sum_squares)
+            {
+                printf("  %8s", "MISMATCH");
+                continue;
+            }
+
+            long iterations = BENCH_TARGET_SAMPLES / chunk;
+            double start = now_ns();
+            for (long i = 0; i < iterations; i++)
+            {
+                variants[v].fn(samples, chunk, &stats);
+                bench_sink += stats.sum_squares + stats.peak;
+            }
+            double elapsed = now_ns() - start;
+            printf("  %8.3f", elapsed / ((double)iterations * chunk));
+        }
+        printf("\n");
+    }
+
+    free(samples);
+}
+
+static void bench_deinterleave(void)
+{
+    const size_t chunk = 1024;
+
+    short *input = malloc(2 * chunk * sizeof(short));
+    short *left = malloc(chunk * sizeof(short));
+    short *right = malloc(chunk * sizeof(short));
+    short *ref_left = malloc(chunk * sizeof(short));
+    short *ref_right = malloc(chunk * sizeof(short));
+    if (!input || !left || !right || !ref_left || !ref_right)
+    {
+        free(input);
+        free(left);
+        free(right);
+        free(ref_left);
+        free(ref_right);
+        return;
+    }
+    fill_test_signal(input, 2 * chunk);
+
+    DeinterleaveVariant variants[4];
+    int n = deinterleave_variants(variants, 4);
+    variants[0].fn(input, chunk, ref_left, ref_right);
+
+    printf("== stereo deinterleave, %zu-frame callbacks ==\n", chunk);
+    printf("%-8s  %10s\n", "variant", "ns/frame");
+
+    for (int v = 0; v < n; v++)
+    {
+        variants[v].fn(input, chunk, left, right);
+        if (memcmp(left, ref_left, chunk * sizeof(short)) != 0 || memcmp(right, ref_right, chunk * sizeof(short)) != 0)
+        {
+            printf("%-8s  %10s\n", variants[v].name, "MISMATCH");
+            continue;
+        }
+
+        long iterations = BENCH_TARGET_SAMPLES / chunk;
+        double start = now_ns();
+        for (long i = 0; i < iterations; i++)
+        {
+            variants[v].fn(input, chunk, left, right);
+            bench_sink += left[i % chunk] + right[i % chunk];
+        }
+        double elapsed = now_ns() - start;
+        printf("%-8s  %10.3f\n", variants[v].name, elapsed / ((double)iterations * chunk));
+    }
+
+    free(input);
+    free(left);
+    free(right);
+    free(ref_left);
+    free(ref_right);
+}
+
+static void bench_vad(void)
+{
+    const size_t chunk = 1024;
+    const size_t total = 60 * BENCH_SAMPLE_RATE;
+
+    short *samples = malloc(total * sizeof(short));
+    if (!samples)
+        return;
+    fill_test_signal(samples, total);
+    audio_stats_init();
+
+    VadConfig config = {
+        .sample_rate = BENCH_SAMPLE_RATE,
+        .amplitude_threshold = 300,
+        .open_db = 12,
+        .close_db = 6,
+        .max_flatness = 0.5,
+        .hang_frames = 2 * BENCH_SAMPLE_RATE,
+        .min_voice_frames = BENCH_SAMPLE_RATE * 3 / 10,
+    };
+
+    printf("== voice detectors, 60 s of audio in %zu-frame blocks ==\n", chunk);
+    printf("%-10s  %10s  %12s  %8s\n", "backend", "ns/frame", "% real time", "voiced");
+
+    for (int b = 0; b < vad_backend_count(); b++)
+    {
+        VoiceDetector vad;
+        if (vad_init(&vad, vad_backend_at(b), &config) != 0)
+            continue;
+
+        size_t voiced = 0;
+        double start = now_ns();
+        for (size_t i = 0; i + chunk <= total; i += chunk)
+        {
+            BlockStats stats;
+            block_stats(samples + i, chunk, &stats);
+            voiced += vad_process(&vad, samples + i, chunk, &stats) ? chunk : 0;
+        }
+        double elapsed = now_ns() - start;
+
+        printf("%-10s  %10.3f  %12.4f  %7.1f%%\n",
+               vad.backend->name,
+               elapsed / total,
+               100.0 * elapsed / (total * 1e9 / BENCH_SAMPLE_RATE),
+               100.0 * voiced / total);
+        vad_destroy(&vad);
+    }
+
+    free(samples);
+}
+
+static double kaiser_window(double beta, double r)
+{
+    double x = beta * sqrt(1 - r * r);
+    double i0 = 1, term = 1, i0_beta = 1, term_beta = 1;
+    for (int k = 1; k < 60; k++)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        term_beta *= (beta / (2 * k)) * (beta / (2 * k));
+        i0 += term;
+        i0_beta += term_beta;
+    }
+    return i0 / i0_beta;
+}
+
+// Direct windowed-sinc interpolation in double precision, evaluated at
+// every output instant with a much longer kernel. Slow, but a good yardstick.
+static size_t reference_resample(const short *input, size_t frames, int in_rate, int out_rate, double delay, double *output)
+{
+    const int zero_crossings = 64;
+    const double beta = 10.0;
+    double ratio = in_rate > out_rate ? (double)in_rate / out_rate : 1.0;
+    double cutoff = 0.42 / ratio;
+    double half_width = zero_crossings * ratio;
+
+    size_t count = (size_t)((double)frames * out_rate / in_rate);
+    for (size_t n = 0; n < count; n++)
+    {
+        double t = (double)n * in_rate / out_rate - delay;
+        long first = (long)ceil(t - half_width);
+        long last = (long)floor(t + half_width);
+        double sum = 0;
+        for (long k = first; k <= last; k++)
+        {
+            if (k < 0 || k >= (long)frames)
+                continue;
+            double d = t - k;
+            double sinc = d == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * d) / (M_PI * d);
+            double r = d / half_width;
+            sum += input[k] * sinc * kaiser_window(beta, r);
+        }
+        output[n] = sum;
+    }
+    return count;
+}
+
+// Voice-band tones only, so the comparison is not dominated by how each
+// filter treats the transition band
+static void fill_voice_band(short *samples, size_t count)
+{
+    static const double tones[] = {310, 740, 1180, 1930, 2430, 2950};
+    for (size_t i = 0; i < count; i++)
+    {
+        double v = 0;
+        for (size_t k = 0; k < sizeof(tones) / sizeof(tones[0]); k++)
+            v += 3000 * sin(2 * M_PI * tones[k] * i / BENCH_SAMPLE_RATE + k);
+        samples[i] = (short)v;
+    }
+}
+
+static void bench_resampler(void)
+{
+    static const int out_rates[] = {16000, 8000};
+    const size_t total = 4 * BENCH_SAMPLE_RATE;
+    const size_t chunk = 1024;
+
+    short *input = malloc(total * sizeof(short));
+    short *output = malloc((total + 64) * sizeof(short));
+    double *reference = malloc(total * sizeof(double));
+    if (!input || !output || !reference)
+    {
+        free(input);
+        free(output);
+        free(reference);
+        return;
+    }
+    fill_test_signal(input, total);
+
+    printf("== resampler, %d Hz input in %zu-frame blocks ==\n", BENCH_SAMPLE_RATE, chunk);
+    printf("speed on speech-like audio, SNR on voice-band tones, rejection of a tone at 0.55x the output rate\n");
+    printf("%-7s  %6s  %10s  %10s  %12s  %10s  %12s\n",
+           "rate", "taps", "ns/frame", "x realtime", "ref ns/frame", "SNR vs ref", "alias reject");
+
+    for (size_t r = 0; r < sizeof(out_rates) / sizeof(out_rates[0]); r++)
+    {
+        int out_rate = out_rates[r];
+        Resampler resampler;
+        if (resampler_init(&resampler, BENCH_SAMPLE_RATE, out_rate) != 0)
+            continue;
+
+        const int passes = 8;
+        size_t produced = 0;
+        double start = now_ns();
+        for (int pass = 0; pass < passes; pass++)
+        {
+            resampler_reset(&resampler);
+            produced = 0;
+            for (size_t i = 0; i < total; i += chunk)
+                produced += resampler_process(&resampler, input + i, total - i < chunk ? total - i : chunk, output + produced);
+        }
+        double elapsed = (now_ns() - start) / passes;
+
+        // The reference is evaluated with the same group delay so the two line up
+        double delay = (resampler.up * resampler.taps - 1) / (2.0 * resampler.up);
+        fill_voice_band(input, total);
+        resampler_reset(&resampler);
+        produced = 0;
+        for (size_t i = 0; i < total; i += chunk)
+            produced += resampler_process(&resampler, input + i, total - i < chunk ? total - i : chunk, output + produced);
+
+        start = now_ns();
+        size_t count = reference_resample(input, total, BENCH_SAMPLE_RATE, out_rate, delay, reference);
+        double ref_elapsed = now_ns() - start;
+
+        double signal = 0, error = 0;
+        size_t skip = (size_t)out_rate / 10;
+        for (size_t i = skip; i < count && i < produced; i++)
+        {
+            signal += reference[i] * reference[i];
+            error += (output[i] - reference[i]) * (output[i] - reference[i]);
+        }
+
+        // A full-scale tone just above the new Nyquist frequency should vanish
+        for (size_t i = 0; i < total; i++)
+            input[i] = (short)(16000 * sin(2 * M_PI * (out_rate * 0.55) * i / BENCH_SAMPLE_RATE));
+        resampler_reset(&resampler);
+        size_t alias_count = 0;
+        for (size_t i = 0; i < total; i += chunk)
+            alias_count += resampler_process(&resampler, input + i, total - i < chunk ? total - i : chunk, output + alias_count);
+        double alias = 0;
+        for (size_t i = skip; i < alias_count; i++)
+            alias += (double)output[i] * output[i];
+        // Floored at the rounding noise of a 16-bit sample
+        alias = fmax(sqrt(alias / (alias_count - skip)), 1 / sqrt(12));
+        fill_test_signal(input, total);
+
+        printf("%5d  %6zu  %10.3f  %10.0f  %12.1f  %7.1f dB  %9.1f dB\n",
+               out_rate,
+               resampler.taps,
+               elapsed / total,
+               (total * 1e9 / BENCH_SAMPLE_RATE) / elapsed,
+               ref_elapsed / total,
+               10 * log10(signal / (error + 1e-9)),
+               20 * log10(16000 / sqrt(2) / alias));
+        resampler_free(&resampler);
+    }
+
+    free(input);
+    free(output);
+    free(reference);
+}
+
+static double snr_db(const short *reference, const short *decoded, size_t count)
+{
+    double signal = 0, error = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        double d = reference[i] - decoded[i];
+        signal += (double)reference[i] * reference[i];
+        error += d * d;
+    }
+    return error > 0 ? 10 * log10(signal / error) : INFINITY;
+}
+
+static void bench_wav_codecs(void)
+{
+    const size_t total = 10 * 16000;
+    const size_t block_align = 512;
+    const size_t spb = ima_adpcm_samples_per_block(block_align);
+    const size_t blocks = total / spb;
+
+    short *input = malloc(total * sizeof(short));
+    short *decoded = malloc(total * sizeof(short));
+    uint8_t *encoded = malloc(total);
+    if (!input || !decoded || !encoded)
+    {
+        free(input);
+        free(decoded);
+        free(encoded);
+        return;
+    }
+    fill_test_signal(input, total);
+
+    printf("== WAV codecs, 10 s of 16 kHz audio ==\n");
+    printf("%-10s  %8s  %12s  %12s  %10s\n", "codec", "ratio", "enc ns/smp", "dec ns/smp", "SNR");
+
+    const int passes = 20;
+    double start = now_ns();
+    for (int pass = 0; pass < passes; pass++)
+    {
+        mulaw_encode(input, total, encoded);
+        bench_sink += encoded[pass];
+    }
+    double encode_ns = (now_ns() - start) / passes;
+    start = now_ns();
+    for (int pass = 0; pass < passes; pass++)
+    {
+        mulaw_decode(encoded, total, decoded);
+        bench_sink += decoded[pass];
+    }
+    double decode_ns = (now_ns() - start) / passes;
+    printf("%-10s  %7.1fx  %12.3f  %12.3f  %7.1f dB\n", "mulaw", 2.0, encode_ns / total, decode_ns / total, snr_db(input, decoded, total));
+
+    start = now_ns();
+    for (int pass = 0; pass < passes; pass++)
+    {
+        ImaAdpcmState state = {0};
+        for (size_t b = 0; b < blocks; b++)
+            ima_adpcm_encode_block(&state, input + b * spb, spb, encoded + b * block_align);
+        bench_sink += encoded[pass];
+    }
+    encode_ns = (now_ns() - start) / passes;
+    start = now_ns();
+    for (int pass = 0; pass < passes; pass++)
+    {
+        for (size_t b = 0; b < blocks; b++)
+            ima_adpcm_decode_block(encoded + b * block_align, spb, decoded + b * spb);
+        bench_sink += decoded[pass];
+    }
+    decode_ns = (now_ns() - start) / passes;
+    printf("%-10s  %7.1fx  %12.3f  %12.3f  %7.1f dB\n", "ima_adpcm",
+           (double)(blocks * spb * 2) / (blocks * block_align),
+           encode_ns / (blocks * spb), decode_ns / (blocks * spb), snr_db(input, decoded, blocks * spb));
+
+    free(input);
+    free(decoded);
+    free(encoded);
+}
+
+static void bench_flac(void)
+{
+    const size_t total = 60 * 16000;
+    short *input = malloc(total * sizeof(short));
+    if (!input)
+        return;
+    fill_test_signal(input, total);
+
+    const char *path = "/tmp/benchmark.flac";
+    printf("== FLAC, 60 s of 16 kHz audio ==\n");
+    printf("%-8s  %8s  %12s  %12s\n", "threads", "ratio", "ms", "x realtime");
+
+    for (int threads = 1; threads <= flac_default_threads() + 1 && threads <= FLAC_MAX_THREADS; threads++)
+    {
+        FlacStats stats;
+        if (flac_encode(input, total, 16000, threads, path, &stats) != 0)
+            break;
+        printf("%-8d  %7.1f%%  %12.2f  %12.0f\n", stats.threads,
+               100.0 * stats.output_bytes / stats.input_bytes,
+               stats.encode_seconds * 1000,
+               stats.encode_seconds > 0 ? 60 / stats.encode_seconds : 0);
+    }
+    remove(path);
+    free(input);
+}
+
+static double tone_level_db(const float *samples, size_t count)
+{
+    double sum = 0;
+    for (size_t i = 0; i < count; i++)
+        sum += (double)samples[i] * samples[i];
+    return 10 * log10(sum / count + 1e-30);
+}
+
+static void bench_dsp(void)
+{
+    const int rate = 16000;
+    const size_t tone_frames = rate;
+    static const double tones[] = {67.0, 88.5, 100.0, 150.0, 250.0, 300.0, 500.0, 1000.0, 3000.0};
+    float *tone = malloc(tone_frames * sizeof(float));
+    if (!tone)
+        return;
+
+    printf("== DSP chain at %d Hz ==\n", rate);
+    printf("%-8s  %14s  %20s\n", "tone Hz", "high-pass 300", "+ notch 88.5 Hz");
+    for (size_t t = 0; t < sizeof(tones) / sizeof(tones[0]); t++)
+    {
+        double gain[2];
+        for (int variant = 0; variant < 2; variant++)
+        {
+            BiquadCascade cascade;
+            biquad_cascade_design(&cascade, rate, 300, variant ? 88.5 : 0);
+            for (size_t i = 0; i < tone_frames; i++)
+                tone[i] = (float)(10000 * sin(2 * M_PI * tones[t] * i / rate));
+            biquad_cascade_process(&cascade, tone, tone_frames);
+            // Skip the filter's settling time
+            gain[variant] = tone_level_db(tone + tone_frames / 2, tone_frames / 2) - 20 * log10(10000 / sqrt(2));
+        }
+        printf("%-8.1f  %11.1f dB  %17.1f dB\n", tones[t], gain[0], gain[1]);
+    }
+    free(tone);
+
+    const size_t total = 60 * (size_t)rate;
+    const size_t block = 1600;
+    short *input = malloc(total * sizeof(short));
+    short *work = malloc(total * sizeof(short));
+    if (!input || !work)
+    {
+        free(input);
+        free(work);
+        return;
+    }
+    // Voice-band tones with a CTCSS tone underneath; the first half 18 dB
+    // quieter than the second. The AGC should bring both halves to target.
+    srand(1);
+    for (size_t i = 0; i < total; i++)
+    {
+        double t = (double)i / rate;
+        double envelope = (i < total / 2 ? 0.125 : 1.0) * (0.6 + 0.4 * sin(2 * M_PI * 3 * t));
+        double v = envelope * (4000 * sin(2 * M_PI * 500 * t) + 2000 * sin(2 * M_PI * 1100 * t) + (rand() % 801 - 400));
+        input[i] = (short)(v + 1500 * sin(2 * M_PI * 88.5 * t));
+    }
+
+    DSP_HIGHPASS_HZ = 300;
+    DSP_NOTCH_HZ = 88.5;
+    DSP_AGC = true;
+    DspChain dsp;
+    if (dsp_chain_init(&dsp, rate, block) != 0)
+    {
+        free(input);
+        free(work);
+        return;
+    }
+    memcpy(work, input, total * sizeof(short));
+    for (size_t done = 0; done < total; done += block)
+        dsp_chain_process(&dsp, work + done, total - done < block ? total - done : block);
+
+    double quiet = 0, loud = 0;
+    int peak = 0;
+    for (size_t i = total / 4; i < total / 2; i++)
+        quiet += (double)work[i] * work[i];
+    for (size_t i = total * 3 / 4; i < total; i++)
+        loud += (double)work[i] * work[i];
+    for (size_t i = 0; i < total; i++)
+        peak = abs(work[i]) > peak ? abs(work[i]) : peak;
+
+    printf("\nAGC target %d dBFS: quiet input -> %.1f dBFS, loud input -> %.1f dBFS, peak %.1f dBFS\n",
+           DSP_AGC_TARGET_DBFS,
+           10 * log10(quiet / (total / 4)) - 20 * log10(32768),
+           10 * log10(loud / (total / 4)) - 20 * log10(32768),
+           20 * log10(peak / 32768.0));
+    printf("%-10s  %10s  %14s\n", "stage", "ns/sample", "% of one core");
+    printf("%-10s  %10.2f  %13.3f%%\n", "filters", (double)dsp.filter_ns / total, dsp_cpu_percent(&dsp, dsp.filter_ns));
+    printf("%-10s  %10.2f  %13.3f%%\n", "agc", (double)dsp.agc_ns / total, dsp_cpu_percent(&dsp, dsp.agc_ns));
+
+    dsp_chain_free(&dsp);
+    free(input);
+    free(work);
+}
+
+static void bench_spectrogram(void)
+{
+    static const struct
+    {
+        int rate;
+        int seconds;
+    } cases[] = {{16000, 10}, {16000, 60}, {16000, 300}, {48000, 60}};
+
+    const char *path = "/tmp/benchmark_spectrogram.png";
+    printf("== Spectrogram (FFT + PNG render) ==\n");
+    printf("%-6s  %6s  %6s  %7s  %9s  %9s  %9s  %12s  %7s\n",
+           "rate", "audio", "fft", "frames", "image", "fft ms", "render ms", "ms per min", "KB");
+
+    FftPlan plan;
+    memset(&plan, 0, sizeof(plan));
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        size_t count = (size_t)cases[c].rate * cases[c].seconds;
+        short *input = malloc(count * sizeof(short));
+        if (!input)
+            break;
+        fill_test_signal(input, count);
+
+        SpectrogramStats stats;
+        int result = spectrogram_write(&plan, input, count, cases[c].rate, path, &stats);
+        free(input);
+        if (result != 0)
+            break;
+
+        char image[32];
+        snprintf(image, sizeof(image), "%dx%d", stats.width, stats.height);
+        double total_ms = (stats.fft_seconds + stats.render_seconds) * 1000;
+        printf("%-6d  %5ds  %6zu  %7zu  %9s  %9.1f  %9.1f  %12.1f  %7zu\n",
+               cases[c].rate, cases[c].seconds, stats.fft_size, stats.frames, image,
+               stats.fft_seconds * 1000, stats.render_seconds * 1000,
+               total_ms * 60 / cases[c].seconds, stats.png_bytes / 1024);
+    }
+    fft_plan_free(&plan);
+    printf("Last image kept at %s\n", path);
+}
+
+typedef struct
+{
+    const char *name;
+    void (*run)(void);
+} Benchmark;
+
+static const Benchmark benchmarks[] = {
+    {"block_stats", bench_block_stats},
+    {"deinterleave", bench_deinterleave},
+    {"vad", bench_vad},
+    {"resampler", bench_resampler},
+    {"wav_codecs", bench_wav_codecs},
+    {"flac", bench_flac},
+    {"dsp", bench_dsp},
+    {"spectrogram", bench_spectrogram},
+};
+
+int main(int argc, char **argv)
+{
+    int ran = 0;
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+    {
+        if (argc > 1 && strcmp(argv[1], benchmarks[i].name) != 0)
+            continue;
+        benchmarks[i].run();
+        ran++;
+    }
+
+    if (!ran)
+    {
+        fprintf(stderr, "Unknown benchmark: %s\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
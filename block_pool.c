@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "h/block_pool.h"
+
+int block_pool_init(BlockPool *pool, size_t block_frames, size_t budget_bytes)
+{
+    memset(pool, 0, sizeof(*pool));
+
+    size_t stride = sizeof(AudioBlock) + block_frames * sizeof(short);
+    stride = (stride + BLOCK_ALIGNMENT - 1) & ~(size_t)(BLOCK_ALIGNMENT - 1);
+
+    size_t count = budget_bytes / stride;
+    if (block_frames == 0 || count == 0)
+    {
+        fprintf(stderr, "Block pool budget of %zu bytes cannot hold a %zu-frame block\n", budget_bytes, block_frames);
+        return -1;
+    }
+
+    if (posix_memalign((void **)&pool->memory, BLOCK_ALIGNMENT, count * stride) != 0)
+    {
+        pool->memory = NULL;
+        return -1;
+    }
+
+    pool->block_frames = block_frames;
+    pool->block_stride = stride;
+    pool->block_count = count;
+
+    // Thread the free list back to front so blocks are handed out in address order
+    for (size_t i = count; i-- > 0;)
+    {
+        AudioBlock *block = (AudioBlock *)(pool->memory + i * stride);
+        block->next = pool->free_list;
+        block->used = 0;
+        pool->free_list = block;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    return 0;
+}
+
+void block_pool_destroy(BlockPool *pool)
+{
+    if (!pool->memory)
+        return;
+
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->memory);
+    memset(pool, 0, sizeof(*pool));
+}
+
+AudioBlock *block_pool_acquire(BlockPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+
+    AudioBlock *block = pool->free_list;
+    if (block)
+    {
+        pool->free_list = block->next;
+        pool->in_use++;
+        if (pool->in_use > pool->high_water)
+            pool->high_water = pool->in_use;
+        block->next = NULL;
+        block->used = 0;
+    }
+    else
+    {
+        pool->exhausted_count++;
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return block;
+}
+
+void block_pool_release(BlockPool *pool, AudioBlock *block)
+{
+    if (!block)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    block->next = pool->free_list;
+    pool->free_list = block;
+    pool->in_use--;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void block_pool_stats(BlockPool *pool, size_t *in_use, size_t *high_water, unsigned long *exhausted_count)
+{
+    pthread_mutex_lock(&pool->lock);
+    if (in_use)
+        *in_use = pool->in_use;
+    if (high_water)
+        *high_water = pool->high_water;
+    if (exhausted_count)
+        *exhausted_count = pool->exhausted_count;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Detaches the oldest block; the caller returns it to the pool when done.
+AudioBlock *block_chain_pop(BlockChain *chain)
+{
+    AudioBlock *block = chain->head;
+    if (!block)
+        return NULL;
+
+    chain->head = block->next;
+    if (!chain->head)
+        chain->tail = NULL;
+    chain->frames -= block->used;
+    chain->blocks--;
+    block->next = NULL;
+    return block;
+}
+
+// Returns the number of frames stored. A short count means the pool is
+// exhausted and the caller should cut the segment.
+size_t block_chain_append(BlockChain *chain, BlockPool *pool, const short *src, size_t count)
+{
+    size_t written = 0;
+
+    while (written < count)
+    {
+        AudioBlock *tail = chain->tail;
+        if (!tail || tail->used == pool->block_frames)
+        {
+            AudioBlock *block = block_pool_acquire(pool);
+            if (!block)
+                break;
+
+            if (tail)
+                tail->next = block;
+            else
+                chain->head = block;
+            chain->tail = block;
+            chain->blocks++;
+            tail = block;
+        }
+
+        size_t space = pool->block_frames - tail->used;
+        size_t n = count - written < space ? count - written : space;
+        memcpy(tail->samples + tail->used, src + written, n * sizeof(short));
+        tail->used += n;
+        written += n;
+    }
+
+    chain->frames += written;
+    return written;
+}
+
+// Shortens the chain to its first `frames` frames, returning whole trailing
+// blocks to the pool.
+void block_chain_truncate(BlockChain *chain, BlockPool *pool, size_t frames)
+{
+    if (frames >= chain->frames)
+        return;
+
+    if (frames == 0)
+    {
+        block_chain_release(chain, pool);
+        return;
+    }
+
+    size_t kept = 0;
+    size_t blocks = 0;
+    AudioBlock *block = chain->head;
+    while (kept + block->used < frames)
+    {
+        kept += block->used;
+        blocks++;
+        block = block->next;
+    }
+
+    block->used = frames - kept;
+    blocks++;
+
+    AudioBlock *rest = block->next;
+    block->next = NULL;
+    chain->tail = block;
+    chain->frames = frames;
+    chain->blocks = blocks;
+
+    while (rest)
+    {
+        AudioBlock *next = rest->next;
+        block_pool_release(pool, rest);
+        rest = next;
+    }
+}
+
+void block_chain_release(BlockChain *chain, BlockPool *pool)
+{
+    AudioBlock *block = chain->head;
+    while (block)
+    {
+        AudioBlock *next = block->next;
+        block_pool_release(pool, block);
+        block = next;
+    }
+
+    chain->head = NULL;
+    chain->tail = NULL;
+    chain->frames = 0;
+    chain->blocks = 0;
+}
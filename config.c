@@ -18,9 +18,46 @@ char REPO_BRANCH[64] = "";
 int AMPLITUDE_THRESHOLD = 0;
 int CHUNK_SIZE = 0;
 bool LIVE_LISTEN = false;
+char MONITOR_DEVICE[128] = "";
+int MONITOR_LATENCY_MS = 60;
 char EXTRA_TEXT[64] = "";
 int SILENCE_THRESHOLD = 0;
 int REMOVE_LAST_SECONDS = 0;
+int RECORDING_BLOCK_FRAMES = 4800;
+int RECORDING_MEMORY_MB = 64;
+int PREROLL_MS = 1000;
+int MAX_SEGMENT_SECONDS = 300;
+int SEGMENT_SEARCH_SECONDS = 10;
+int RECORDING_SAMPLE_RATE = 16000;
+char VAD_MODE[16] = "peak";
+int VAD_OPEN_DB = 12;
+int VAD_CLOSE_DB = 6;
+double VAD_MAX_FLATNESS = 0.5;
+int VAD_MIN_VOICE_MS = 300;
+bool VAD_COMPARE = false;
+char UPLOAD_FORMAT[16] = "opus";
+int OPUS_BITRATE = 16000;
+char WAV_FORMAT[16] = "pcm";
+char ARCHIVE_DIRECTORY[256] = "";
+int FLAC_THREADS = 0;
+bool OFFLINE_FLAC = true;
+int DSP_HIGHPASS_HZ = 0;
+double DSP_NOTCH_HZ = 0;
+bool DSP_AGC = false;
+int DSP_AGC_TARGET_DBFS = -18;
+int DSP_AGC_MAX_GAIN_DB = 20;
+double DSP_LIMIT_DBFS = -1;
+char SPECTROGRAM_DIRECTORY[256] = "";
+int SPECTROGRAM_THREADS = 1;
+bool SPECTROGRAM_TELEGRAM = false;
+int CALLBACK_BUDGET_PERCENT = 50;
+char JOURNAL_DIRECTORY[256] = "";
+int JOURNAL_MB = 32;
+int JOURNAL_SYNC_MS = 1000;
+int UPLOAD_WORKERS = 2;
+bool MOVE_FSYNC = true;
+InputConfig INPUTS[MAX_INPUTS];
+int INPUT_COUNT = 0;
 
 void free_chat_ids()
 {
@@ -105,17 +142,73 @@ static int parse_int(const char *str)
     return atoi(str);
 }
 
-int load_env(const char *filename)
+static double parse_double(const char *str)
 {
-    FILE *file = fopen(filename, "r");
-    if (!file)
+    return atof(str);
+}
+
+// Handles INPUT_<n>_<FIELD>, n counting from 1
+static void parse_input_key(const char *key, const char *value)
+{
+    char *field;
+    long n = strtol(key + strlen("INPUT_"), &field, 10);
+    if (n < 1 || n > MAX_INPUTS || *field != '_')
+        return;
+
+    InputConfig *input = &INPUTS[n - 1];
+    field++;
+
+    if (strcmp(field, "DEVICE") == 0)
     {
-        perror("Failed to open env file");
-        return 1;
+        strncpy(input->device, value, sizeof(input->device) - 1);
+        input->device[sizeof(input->device) - 1] = '\0';
+    }
+    else if (strcmp(field, "CHANNEL") == 0)
+    {
+        input->channel = parse_int(value);
+    }
+    else if (strcmp(field, "COM_PORT") == 0)
+    {
+        strncpy(input->com_port, value, sizeof(input->com_port) - 1);
+        input->com_port[sizeof(input->com_port) - 1] = '\0';
+    }
+    else if (strcmp(field, "THRESHOLD") == 0)
+    {
+        input->amplitude_threshold = parse_int(value);
+    }
+    else if (strcmp(field, "PREFIX") == 0)
+    {
+        strncpy(input->prefix, value, sizeof(input->prefix) - 1);
+        input->prefix[sizeof(input->prefix) - 1] = '\0';
     }
+}
 
-    char line[512];
-    while (fgets(line, sizeof(line), file))
+// Packs the inputs that name a device to the front of INPUTS
+static void finish_inputs(void)
+{
+    INPUT_COUNT = 0;
+    for (int i = 0; i < MAX_INPUTS; i++)
+    {
+        if (INPUTS[i].device[0] == '\0')
+            continue;
+
+        InputConfig input = INPUTS[i];
+        if (input.amplitude_threshold <= 0)
+            input.amplitude_threshold = AMPLITUDE_THRESHOLD;
+        if (input.channel <= 0)
+            input.channel = 1;
+        INPUTS[INPUT_COUNT++] = input;
+    }
+
+    for (int i = INPUT_COUNT; i < MAX_INPUTS; i++)
+        memset(&INPUTS[i], 0, sizeof(INPUTS[i]));
+}
+
+// Reads the next KEY=value line into line, with key and value trimmed and
+// the value unquoted. Returns 0 at the end of the file.
+static int read_env_entry(FILE *file, char *line, size_t size, char **key, char **value)
+{
+    while (fgets(line, size, file))
     {
         if (line[0] == '#' || line[0] == '\n')
             continue;
@@ -125,19 +218,38 @@ int load_env(const char *filename)
             continue;
 
         *equals = 0;
-        char *key = line;
-        char *value = equals + 1;
+        *key = line;
+        *value = equals + 1;
 
-        trim(key);
-        trim(value);
+        trim(*key);
+        trim(*value);
 
-        size_t len = strlen(value);
-        if (len >= 2 && value[0] == '"' && value[len - 1] == '"')
+        size_t len = strlen(*value);
+        if (len >= 2 && (*value)[0] == '"' && (*value)[len - 1] == '"')
         {
-            value[len - 1] = 0;
-            memmove(value, value + 1, len - 1);
+            (*value)[len - 1] = 0;
+            memmove(*value, *value + 1, len - 1);
         }
+        return 1;
+    }
+    return 0;
+}
 
+int load_env(const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    if (!file)
+    {
+        perror("Failed to open env file");
+        return 1;
+    }
+
+    memset(INPUTS, 0, sizeof(INPUTS));
+
+    char line[512];
+    char *key, *value;
+    while (read_env_entry(file, line, sizeof(line), &key, &value))
+    {
         if (strcmp(key, "BOT_TOKEN") == 0)
         {
             strncpy(BOT_TOKEN, value, sizeof(BOT_TOKEN) - 1);
@@ -190,6 +302,15 @@ int load_env(const char *filename)
         {
             LIVE_LISTEN = parse_bool(value);
         }
+        else if (strcmp(key, "MONITOR_DEVICE") == 0)
+        {
+            strncpy(MONITOR_DEVICE, value, sizeof(MONITOR_DEVICE) - 1);
+            MONITOR_DEVICE[sizeof(MONITOR_DEVICE) - 1] = '\0';
+        }
+        else if (strcmp(key, "MONITOR_LATENCY_MS") == 0)
+        {
+            MONITOR_LATENCY_MS = parse_int(value);
+        }
         else if (strcmp(key, "EXTRA_TEXT") == 0)
         {
             strncpy(EXTRA_TEXT, value, sizeof(EXTRA_TEXT) - 1);
@@ -203,11 +324,192 @@ int load_env(const char *filename)
         {
             REMOVE_LAST_SECONDS = parse_int(value);
         }
+        else if (strcmp(key, "RECORDING_BLOCK_FRAMES") == 0)
+        {
+            RECORDING_BLOCK_FRAMES = parse_int(value);
+        }
+        else if (strcmp(key, "RECORDING_MEMORY_MB") == 0)
+        {
+            RECORDING_MEMORY_MB = parse_int(value);
+        }
+        else if (strcmp(key, "PREROLL_MS") == 0)
+        {
+            PREROLL_MS = parse_int(value);
+        }
+        else if (strcmp(key, "MAX_SEGMENT_SECONDS") == 0)
+        {
+            MAX_SEGMENT_SECONDS = parse_int(value);
+        }
+        else if (strcmp(key, "SEGMENT_SEARCH_SECONDS") == 0)
+        {
+            SEGMENT_SEARCH_SECONDS = parse_int(value);
+        }
+        else if (strcmp(key, "RECORDING_SAMPLE_RATE") == 0)
+        {
+            RECORDING_SAMPLE_RATE = parse_int(value);
+        }
+        else if (strcmp(key, "VAD_MODE") == 0)
+        {
+            strncpy(VAD_MODE, value, sizeof(VAD_MODE) - 1);
+            VAD_MODE[sizeof(VAD_MODE) - 1] = '\0';
+        }
+        else if (strcmp(key, "VAD_OPEN_DB") == 0)
+        {
+            VAD_OPEN_DB = parse_int(value);
+        }
+        else if (strcmp(key, "VAD_CLOSE_DB") == 0)
+        {
+            VAD_CLOSE_DB = parse_int(value);
+        }
+        else if (strcmp(key, "VAD_MAX_FLATNESS") == 0)
+        {
+            VAD_MAX_FLATNESS = parse_double(value);
+        }
+        else if (strcmp(key, "VAD_MIN_VOICE_MS") == 0)
+        {
+            VAD_MIN_VOICE_MS = parse_int(value);
+        }
+        else if (strcmp(key, "VAD_COMPARE") == 0)
+        {
+            VAD_COMPARE = parse_bool(value);
+        }
+        else if (strcmp(key, "UPLOAD_FORMAT") == 0)
+        {
+            strncpy(UPLOAD_FORMAT, value, sizeof(UPLOAD_FORMAT) - 1);
+            UPLOAD_FORMAT[sizeof(UPLOAD_FORMAT) - 1] = '\0';
+        }
+        else if (strcmp(key, "OPUS_BITRATE") == 0)
+        {
+            OPUS_BITRATE = parse_int(value);
+        }
+        else if (strcmp(key, "ARCHIVE_DIRECTORY") == 0)
+        {
+            strncpy(ARCHIVE_DIRECTORY, value, sizeof(ARCHIVE_DIRECTORY) - 1);
+            ARCHIVE_DIRECTORY[sizeof(ARCHIVE_DIRECTORY) - 1] = '\0';
+        }
+        else if (strcmp(key, "FLAC_THREADS") == 0)
+        {
+            FLAC_THREADS = parse_int(value);
+        }
+        else if (strcmp(key, "DSP_HIGHPASS_HZ") == 0)
+        {
+            DSP_HIGHPASS_HZ = parse_int(value);
+        }
+        else if (strcmp(key, "DSP_NOTCH_HZ") == 0)
+        {
+            DSP_NOTCH_HZ = parse_double(value);
+        }
+        else if (strcmp(key, "DSP_AGC") == 0)
+        {
+            DSP_AGC = parse_bool(value);
+        }
+        else if (strcmp(key, "DSP_AGC_TARGET_DBFS") == 0)
+        {
+            DSP_AGC_TARGET_DBFS = parse_int(value);
+        }
+        else if (strcmp(key, "DSP_AGC_MAX_GAIN_DB") == 0)
+        {
+            DSP_AGC_MAX_GAIN_DB = parse_int(value);
+        }
+        else if (strcmp(key, "DSP_LIMIT_DBFS") == 0)
+        {
+            DSP_LIMIT_DBFS = parse_double(value);
+        }
+        else if (strcmp(key, "SPECTROGRAM_DIRECTORY") == 0)
+        {
+            strncpy(SPECTROGRAM_DIRECTORY, value, sizeof(SPECTROGRAM_DIRECTORY) - 1);
+            SPECTROGRAM_DIRECTORY[sizeof(SPECTROGRAM_DIRECTORY) - 1] = '\0';
+        }
+        else if (strcmp(key, "SPECTROGRAM_THREADS") == 0)
+        {
+            SPECTROGRAM_THREADS = parse_int(value);
+        }
+        else if (strcmp(key, "SPECTROGRAM_TELEGRAM") == 0)
+        {
+            SPECTROGRAM_TELEGRAM = parse_bool(value);
+        }
+        else if (strcmp(key, "CALLBACK_BUDGET_PERCENT") == 0)
+        {
+            CALLBACK_BUDGET_PERCENT = parse_int(value);
+        }
+        else if (strcmp(key, "JOURNAL_DIRECTORY") == 0)
+        {
+            strncpy(JOURNAL_DIRECTORY, value, sizeof(JOURNAL_DIRECTORY) - 1);
+            JOURNAL_DIRECTORY[sizeof(JOURNAL_DIRECTORY) - 1] = '\0';
+        }
+        else if (strcmp(key, "JOURNAL_MB") == 0)
+        {
+            JOURNAL_MB = parse_int(value);
+        }
+        else if (strcmp(key, "JOURNAL_SYNC_MS") == 0)
+        {
+            JOURNAL_SYNC_MS = parse_int(value);
+        }
+        else if (strcmp(key, "UPLOAD_WORKERS") == 0)
+        {
+            UPLOAD_WORKERS = parse_int(value);
+        }
+        else if (strcmp(key, "MOVE_FSYNC") == 0)
+        {
+            MOVE_FSYNC = parse_bool(value);
+        }
+        else if (strcmp(key, "OFFLINE_FLAC") == 0)
+        {
+            OFFLINE_FLAC = parse_bool(value);
+        }
+        else if (strcmp(key, "WAV_FORMAT") == 0)
+        {
+            strncpy(WAV_FORMAT, value, sizeof(WAV_FORMAT) - 1);
+            WAV_FORMAT[sizeof(WAV_FORMAT) - 1] = '\0';
+        }
+        else if (strncmp(key, "INPUT_", strlen("INPUT_")) == 0)
+        {
+            parse_input_key(key, value);
+        }
     }
 
     fclose(file);
 
+    finish_inputs();
     parse_chat_id_array(CHAT_ID);
 
+    return 0;
+}
+
+// Re-reads only what the senders use, so .env edits reach the next upload.
+// Everything else is read once at startup: the recorder, encoder and
+// journal threads use it without a lock.
+int load_telegram_env(const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    if (!file)
+    {
+        perror("Failed to open env file");
+        return 1;
+    }
+
+    char line[512];
+    char *key, *value;
+    while (read_env_entry(file, line, sizeof(line), &key, &value))
+    {
+        if (strcmp(key, "BOT_TOKEN") == 0)
+        {
+            strncpy(BOT_TOKEN, value, sizeof(BOT_TOKEN) - 1);
+            BOT_TOKEN[sizeof(BOT_TOKEN) - 1] = '\0';
+        }
+        else if (strcmp(key, "CHAT_ID") == 0)
+        {
+            strncpy(CHAT_ID, value, sizeof(CHAT_ID) - 1);
+            CHAT_ID[sizeof(CHAT_ID) - 1] = '\0';
+        }
+        else if (strcmp(key, "EXTRA_TEXT") == 0)
+        {
+            strncpy(EXTRA_TEXT, value, sizeof(EXTRA_TEXT) - 1);
+            EXTRA_TEXT[sizeof(EXTRA_TEXT) - 1] = '\0';
+        }
+    }
+    fclose(file);
+
+    parse_chat_id_array(CHAT_ID);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "h/dsp.h"
+#include "h/config.h"
+
+typedef int dsp_v4si __attribute__((vector_size(16)));
+
+// Filter state below this is flushed to zero, so a long silence never leaves
+// the cascade computing on denormals
+#define DSP_DENORMAL_LIMIT 1e-15f
+// Mean-square window of the level detector, and how fast the level gain may
+// fall and rise towards what it asks for
+#define DSP_AGC_LEVEL_MS 100
+#define DSP_AGC_ATTACK_MS 10
+#define DSP_AGC_RELEASE_MS 1000
+#define DSP_GAIN_RELEASE_MS 50
+#define DSP_GATE_DBFS -50.0
+
+static uint64_t elapsed_ns(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (uint64_t)((end.tv_sec - start->tv_sec) * 1000000000LL + (end.tv_nsec - start->tv_nsec));
+}
+
+static float db_to_amplitude(double db)
+{
+    return (float)pow(10.0, db / 20.0);
+}
+
+// Per-sample smoothing coefficient for a time constant in milliseconds
+static float smoothing(int sample_rate, double ms)
+{
+    return (float)(1.0 - exp(-1000.0 / (ms * sample_rate)));
+}
+
+typedef struct
+{
+    double b0, b1, b2, a1, a2;
+} Biquad;
+
+// RBJ cookbook high-pass, normalised by a0
+static Biquad highpass(int sample_rate, double hz, double q)
+{
+    double w0 = 2 * M_PI * hz / sample_rate;
+    double alpha = sin(w0) / (2 * q);
+    double a0 = 1 + alpha;
+    Biquad f = {(1 + cos(w0)) / 2 / a0, -(1 + cos(w0)) / a0, (1 + cos(w0)) / 2 / a0, -2 * cos(w0) / a0, (1 - alpha) / a0};
+    return f;
+}
+
+static Biquad notch(int sample_rate, double hz, double q)
+{
+    double w0 = 2 * M_PI * hz / sample_rate;
+    double alpha = sin(w0) / (2 * q);
+    double a0 = 1 + alpha;
+    Biquad f = {1 / a0, -2 * cos(w0) / a0, 1 / a0, -2 * cos(w0) / a0, (1 - alpha) / a0};
+    return f;
+}
+
+// The high-pass is a Butterworth of twice as many poles as it has sections:
+// eighth order alone, or sixth order when the last section is the notch.
+void biquad_cascade_design(BiquadCascade *cascade, int sample_rate, double highpass_hz, double notch_hz)
+{
+    Biquad sections[DSP_SECTIONS];
+    for (int k = 0; k < DSP_SECTIONS; k++)
+        sections[k] = (Biquad){1, 0, 0, 0, 0};
+
+    int highpass_sections = notch_hz > 0 ? DSP_SECTIONS - 1 : DSP_SECTIONS;
+    if (highpass_hz > 0)
+    {
+        int order = 2 * highpass_sections;
+        for (int k = 0; k < highpass_sections; k++)
+        {
+            double q = 1.0 / (2 * cos(M_PI * (2 * k + 1) / (2.0 * order)));
+            sections[k] = highpass(sample_rate, highpass_hz, q);
+        }
+    }
+    if (notch_hz > 0)
+        sections[DSP_SECTIONS - 1] = notch(sample_rate, notch_hz, DSP_NOTCH_Q);
+
+    memset(cascade, 0, sizeof(*cascade));
+    for (int k = 0; k < DSP_SECTIONS; k++)
+    {
+        cascade->b0[k] = (float)sections[k].b0;
+        cascade->b1[k] = (float)sections[k].b1;
+        cascade->b2[k] = (float)sections[k].b2;
+        cascade->a1[k] = (float)sections[k].a1;
+        cascade->a2[k] = (float)sections[k].a2;
+    }
+}
+
+static dsp_v4sf flush_denormals(dsp_v4sf v)
+{
+    dsp_v4si tiny = (v > -DSP_DENORMAL_LIMIT) & (v < DSP_DENORMAL_LIMIT);
+    return (dsp_v4sf)((dsp_v4si)v & ~tiny);
+}
+
+// Transposed direct form II in every lane. Each step shifts the previous
+// outputs up one lane and feeds the new sample into lane 0, so the value
+// leaving lane 3 is the input from three samples earlier, fully filtered.
+void biquad_cascade_process(BiquadCascade *cascade, float *samples, size_t count)
+{
+    const dsp_v4si shift = {4, 0, 1, 2};
+    dsp_v4sf b0 = cascade->b0, b1 = cascade->b1, b2 = cascade->b2;
+    dsp_v4sf a1 = cascade->a1, a2 = cascade->a2;
+    dsp_v4sf z1 = cascade->z1, z2 = cascade->z2, y = cascade->y;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        dsp_v4sf x = {samples[i], samples[i], samples[i], samples[i]};
+        dsp_v4sf in = __builtin_shuffle(y, x, shift);
+        y = b0 * in + z1;
+        z1 = b1 * in - a1 * y + z2;
+        z2 = b2 * in - a2 * y;
+        samples[i] = y[3];
+    }
+
+    cascade->z1 = flush_denormals(z1);
+    cascade->z2 = flush_denormals(z2);
+    cascade->y = flush_denormals(y);
+}
+
+static int agc_init(Agc *agc, int sample_rate)
+{
+    memset(agc, 0, sizeof(*agc));
+    agc->lookahead = (size_t)sample_rate * DSP_AGC_LOOKAHEAD_MS / 1000;
+    if (agc->lookahead < 1)
+        agc->lookahead = 1;
+
+    agc->delay = calloc(agc->lookahead, sizeof(float));
+    agc->peak_position = malloc((agc->lookahead + 1) * sizeof(uint64_t));
+    agc->peak_value = malloc((agc->lookahead + 1) * sizeof(float));
+    if (!agc->delay || !agc->peak_position || !agc->peak_value)
+        return -1;
+
+    agc->target_rms = 32768.0f * db_to_amplitude(DSP_AGC_TARGET_DBFS);
+    agc->max_gain = db_to_amplitude(DSP_AGC_MAX_GAIN_DB);
+    agc->ceiling = 32767.0f * db_to_amplitude(DSP_LIMIT_DBFS);
+    float gate = 32768.0f * db_to_amplitude(DSP_GATE_DBFS);
+    agc->gate_power = gate * gate;
+    agc->level = smoothing(sample_rate, DSP_AGC_LEVEL_MS);
+    agc->attack = smoothing(sample_rate, DSP_AGC_ATTACK_MS);
+    agc->release = smoothing(sample_rate, DSP_AGC_RELEASE_MS);
+    // Fast enough to reach a peak's gain well inside the look-ahead window
+    agc->gain_attack = (float)(1.0 - exp(-6.0 / agc->lookahead));
+    agc->gain_release = smoothing(sample_rate, DSP_GAIN_RELEASE_MS);
+    agc->level_gain = 1.0f;
+    agc->gain = 1.0f;
+    return 0;
+}
+
+static void agc_free(Agc *agc)
+{
+    free(agc->delay);
+    free(agc->peak_position);
+    free(agc->peak_value);
+    agc->delay = NULL;
+    agc->peak_position = NULL;
+    agc->peak_value = NULL;
+}
+
+static void agc_reset(Agc *agc)
+{
+    memset(agc->delay, 0, agc->lookahead * sizeof(float));
+    agc->delay_pos = 0;
+    agc->peak_head = 0;
+    agc->peak_count = 0;
+    agc->position = 0;
+    agc->envelope = 0;
+    agc->level_gain = 1.0f;
+    agc->gain = 1.0f;
+}
+
+static void agc_process(Agc *agc, float *samples, size_t count)
+{
+    size_t window = agc->lookahead + 1;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        float x = samples[i];
+        float magnitude = fabsf(x);
+
+        // Speech level of the incoming samples; the gain only changes while
+        // there is signal above the gate, so noise is not pumped up in pauses
+        agc->envelope += (x * x - agc->envelope) * agc->level;
+        if (agc->envelope > agc->gate_power)
+        {
+            float wanted = agc->target_rms / sqrtf(agc->envelope);
+            if (wanted > agc->max_gain)
+                wanted = agc->max_gain;
+            agc->level_gain += (wanted - agc->level_gain) * (wanted < agc->level_gain ? agc->attack : agc->release);
+        }
+
+        // Sliding maximum of |x| over the samples still in the look-ahead
+        while (agc->peak_count > 0 && agc->peak_value[(agc->peak_head + agc->peak_count - 1) % window] <= magnitude)
+            agc->peak_count--;
+        size_t tail = (agc->peak_head + agc->peak_count) % window;
+        agc->peak_position[tail] = agc->position;
+        agc->peak_value[tail] = magnitude;
+        agc->peak_count++;
+        if (agc->peak_position[agc->peak_head] + window <= agc->position)
+        {
+            agc->peak_head = (agc->peak_head + 1) % window;
+            agc->peak_count--;
+        }
+        float peak = agc->peak_value[agc->peak_head];
+        agc->position++;
+
+        float target = agc->level_gain;
+        if (peak * target > agc->ceiling)
+            target = agc->ceiling / peak;
+        agc->gain += (target - agc->gain) * (target < agc->gain ? agc->gain_attack : agc->gain_release);
+
+        float delayed = agc->delay[agc->delay_pos];
+        agc->delay[agc->delay_pos] = x;
+        agc->delay_pos = (agc->delay_pos + 1) % agc->lookahead;
+
+        float y = delayed * agc->gain;
+        if (y > agc->ceiling)
+            y = agc->ceiling;
+        if (y < -agc->ceiling)
+            y = -agc->ceiling;
+        samples[i] = y;
+    }
+}
+
+int dsp_chain_init(DspChain *dsp, int sample_rate, size_t max_block)
+{
+    memset(dsp, 0, sizeof(*dsp));
+    dsp->sample_rate = sample_rate;
+    dsp->filters_enabled = DSP_HIGHPASS_HZ > 0 || DSP_NOTCH_HZ > 0;
+    dsp->agc_enabled = DSP_AGC;
+    if (!dsp_chain_enabled(dsp))
+        return 0;
+
+    biquad_cascade_design(&dsp->filters, sample_rate, DSP_HIGHPASS_HZ, DSP_NOTCH_HZ);
+    dsp->work_size = max_block;
+    dsp->work = malloc(max_block * sizeof(float));
+    if (!dsp->work || (dsp->agc_enabled && agc_init(&dsp->agc, sample_rate) != 0))
+    {
+        dsp_chain_free(dsp);
+        return -1;
+    }
+    return 0;
+}
+
+void dsp_chain_free(DspChain *dsp)
+{
+    agc_free(&dsp->agc);
+    free(dsp->work);
+    dsp->work = NULL;
+}
+
+// Called at the start of each transmission so no tail of the previous one
+// leaks in through the filter state or the look-ahead
+void dsp_chain_reset(DspChain *dsp)
+{
+    dsp->filters.z1 = (dsp_v4sf){0, 0, 0, 0};
+    dsp->filters.z2 = (dsp_v4sf){0, 0, 0, 0};
+    dsp->filters.y = (dsp_v4sf){0, 0, 0, 0};
+    if (dsp->agc_enabled)
+        agc_reset(&dsp->agc);
+}
+
+int dsp_chain_enabled(const DspChain *dsp)
+{
+    return dsp->filters_enabled || dsp->agc_enabled;
+}
+
+void dsp_chain_process(DspChain *dsp, short *samples, size_t count)
+{
+    if (!dsp_chain_enabled(dsp))
+        return;
+
+    for (size_t done = 0; done < count;)
+    {
+        size_t n = count - done;
+        if (n > dsp->work_size)
+            n = dsp->work_size;
+
+        for (size_t i = 0; i < n; i++)
+            dsp->work[i] = samples[done + i];
+
+        struct timespec start;
+        if (dsp->filters_enabled)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            biquad_cascade_process(&dsp->filters, dsp->work, n);
+            dsp->filter_ns += elapsed_ns(&start);
+        }
+        if (dsp->agc_enabled)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            agc_process(&dsp->agc, dsp->work, n);
+            dsp->agc_ns += elapsed_ns(&start);
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            float v = dsp->work[i];
+            samples[done + i] = (short)lrintf(v > 32767.0f ? 32767.0f : v < -32768.0f ? -32768.0f : v);
+        }
+        done += n;
+    }
+    dsp->frames += count;
+}
+
+size_t dsp_chain_delay(const DspChain *dsp)
+{
+    size_t delay = 0;
+    if (dsp->filters_enabled)
+        delay += DSP_SECTIONS - 1;
+    if (dsp->agc_enabled)
+        delay += dsp->agc.lookahead;
+    return delay;
+}
+
+// Feeds silence through the chain to push out the samples it still holds
+size_t dsp_chain_flush(DspChain *dsp, short *out, size_t size)
+{
+    if (!dsp_chain_enabled(dsp))
+        return 0;
+
+    size_t count = dsp_chain_delay(dsp);
+    if (count > size)
+        count = size;
+    memset(out, 0, count * sizeof(short));
+    dsp_chain_process(dsp, out, count);
+    // Not audio, so it stays out of the CPU share
+    dsp->frames -= count;
+    return count;
+}
+
+// Share of real time spent in a stage, for the audio processed so far
+double dsp_cpu_percent(const DspChain *dsp, uint64_t ns)
+{
+    if (dsp->frames == 0)
+        return 0;
+    double audio_ns = (double)dsp->frames * 1e9 / dsp->sample_rate;
+    return 100.0 * ns / audio_ns;
+}
@@ -0,0 +1,433 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <opusenc.h>
+#include "h/encoder.h"
+#include "h/flac.h"
+#include "h/spectrogram.h"
+#include "h/upload_queue.h"
+#include "h/write_wav_file.h"
+#include "h/config.h"
+
+typedef struct
+{
+    char part_path[1040];
+    char final_path[1024];
+    // Set when the upload was already encoded live and only the archive and
+    // spectrogram are left
+    int archive_only;
+    RecordingInfo info;
+} EncodeJob;
+
+static EncodeJob queue[ENCODER_QUEUE_SIZE];
+static size_t queue_head;
+static size_t queue_count;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+static pthread_t encoder_thread;
+static int encoder_running;
+
+static double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static long file_size(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+// <dir>/<name>.wav -> <dir>/<name><extension>
+static void replace_extension(const char *path, const char *extension, char *out, size_t size)
+{
+    size_t base_len = strlen(path);
+    if (base_len > 4 && strcmp(path + base_len - 4, ".wav") == 0)
+        base_len -= 4;
+    snprintf(out, size, "%.*s%s", (int)base_len, path, extension);
+}
+
+static int flac_threads(void)
+{
+    return FLAC_THREADS > 0 ? FLAC_THREADS : flac_default_threads();
+}
+
+static void report_flac(const char *path, const FlacStats *stats)
+{
+    double audio_seconds = stats->sample_rate > 0 ? (double)stats->samples / stats->sample_rate : 0;
+    printf("[FLAC] %s | Audio: %.2fs | Encode: %.3fs on %d thread(s) (%.0fx real time) | Size: %zu KB -> %zu KB (%.1f%%)\n",
+           path,
+           audio_seconds,
+           stats->encode_seconds,
+           stats->threads,
+           stats->encode_seconds > 0 ? audio_seconds / stats->encode_seconds : 0,
+           stats->input_bytes / 1024,
+           stats->output_bytes / 1024,
+           stats->input_bytes > 0 ? 100.0 * stats->output_bytes / stats->input_bytes : 0);
+}
+
+// Encodes to <path>.part and renames it into place, so watchers never see a
+// half-written file. With info set the file is an upload and is queued.
+static int write_flac(const short *samples, size_t count, int sample_rate, const char *path, const RecordingInfo *info)
+{
+    char part[1040];
+    snprintf(part, sizeof(part), "%s%s", path, WAV_PART_SUFFIX);
+
+    FlacStats stats;
+    if (flac_encode(samples, count, sample_rate, flac_threads(), part, &stats) != 0 ||
+        upload_queue_publish(part, path, info) != 0)
+    {
+        fprintf(stderr, "Failed to write %s\n", path);
+        remove(part);
+        return -1;
+    }
+    report_flac(path, &stats);
+    return 0;
+}
+
+static OggOpusEnc *open_opus(const char *opus_path, int sample_rate, int bitrate, OggOpusComments **comments)
+{
+    *comments = ope_comments_create();
+    if (!*comments)
+        return NULL;
+
+    int error;
+    OggOpusEnc *encoder = ope_encoder_create_file(opus_path, *comments, sample_rate, 1, 0, &error);
+    if (!encoder)
+    {
+        fprintf(stderr, "Failed to create %s: %s\n", opus_path, ope_strerror(error));
+        ope_comments_destroy(*comments);
+        *comments = NULL;
+        return NULL;
+    }
+
+    ope_encoder_ctl(encoder, OPUS_SET_BITRATE(bitrate));
+    ope_encoder_ctl(encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+    return encoder;
+}
+
+int encode_opus(const short *samples, size_t count, int sample_rate, const char *opus_path, int bitrate)
+{
+    OggOpusComments *comments;
+    OggOpusEnc *encoder = open_opus(opus_path, sample_rate, bitrate, &comments);
+    if (!encoder)
+        return -1;
+
+    int error = ope_encoder_write(encoder, samples, (int)count);
+    if (error == OPE_OK)
+        error = ope_encoder_drain(encoder);
+    if (error != OPE_OK)
+        fprintf(stderr, "Failed to encode %s: %s\n", opus_path, ope_strerror(error));
+
+    ope_encoder_destroy(encoder);
+    ope_comments_destroy(comments);
+    return error == OPE_OK ? 0 : -1;
+}
+
+static int upload_opus(const EncodeJob *job, const short *samples, size_t count, int sample_rate)
+{
+    char opus_path[1024], opus_part[1040];
+    replace_extension(job->final_path, ".opus", opus_path, sizeof(opus_path));
+    snprintf(opus_part, sizeof(opus_part), "%s%s", opus_path, WAV_PART_SUFFIX);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (encode_opus(samples, count, sample_rate, opus_part, OPUS_BITRATE) != 0)
+    {
+        remove(opus_part);
+        return -1;
+    }
+    double encode_seconds = elapsed_seconds(&start);
+    double audio_seconds = (double)count / sample_rate;
+
+    long wav_bytes = file_size(job->part_path);
+    long opus_bytes = file_size(opus_part);
+
+    if (upload_queue_publish(opus_part, opus_path, &job->info) != 0)
+    {
+        remove(opus_part);
+        return -1;
+    }
+
+    printf("[ENCODE] %s | Audio: %.2fs | Encode: %.3fs (%.1f ms per second) | Size: %ld KB -> %ld KB (%.1fx)\n",
+           opus_path,
+           audio_seconds,
+           encode_seconds,
+           audio_seconds > 0 ? encode_seconds * 1000 / audio_seconds : 0,
+           wav_bytes / 1024,
+           opus_bytes / 1024,
+           opus_bytes > 0 ? (double)wav_bytes / opus_bytes : 0);
+    return 0;
+}
+
+static void archive_recording(const EncodeJob *job, const short *samples, size_t count, int sample_rate)
+{
+    const char *name = strrchr(job->final_path, '/');
+    name = name ? name + 1 : job->final_path;
+
+    // Leaves room for .wav to become .flac
+    char archive_path[1024];
+    int length = snprintf(archive_path, sizeof(archive_path), "%s/%s", ARCHIVE_DIRECTORY, name);
+    if (length < 0 || (size_t)length + 1 >= sizeof(archive_path))
+    {
+        fprintf(stderr, "Archive path for %s is too long, not archiving it\n", name);
+        return;
+    }
+    replace_extension(archive_path, ".flac", archive_path, sizeof(archive_path));
+
+    mkdir(ARCHIVE_DIRECTORY, 0700);
+    write_flac(samples, count, sample_rate, archive_path, NULL);
+}
+
+static void encode_job(const EncodeJob *job)
+{
+    size_t count;
+    int sample_rate;
+    short *samples = wav_file_read(job->part_path, &count, &sample_rate);
+    if (!samples || sample_rate <= 0)
+    {
+        fprintf(stderr, "Failed to read %s for encoding\n", job->part_path);
+        free(samples);
+        // Upload the WAV rather than lose the recording
+        if (job->archive_only)
+            remove(job->part_path);
+        else
+            upload_queue_publish(job->part_path, job->final_path, &job->info);
+        return;
+    }
+
+    double audio_seconds = (double)count / sample_rate;
+    if (audio_seconds < MIN_RECORDING_SECONDS)
+    {
+        printf("[ENCODE] Recording too short (%.2fs), deleting: %s\n", audio_seconds, job->final_path);
+        free(samples);
+        remove(job->part_path);
+        return;
+    }
+
+    // The upload goes first; the archive copy is made from the same samples
+    if (job->archive_only)
+    {
+        remove(job->part_path);
+    }
+    else
+    {
+        int encoded = -1;
+        if (strcmp(UPLOAD_FORMAT, "opus") == 0)
+        {
+            encoded = upload_opus(job, samples, count, sample_rate);
+        }
+        else if (strcmp(UPLOAD_FORMAT, "flac") == 0)
+        {
+            char flac_path[1024];
+            replace_extension(job->final_path, ".flac", flac_path, sizeof(flac_path));
+            encoded = write_flac(samples, count, sample_rate, flac_path, &job->info);
+        }
+
+        if (encoded == 0)
+            remove(job->part_path);
+        else
+            upload_queue_publish(job->part_path, job->final_path, &job->info);
+    }
+
+    if (ARCHIVE_DIRECTORY[0] != '\0')
+        archive_recording(job, samples, count, sample_rate);
+    // The spectrogram pool takes the samples over
+    if (spectrogram_enabled())
+        spectrogram_submit(job->final_path, samples, count, sample_rate);
+    else
+        free(samples);
+}
+
+static void *encoder_worker(void *arg)
+{
+    while (1)
+    {
+        pthread_mutex_lock(&queue_lock);
+        while (queue_count == 0)
+            pthread_cond_wait(&queue_ready, &queue_lock);
+        EncodeJob job = queue[queue_head];
+        queue_head = (queue_head + 1) % ENCODER_QUEUE_SIZE;
+        queue_count--;
+        pthread_mutex_unlock(&queue_lock);
+
+        encode_job(&job);
+    }
+    return NULL;
+}
+
+int encoder_start(void)
+{
+    if (strcmp(UPLOAD_FORMAT, "opus") != 0 && strcmp(UPLOAD_FORMAT, "flac") != 0 && strcmp(UPLOAD_FORMAT, "wav") != 0)
+    {
+        fprintf(stderr, "Unknown UPLOAD_FORMAT \"%s\", uploading WAV\n", UPLOAD_FORMAT);
+        snprintf(UPLOAD_FORMAT, sizeof(UPLOAD_FORMAT), "wav");
+    }
+
+    if (strcmp(UPLOAD_FORMAT, "opus") == 0)
+        printf("Upload format: opus (%d bit/s)\n", OPUS_BITRATE);
+    else
+        printf("Upload format: %s\n", UPLOAD_FORMAT);
+    if (ARCHIVE_DIRECTORY[0] != '\0')
+        printf("Archiving FLAC copies to %s (%d encoder thread(s))\n", ARCHIVE_DIRECTORY, flac_threads());
+
+    // Plain WAV uploads without an archive or spectrogram need no encoding at all
+    if (strcmp(UPLOAD_FORMAT, "wav") == 0 && ARCHIVE_DIRECTORY[0] == '\0' && !spectrogram_enabled())
+        return 0;
+
+    if (pthread_create(&encoder_thread, NULL, encoder_worker, NULL) != 0)
+    {
+        perror("Failed to create encoder thread, uploading WAV");
+        return -1;
+    }
+    pthread_detach(encoder_thread);
+    encoder_running = 1;
+    return 0;
+}
+
+static int queue_job(const char *part_path, const char *final_path, const RecordingInfo *info, int archive_only)
+{
+    if (!encoder_running)
+        return -1;
+
+    pthread_mutex_lock(&queue_lock);
+    if (queue_count == ENCODER_QUEUE_SIZE)
+    {
+        pthread_mutex_unlock(&queue_lock);
+        return -1;
+    }
+
+    EncodeJob *job = &queue[(queue_head + queue_count) % ENCODER_QUEUE_SIZE];
+    snprintf(job->part_path, sizeof(job->part_path), "%s", part_path);
+    snprintf(job->final_path, sizeof(job->final_path), "%s", final_path);
+    job->archive_only = archive_only;
+    job->info = *info;
+    queue_count++;
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+    return 0;
+}
+
+// Called from the recording workers; never blocks on encoding
+void encoder_submit(const char *part_path, const char *final_path, const RecordingInfo *info)
+{
+    if (queue_job(part_path, final_path, info, 0) == 0)
+        return;
+
+    if (encoder_running)
+        fprintf(stderr, "Encoder queue full, uploading WAV: %s\n", final_path);
+    upload_queue_publish(part_path, final_path, info);
+}
+
+int live_encoder_open(LiveEncoder *live, const char *wav_path, int sample_rate)
+{
+    memset(live, 0, sizeof(*live));
+    if (strcmp(UPLOAD_FORMAT, "opus") != 0)
+        return 0;
+
+    replace_extension(wav_path, ".opus", live->path, sizeof(live->path));
+    snprintf(live->part_path, sizeof(live->part_path), "%s%s", live->path, WAV_PART_SUFFIX);
+    live->opus = open_opus(live->part_path, sample_rate, OPUS_BITRATE, &live->comments);
+    return live->opus ? 0 : -1;
+}
+
+void live_encoder_write(LiveEncoder *live, const short *samples, size_t count)
+{
+    if (!live->opus)
+        return;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int error = ope_encoder_write(live->opus, samples, (int)count);
+    live->encode_seconds += elapsed_seconds(&start);
+
+    if (error != OPE_OK)
+    {
+        // The WAV is still complete, so the upload is encoded after the fact
+        fprintf(stderr, "Failed to encode %s: %s\n", live->part_path, ope_strerror(error));
+        live_encoder_discard(live);
+    }
+}
+
+void live_encoder_discard(LiveEncoder *live)
+{
+    if (!live->opus)
+        return;
+
+    ope_encoder_destroy(live->opus);
+    ope_comments_destroy(live->comments);
+    live->opus = NULL;
+    live->comments = NULL;
+    remove(live->part_path);
+}
+
+// Called by the recording worker once the WAV is closed. With a live encoder
+// only the Ogg trailer is written here; everything else goes to the queue.
+void encoder_finish(LiveEncoder *live, const char *part_path, const char *final_path, size_t samples, int sample_rate,
+                    const RecordingInfo *info)
+{
+    if (!live->opus)
+    {
+        encoder_submit(part_path, final_path, info);
+        return;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int error = ope_encoder_drain(live->opus);
+    ope_encoder_destroy(live->opus);
+    ope_comments_destroy(live->comments);
+    live->opus = NULL;
+    live->comments = NULL;
+
+    if (error != OPE_OK || upload_queue_publish(live->part_path, live->path, info) != 0)
+    {
+        fprintf(stderr, "Failed to finish %s, encoding again from the WAV\n", live->part_path);
+        remove(live->part_path);
+        encoder_submit(part_path, final_path, info);
+        return;
+    }
+
+    double finish_seconds = elapsed_seconds(&start);
+    double audio_seconds = sample_rate > 0 ? (double)samples / sample_rate : 0;
+    long wav_bytes = file_size(part_path);
+    long opus_bytes = file_size(live->path);
+    printf("[ENCODE] %s | Audio: %.2fs | Encode: %.3fs while recording (%.1f ms per second), %.1f ms at close | Size: %ld KB -> %ld KB (%.1fx)\n",
+           live->path,
+           audio_seconds,
+           live->encode_seconds,
+           audio_seconds > 0 ? live->encode_seconds * 1000 / audio_seconds : 0,
+           finish_seconds * 1000,
+           wav_bytes / 1024,
+           opus_bytes / 1024,
+           opus_bytes > 0 ? (double)wav_bytes / opus_bytes : 0);
+
+    if ((ARCHIVE_DIRECTORY[0] == '\0' && !spectrogram_enabled()) || queue_job(part_path, final_path, info, 1) != 0)
+        remove(part_path);
+}
+
+// Replaces a WAV with a FLAC copy next to it, e.g. for the offline backlog.
+// Returns 0 and removes the WAV only once the FLAC is in place.
+int compress_to_flac(const char *wav_path)
+{
+    size_t count;
+    int sample_rate;
+    short *samples = wav_file_read(wav_path, &count, &sample_rate);
+    if (!samples)
+        return -1;
+
+    char flac_path[1024];
+    replace_extension(wav_path, ".flac", flac_path, sizeof(flac_path));
+    int result = write_flac(samples, count, sample_rate, flac_path, NULL);
+    free(samples);
+
+    if (result == 0)
+        remove(wav_path);
+    return result;
+}
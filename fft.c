@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "h/fft.h"
+
+int fft_plan_init(FftPlan *plan, size_t size)
+{
+    memset(plan, 0, sizeof(*plan));
+    if (size < 4 || (size & (size - 1)) != 0)
+        return -1;
+
+    size_t half = size / 2;
+    plan->size = size;
+    plan->half = half;
+    plan->twiddle_re = malloc(half / 2 * sizeof(float));
+    plan->twiddle_im = malloc(half / 2 * sizeof(float));
+    plan->split_re = malloc(half * sizeof(float));
+    plan->split_im = malloc(half * sizeof(float));
+    plan->bitrev = malloc(half * sizeof(unsigned int));
+    plan->work_re = malloc(half * sizeof(float));
+    plan->work_im = malloc(half * sizeof(float));
+
+    if (!plan->twiddle_re || !plan->twiddle_im || !plan->split_re || !plan->split_im ||
+        !plan->bitrev || !plan->work_re || !plan->work_im)
+    {
+        fft_plan_free(plan);
+        return -1;
+    }
+
+    for (size_t k = 0; k < half / 2; k++)
+    {
+        plan->twiddle_re[k] = (float)cos(2 * M_PI * k / half);
+        plan->twiddle_im[k] = (float)-sin(2 * M_PI * k / half);
+    }
+
+    for (size_t k = 0; k < half; k++)
+    {
+        plan->split_re[k] = (float)cos(2 * M_PI * k / size);
+        plan->split_im[k] = (float)-sin(2 * M_PI * k / size);
+    }
+
+    unsigned int bits = 0;
+    while ((1u << bits) < half)
+        bits++;
+    for (size_t i = 0; i < half; i++)
+    {
+        unsigned int r = 0;
+        for (unsigned int b = 0; b < bits; b++)
+            r |= ((i >> b) & 1u) << (bits - 1 - b);
+        plan->bitrev[i] = r;
+    }
+
+    return 0;
+}
+
+void fft_plan_free(FftPlan *plan)
+{
+    free(plan->twiddle_re);
+    free(plan->twiddle_im);
+    free(plan->split_re);
+    free(plan->split_im);
+    free(plan->bitrev);
+    free(plan->work_re);
+    free(plan->work_im);
+    memset(plan, 0, sizeof(*plan));
+}
+
+static void fft_complex(FftPlan *plan, float *re, float *im)
+{
+    size_t n = plan->half;
+
+    for (size_t len = 2; len <= n; len <<= 1)
+    {
+        size_t half_len = len / 2;
+        size_t step = n / len;
+        for (size_t i = 0; i < n; i += len)
+        {
+            for (size_t j = 0; j < half_len; j++)
+            {
+                float wr = plan->twiddle_re[j * step];
+                float wi = plan->twiddle_im[j * step];
+                size_t a = i + j;
+                size_t b = a + half_len;
+
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+// Writes |X[k]|^2 for k = 0..size/2 (size/2 + 1 bins)
+void fft_real_power(FftPlan *plan, const float *input, float *power)
+{
+    size_t n = plan->half;
+    float *re = plan->work_re;
+    float *im = plan->work_im;
+
+    // Pack even/odd samples as real/imaginary parts, in bit-reversed order
+    for (size_t i = 0; i < n; i++)
+    {
+        unsigned int r = plan->bitrev[i];
+        re[r] = input[2 * i];
+        im[r] = input[2 * i + 1];
+    }
+
+    fft_complex(plan, re, im);
+
+    power[0] = (re[0] + im[0]) * (re[0] + im[0]);
+    power[n] = (re[0] - im[0]) * (re[0] - im[0]);
+
+    for (size_t k = 1; k < n; k++)
+    {
+        float zr = re[k], zi = im[k];
+        float cr = re[n - k], ci = -im[n - k];
+
+        float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+        float or_ = 0.5f * (zi - ci), oi = -0.5f * (zr - cr);
+
+        float wr = plan->split_re[k], wi = plan->split_im[k];
+        float xr = er + or_ * wr - oi * wi;
+        float xi = ei + or_ * wi + oi * wr;
+        power[k] = xr * xr + xi * xi;
+    }
+}
+
+void fft_hann_window(float *window, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        window[i] = (float)(0.5 - 0.5 * cos(2 * M_PI * i / (size - 1)));
+}
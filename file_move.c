@@ -0,0 +1,164 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include "h/file_move.h"
+
+static const char *const method_names[] = {"rename", "copy_file_range", "sendfile", "read/write"};
+
+const char *file_move_method_name(FileMoveMethod method)
+{
+    return method_names[method];
+}
+
+// Errors that mean the call cannot be used here at all, rather than a failed copy
+static int unsupported(int error)
+{
+    return error == ENOSYS || error == EXDEV || error == EINVAL || error == EOPNOTSUPP;
+}
+
+// Returns 0 once size bytes are copied, 1 if the call is unsupported and
+// nothing was copied, or -1 on error. Both file offsets advance as it goes.
+static int copy_with_range(int in, int out, off_t size)
+{
+    off_t done = 0;
+    while (done < size)
+    {
+        ssize_t n = copy_file_range(in, NULL, out, NULL, (size_t)(size - done), 0);
+        if (n < 0)
+            return done == 0 && unsupported(errno) ? 1 : -1;
+        if (n == 0)
+            break;
+        done += n;
+    }
+    return 0;
+}
+
+static int copy_with_sendfile(int in, int out, off_t size)
+{
+    off_t done = 0;
+    while (done < size)
+    {
+        ssize_t n = sendfile(out, in, NULL, (size_t)(size - done));
+        if (n < 0)
+            return done == 0 && unsupported(errno) ? 1 : -1;
+        if (n == 0)
+            break;
+        done += n;
+    }
+    return 0;
+}
+
+static int copy_with_read_write(int in, int out)
+{
+    char buffer[FILE_MOVE_BUFFER_SIZE];
+    ssize_t n;
+    while ((n = read(in, buffer, sizeof(buffer))) > 0)
+    {
+        for (ssize_t written = 0; written < n;)
+        {
+            ssize_t w = write(out, buffer + written, (size_t)(n - written));
+            if (w < 0)
+                return -1;
+            written += w;
+        }
+    }
+    return n < 0 ? -1 : 0;
+}
+
+static int copy_file(const char *src, const char *dst, int sync, FileMoveStats *stats)
+{
+    int in = open(src, O_RDONLY);
+    if (in < 0)
+    {
+        perror("Failed to open source file");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(in, &st) != 0)
+    {
+        perror("Failed to stat source file");
+        close(in);
+        return -1;
+    }
+    stats->bytes = st.st_size;
+
+    int out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (out < 0)
+    {
+        perror("Failed to open destination file");
+        close(in);
+        return -1;
+    }
+
+    stats->method = FILE_MOVE_COPY_FILE_RANGE;
+    int result = copy_with_range(in, out, st.st_size);
+    if (result == 1)
+    {
+        stats->method = FILE_MOVE_SENDFILE;
+        result = copy_with_sendfile(in, out, st.st_size);
+    }
+    if (result == 1)
+    {
+        stats->method = FILE_MOVE_READ_WRITE;
+        result = copy_with_read_write(in, out);
+    }
+    if (result != 0)
+        fprintf(stderr, "Failed to copy %s to %s with %s: %s\n", src, dst, file_move_method_name(stats->method), strerror(errno));
+    else if (sync && fsync(out) != 0)
+    {
+        perror("Failed to sync destination file");
+        result = -1;
+    }
+
+    close(in);
+    if (close(out) != 0 && result == 0)
+    {
+        perror("Failed to close destination file");
+        result = -1;
+    }
+    if (result != 0)
+    {
+        unlink(dst);
+        return -1;
+    }
+    stats->copied = st.st_size;
+    return 0;
+}
+
+int file_move(const char *src, const char *dst, int sync, FileMoveStats *stats)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    memset(stats, 0, sizeof(*stats));
+
+    struct stat st;
+    if (rename(src, dst) == 0)
+    {
+        stats->method = FILE_MOVE_RENAME;
+        if (stat(dst, &st) == 0)
+            stats->bytes = st.st_size;
+    }
+    else if (errno != EXDEV)
+    {
+        fprintf(stderr, "Failed to move %s to %s: %s\n", src, dst, strerror(errno));
+        return -1;
+    }
+    else
+    {
+        if (copy_file(src, dst, sync, stats) != 0)
+            return -1;
+        if (unlink(src) != 0)
+            perror("Error removing original file");
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stats->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return 0;
+}
@@ -0,0 +1,463 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "h/flac.h"
+
+#define FLAC_MAX_FIXED_ORDER 4
+#define FLAC_MAX_PARTITION_ORDER 8
+#define FLAC_MAX_RICE_PARAM 14
+#define FLAC_BITS_PER_SAMPLE 16
+
+typedef struct
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    uint64_t bits;
+    int bit_count;
+} BitWriter;
+
+typedef struct
+{
+    const short *samples;
+    size_t count;
+    size_t first_frame;
+    size_t frame_count;
+    size_t frame_step;
+    BitWriter *frames;
+    int failed;
+} FlacJob;
+
+static int bw_reserve(BitWriter *bw, size_t extra)
+{
+    if (bw->size + extra <= bw->capacity)
+        return 0;
+    size_t capacity = bw->capacity ? bw->capacity * 2 : 4096;
+    while (capacity < bw->size + extra)
+        capacity *= 2;
+    uint8_t *data = realloc(bw->data, capacity);
+    if (!data)
+        return -1;
+    bw->data = data;
+    bw->capacity = capacity;
+    return 0;
+}
+
+// Bits collect in a 64-bit accumulator and are flushed a byte at a time;
+// callers reserve space per frame so the hot path never reallocates
+static inline void bw_put(BitWriter *bw, uint32_t value, int bits)
+{
+    if (bits == 0)
+        return;
+    bw->bits = (bw->bits << bits) | (value & ((bits == 32) ? 0xFFFFFFFFu : ((1u << bits) - 1)));
+    bw->bit_count += bits;
+    while (bw->bit_count >= 8)
+    {
+        bw->bit_count -= 8;
+        bw->data[bw->size++] = (uint8_t)(bw->bits >> bw->bit_count);
+    }
+}
+
+static inline void bw_put_unary(BitWriter *bw, uint32_t zeros)
+{
+    while (zeros >= 24)
+    {
+        bw_put(bw, 0, 24);
+        zeros -= 24;
+    }
+    bw_put(bw, 1, (int)zeros + 1);
+}
+
+static void bw_align(BitWriter *bw)
+{
+    if (bw->bit_count > 0)
+        bw_put(bw, 0, 8 - bw->bit_count);
+}
+
+static uint8_t crc8(const uint8_t *data, size_t length)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+static uint16_t crc16(const uint8_t *data, size_t length)
+{
+    uint16_t crc = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= (uint16_t)(data[i] << 8);
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x8005) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+// Frame numbers use the same variable-length coding as UTF-8
+static void put_utf8_number(BitWriter *bw, uint32_t value)
+{
+    if (value < 0x80)
+    {
+        bw_put(bw, value, 8);
+        return;
+    }
+
+    int bytes = value < 0x800 ? 2 : value < 0x10000 ? 3 : value < 0x200000 ? 4 : value < 0x4000000 ? 5 : 6;
+    int shift = (bytes - 1) * 6;
+    bw_put(bw, (0xFF00u >> bytes) | (value >> shift), 8);
+    while (shift > 0)
+    {
+        shift -= 6;
+        bw_put(bw, 0x80 | ((value >> shift) & 0x3F), 8);
+    }
+}
+
+static void fixed_residual(const int32_t *x, size_t n, int order, int32_t *residual)
+{
+    for (size_t i = order; i < n; i++)
+    {
+        switch (order)
+        {
+        case 0:
+            residual[i] = x[i];
+            break;
+        case 1:
+            residual[i] = x[i] - x[i - 1];
+            break;
+        case 2:
+            residual[i] = x[i] - 2 * x[i - 1] + x[i - 2];
+            break;
+        case 3:
+            residual[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+            break;
+        default:
+            residual[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+            break;
+        }
+    }
+}
+
+static inline uint32_t zigzag(int32_t r)
+{
+    return ((uint32_t)r << 1) ^ (uint32_t)(r >> 31);
+}
+
+// Parameter that minimises n*(k+1) + sum >> k, the usual estimate of the
+// Rice-coded size of n values summing to sum
+static int best_rice_param(uint64_t sum, size_t n, uint64_t *bits)
+{
+    int best = 0;
+    uint64_t best_bits = UINT64_MAX;
+    for (int k = 0; k <= FLAC_MAX_RICE_PARAM; k++)
+    {
+        uint64_t estimate = (uint64_t)n * (k + 1) + (sum >> k);
+        if (estimate < best_bits)
+        {
+            best_bits = estimate;
+            best = k;
+        }
+    }
+    *bits = best_bits + 4;
+    return best;
+}
+
+// Picks the partition order and per-partition Rice parameters; returns the
+// estimated residual size in bits
+static uint64_t plan_residual(const uint32_t *u, size_t n, int order, int *partition_order, int *params)
+{
+    uint64_t best_bits = UINT64_MAX;
+    int best_params[1 << FLAC_MAX_PARTITION_ORDER];
+
+    for (int p = 0; p <= FLAC_MAX_PARTITION_ORDER; p++)
+    {
+        size_t partitions = (size_t)1 << p;
+        if (n % partitions != 0 || n / partitions <= (size_t)order)
+            break;
+
+        size_t length = n / partitions;
+        uint64_t total = 2 + 4;
+        for (size_t part = 0; part < partitions; part++)
+        {
+            size_t start = part == 0 ? (size_t)order : part * length;
+            size_t end = (part + 1) * length;
+            uint64_t sum = 0;
+            for (size_t i = start; i < end; i++)
+                sum += u[i];
+            uint64_t bits;
+            best_params[part] = best_rice_param(sum, end - start, &bits);
+            total += bits;
+        }
+
+        if (total < best_bits)
+        {
+            best_bits = total;
+            *partition_order = p;
+            memcpy(params, best_params, partitions * sizeof(int));
+        }
+    }
+    return best_bits;
+}
+
+static void write_residual(BitWriter *bw, const uint32_t *u, size_t n, int order, int partition_order, const int *params)
+{
+    size_t partitions = (size_t)1 << partition_order;
+    size_t length = n / partitions;
+
+    bw_put(bw, 0, 2);
+    bw_put(bw, (uint32_t)partition_order, 4);
+    for (size_t part = 0; part < partitions; part++)
+    {
+        size_t start = part == 0 ? (size_t)order : part * length;
+        size_t end = (part + 1) * length;
+        int k = params[part];
+        bw_put(bw, (uint32_t)k, 4);
+        for (size_t i = start; i < end; i++)
+        {
+            bw_put_unary(bw, u[i] >> k);
+            bw_put(bw, u[i], k);
+        }
+    }
+}
+
+// Encodes one frame: CONSTANT for digital silence, otherwise the cheapest of
+// the fixed polynomial predictors, or VERBATIM if nothing beats raw samples
+static int encode_frame(BitWriter *bw, const short *samples, size_t n, size_t frame_number, int32_t *x, int32_t *residual, uint32_t *u)
+{
+    if (bw_reserve(bw, 64 + n * 2 + n * 4))
+        return -1;
+
+    size_t start = bw->size;
+    bw_put(bw, 0x3FFE, 14);
+    bw_put(bw, 0, 1);
+    bw_put(bw, 0, 1);          // fixed block size
+    bw_put(bw, 0x7, 4);        // block size - 1 in 16 bits after the header
+    bw_put(bw, 0x0, 4);        // sample rate from STREAMINFO
+    bw_put(bw, 0x0, 4);        // mono
+    bw_put(bw, 0x4, 3);        // 16 bits per sample
+    bw_put(bw, 0, 1);
+    put_utf8_number(bw, (uint32_t)frame_number);
+    bw_put(bw, (uint32_t)(n - 1), 16);
+    bw_put(bw, crc8(bw->data + start, bw->size - start), 8);
+
+    int constant = 1;
+    for (size_t i = 0; i < n; i++)
+    {
+        x[i] = samples[i];
+        if (x[i] != x[0])
+            constant = 0;
+    }
+
+    if (constant)
+    {
+        bw_put(bw, 0x00, 8);
+        bw_put(bw, (uint32_t)x[0] & 0xFFFF, FLAC_BITS_PER_SAMPLE);
+    }
+    else
+    {
+        int best_order = -1;
+        int partition_order = 0;
+        int params[1 << FLAC_MAX_PARTITION_ORDER];
+        uint64_t best_bits = (uint64_t)n * FLAC_BITS_PER_SAMPLE;
+
+        for (int order = 0; order <= FLAC_MAX_FIXED_ORDER && (size_t)order < n; order++)
+        {
+            int order_partition = 0;
+            int order_params[1 << FLAC_MAX_PARTITION_ORDER];
+            fixed_residual(x, n, order, residual);
+            for (size_t i = order; i < n; i++)
+                u[i] = zigzag(residual[i]);
+
+            uint64_t bits = (uint64_t)order * FLAC_BITS_PER_SAMPLE + plan_residual(u, n, order, &order_partition, order_params);
+            if (bits < best_bits)
+            {
+                best_bits = bits;
+                best_order = order;
+                partition_order = order_partition;
+                memcpy(params, order_params, ((size_t)1 << order_partition) * sizeof(int));
+            }
+        }
+
+        if (best_order < 0)
+        {
+            bw_put(bw, 0x02, 8);
+            for (size_t i = 0; i < n; i++)
+                bw_put(bw, (uint32_t)x[i] & 0xFFFF, FLAC_BITS_PER_SAMPLE);
+        }
+        else
+        {
+            // Estimates can undershoot a little, so make room for the real size
+            if (bw_reserve(bw, (size_t)(best_bits / 8) * 2 + 64))
+                return -1;
+
+            fixed_residual(x, n, best_order, residual);
+            for (size_t i = best_order; i < n; i++)
+                u[i] = zigzag(residual[i]);
+
+            bw_put(bw, (uint32_t)((0x08 | best_order) << 1), 8);
+            for (int i = 0; i < best_order; i++)
+                bw_put(bw, (uint32_t)x[i] & 0xFFFF, FLAC_BITS_PER_SAMPLE);
+            write_residual(bw, u, n, best_order, partition_order, params);
+        }
+    }
+
+    bw_align(bw);
+    uint16_t crc = crc16(bw->data + start, bw->size - start);
+    bw_put(bw, crc, 16);
+    return 0;
+}
+
+static void *encode_frames(void *arg)
+{
+    FlacJob *job = (FlacJob *)arg;
+    int32_t *x = malloc(FLAC_BLOCK_SIZE * sizeof(int32_t));
+    int32_t *residual = malloc(FLAC_BLOCK_SIZE * sizeof(int32_t));
+    uint32_t *u = malloc(FLAC_BLOCK_SIZE * sizeof(uint32_t));
+
+    if (!x || !residual || !u)
+    {
+        job->failed = 1;
+    }
+    else
+    {
+        for (size_t f = job->first_frame; f < job->frame_count; f += job->frame_step)
+        {
+            size_t offset = f * FLAC_BLOCK_SIZE;
+            size_t n = job->count - offset < FLAC_BLOCK_SIZE ? job->count - offset : FLAC_BLOCK_SIZE;
+            if (encode_frame(&job->frames[f], job->samples + offset, n, f, x, residual, u) != 0)
+            {
+                job->failed = 1;
+                break;
+            }
+        }
+    }
+
+    free(x);
+    free(residual);
+    free(u);
+    return NULL;
+}
+
+static void put_be(uint8_t *p, uint64_t value, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--)
+    {
+        p[i] = (uint8_t)(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+int flac_default_threads(void)
+{
+    // Leave a core for capture and upload when there is more than one
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > 1 ? (int)cpus - 1 : 1;
+    return threads > FLAC_MAX_THREADS ? FLAC_MAX_THREADS : threads;
+}
+
+int flac_encode(const short *samples, size_t count, int sample_rate, int threads, const char *path, FlacStats *stats)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (threads < 1)
+        threads = 1;
+    if (threads > FLAC_MAX_THREADS)
+        threads = FLAC_MAX_THREADS;
+
+    size_t frame_count = (count + FLAC_BLOCK_SIZE - 1) / FLAC_BLOCK_SIZE;
+    if ((size_t)threads > frame_count)
+        threads = frame_count > 0 ? (int)frame_count : 1;
+
+    BitWriter *frames = calloc(frame_count > 0 ? frame_count : 1, sizeof(BitWriter));
+    if (!frames)
+        return -1;
+
+    // Frames are interleaved between threads so each gets a similar share
+    FlacJob jobs[FLAC_MAX_THREADS];
+    pthread_t workers[FLAC_MAX_THREADS];
+    int started[FLAC_MAX_THREADS] = {0};
+    for (int t = 0; t < threads; t++)
+    {
+        jobs[t] = (FlacJob){samples, count, (size_t)t, frame_count, (size_t)threads, frames, 0};
+        if (t > 0)
+            started[t] = pthread_create(&workers[t], NULL, encode_frames, &jobs[t]) == 0;
+    }
+    encode_frames(&jobs[0]);
+
+    int failed = jobs[0].failed;
+    for (int t = 1; t < threads; t++)
+    {
+        if (started[t])
+            pthread_join(workers[t], NULL);
+        else
+            encode_frames(&jobs[t]);
+        failed |= jobs[t].failed;
+    }
+
+    size_t min_frame = SIZE_MAX, max_frame = 0, total = 0;
+    for (size_t f = 0; f < frame_count; f++)
+    {
+        if (frames[f].size < min_frame)
+            min_frame = frames[f].size;
+        if (frames[f].size > max_frame)
+            max_frame = frames[f].size;
+        total += frames[f].size;
+    }
+    if (frame_count == 0)
+        min_frame = 0;
+
+    FILE *file = failed ? NULL : fopen(path, "wb");
+    if (file)
+    {
+        // "fLaC", then the only metadata block, STREAMINFO, flagged as last.
+        // The MD5 field is left zero, which readers take as "not computed".
+        uint8_t header[4 + 4 + 34] = {'f', 'L', 'a', 'C', 0x80, 0, 0, 34};
+        uint8_t *info = header + 8;
+        put_be(info, FLAC_BLOCK_SIZE, 2);
+        put_be(info + 2, FLAC_BLOCK_SIZE, 2);
+        put_be(info + 4, min_frame, 3);
+        put_be(info + 7, max_frame, 3);
+        put_be(info + 10, ((uint64_t)sample_rate << 44) | ((uint64_t)(FLAC_BITS_PER_SAMPLE - 1) << 36) | count, 8);
+
+        int ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+        for (size_t f = 0; ok && f < frame_count; f++)
+            ok = fwrite(frames[f].data, 1, frames[f].size, file) == frames[f].size;
+        if (fclose(file) != 0 || !ok)
+        {
+            fprintf(stderr, "Error: Could not write %s\n", path);
+            remove(path);
+            failed = 1;
+        }
+        total += sizeof(header);
+    }
+    else if (!failed)
+    {
+        fprintf(stderr, "Error: Could not open file for writing: %s\n", path);
+        failed = 1;
+    }
+
+    for (size_t f = 0; f < frame_count; f++)
+        free(frames[f].data);
+    free(frames);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (stats)
+    {
+        stats->samples = count;
+        stats->sample_rate = sample_rate;
+        stats->input_bytes = count * sizeof(short);
+        stats->output_bytes = total;
+        stats->encode_seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        stats->threads = threads;
+    }
+    return failed ? -1 : 0;
+}
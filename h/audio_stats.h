@@ -0,0 +1,41 @@
+#ifndef AUDIO_STATS_H
+#define AUDIO_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    int peak;
+    uint64_t sum_squares;
+} BlockStats;
+
+typedef void (*block_stats_fn)(const short *samples, size_t count, BlockStats *stats);
+
+typedef struct
+{
+    const char *name;
+    block_stats_fn fn;
+} BlockStatsVariant;
+
+void audio_stats_init(void);
+const char *block_stats_backend(void);
+void block_stats(const short *samples, size_t count, BlockStats *stats);
+long block_find_first_above(const short *samples, size_t count, int threshold);
+
+// Every kernel usable on this CPU, scalar first; used by the benchmark
+int block_stats_variants(BlockStatsVariant *variants, int max_variants);
+
+typedef void (*deinterleave_stereo_fn)(const short *input, size_t frames, short *left, short *right);
+
+typedef struct
+{
+    const char *name;
+    deinterleave_stereo_fn fn;
+} DeinterleaveVariant;
+
+// Splits interleaved frames into one buffer per channel; stereo uses the vector kernel
+void deinterleave(const short *input, size_t frames, int channels, short *const *outputs);
+int deinterleave_variants(DeinterleaveVariant *variants, int max_variants);
+
+#endif
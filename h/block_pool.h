@@ -0,0 +1,51 @@
+#ifndef BLOCK_POOL_H
+#define BLOCK_POOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define BLOCK_ALIGNMENT 16
+
+typedef struct AudioBlock
+{
+    struct AudioBlock *next;
+    size_t used;
+    short samples[];
+} AudioBlock;
+
+// Fixed-size sample blocks carved out of one allocation made at startup.
+// The pool never grows: when it runs dry the caller has to cut the segment.
+typedef struct
+{
+    unsigned char *memory;
+    AudioBlock *free_list;
+    size_t block_frames;
+    size_t block_stride;
+    size_t block_count;
+    size_t in_use;
+    size_t high_water;
+    unsigned long exhausted_count;
+    pthread_mutex_t lock;
+} BlockPool;
+
+// A transmission held as a singly linked list of pool blocks.
+typedef struct
+{
+    AudioBlock *head;
+    AudioBlock *tail;
+    size_t frames;
+    size_t blocks;
+} BlockChain;
+
+int block_pool_init(BlockPool *pool, size_t block_frames, size_t budget_bytes);
+void block_pool_destroy(BlockPool *pool);
+AudioBlock *block_pool_acquire(BlockPool *pool);
+void block_pool_release(BlockPool *pool, AudioBlock *block);
+void block_pool_stats(BlockPool *pool, size_t *in_use, size_t *high_water, unsigned long *exhausted_count);
+
+AudioBlock *block_chain_pop(BlockChain *chain);
+size_t block_chain_append(BlockChain *chain, BlockPool *pool, const short *src, size_t count);
+void block_chain_truncate(BlockChain *chain, BlockPool *pool, size_t frames);
+void block_chain_release(BlockChain *chain, BlockPool *pool);
+
+#endif
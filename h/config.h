@@ -3,6 +3,19 @@
 
 #include <stdbool.h>
 
+#define MAX_INPUTS 8
+
+// One receiver, configured with INPUT_<n>_DEVICE / _CHANNEL / _COM_PORT / _THRESHOLD / _PREFIX.
+// Inputs naming the same device share one capture stream, one per channel.
+typedef struct
+{
+    char device[128];
+    int channel;
+    char com_port[128];
+    int amplitude_threshold;
+    char prefix[64];
+} InputConfig;
+
 extern char BOT_TOKEN[256];
 extern char CHAT_ID[256];
 extern char *CHAT_IDS[21];
@@ -15,10 +28,48 @@ extern char REPO_BRANCH[64];
 extern int AMPLITUDE_THRESHOLD;
 extern int CHUNK_SIZE;
 extern bool LIVE_LISTEN;
+extern char MONITOR_DEVICE[128];
+extern int MONITOR_LATENCY_MS;
 extern char EXTRA_TEXT[64];
 extern int SILENCE_THRESHOLD;
 extern int REMOVE_LAST_SECONDS;
+extern int RECORDING_BLOCK_FRAMES;
+extern int RECORDING_MEMORY_MB;
+extern int PREROLL_MS;
+extern int MAX_SEGMENT_SECONDS;
+extern int SEGMENT_SEARCH_SECONDS;
+extern int RECORDING_SAMPLE_RATE;
+extern char VAD_MODE[16];
+extern int VAD_OPEN_DB;
+extern int VAD_CLOSE_DB;
+extern double VAD_MAX_FLATNESS;
+extern int VAD_MIN_VOICE_MS;
+extern bool VAD_COMPARE;
+extern char UPLOAD_FORMAT[16];
+extern int OPUS_BITRATE;
+extern char WAV_FORMAT[16];
+extern char ARCHIVE_DIRECTORY[256];
+extern int FLAC_THREADS;
+extern bool OFFLINE_FLAC;
+extern int DSP_HIGHPASS_HZ;
+extern double DSP_NOTCH_HZ;
+extern bool DSP_AGC;
+extern int DSP_AGC_TARGET_DBFS;
+extern int DSP_AGC_MAX_GAIN_DB;
+extern double DSP_LIMIT_DBFS;
+extern char SPECTROGRAM_DIRECTORY[256];
+extern int SPECTROGRAM_THREADS;
+extern bool SPECTROGRAM_TELEGRAM;
+extern int CALLBACK_BUDGET_PERCENT;
+extern char JOURNAL_DIRECTORY[256];
+extern int JOURNAL_MB;
+extern int JOURNAL_SYNC_MS;
+extern int UPLOAD_WORKERS;
+extern bool MOVE_FSYNC;
+extern InputConfig INPUTS[MAX_INPUTS];
+extern int INPUT_COUNT;
 
 int load_env(const char *filename);
+int load_telegram_env(const char *filename);
 
 #endif
\ No newline at end of file
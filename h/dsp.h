@@ -0,0 +1,84 @@
+#ifndef DSP_H
+#define DSP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DSP_SECTIONS 4
+#define DSP_NOTCH_Q 8.0
+#define DSP_AGC_LOOKAHEAD_MS 5
+
+typedef float dsp_v4sf __attribute__((vector_size(16)));
+
+// Four biquad sections in series, one per vector lane. Lane k runs section k
+// on what lane k-1 produced one sample earlier, so the whole cascade advances
+// in a single vector step at the cost of three samples of delay.
+typedef struct
+{
+    dsp_v4sf b0, b1, b2, a1, a2;
+    dsp_v4sf z1, z2, y;
+} BiquadCascade;
+
+// Level control with a short look-ahead: the gain follows the speech level
+// towards target_rms, and is pulled down before any peak in the look-ahead
+// window can exceed the ceiling.
+typedef struct
+{
+    float target_rms;
+    float max_gain;
+    float ceiling;
+    float gate_power;
+    float level;
+    float attack;
+    float release;
+    float gain_attack;
+    float gain_release;
+
+    size_t lookahead;
+    float *delay;
+    size_t delay_pos;
+    // Monotonic queue of (position, |sample|) for the sliding window peak
+    uint64_t *peak_position;
+    float *peak_value;
+    size_t peak_head;
+    size_t peak_count;
+    uint64_t position;
+
+    float envelope;
+    float level_gain;
+    float gain;
+} Agc;
+
+// High-pass / CTCSS notch cascade followed by AGC, applied in place to each
+// block on its way to the encoder. Stages are timed separately.
+typedef struct
+{
+    int sample_rate;
+    int filters_enabled;
+    int agc_enabled;
+    BiquadCascade filters;
+    Agc agc;
+    float *work;
+    size_t work_size;
+    uint64_t filter_ns;
+    uint64_t agc_ns;
+    uint64_t frames;
+} DspChain;
+
+int dsp_chain_init(DspChain *dsp, int sample_rate, size_t max_block);
+void dsp_chain_free(DspChain *dsp);
+void dsp_chain_reset(DspChain *dsp);
+int dsp_chain_enabled(const DspChain *dsp);
+void dsp_chain_process(DspChain *dsp, short *samples, size_t count);
+// Samples the output lags the input by: three in the filter lanes plus
+// DSP_AGC_LOOKAHEAD_MS of AGC look-ahead
+size_t dsp_chain_delay(const DspChain *dsp);
+// At the end of a transmission, writes the last dsp_chain_delay samples
+// still held in the chain to out (at most size); returns how many
+size_t dsp_chain_flush(DspChain *dsp, short *out, size_t size);
+double dsp_cpu_percent(const DspChain *dsp, uint64_t ns);
+
+void biquad_cascade_design(BiquadCascade *cascade, int sample_rate, double highpass_hz, double notch_hz);
+void biquad_cascade_process(BiquadCascade *cascade, float *samples, size_t count);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <stddef.h>
+#include "upload_queue.h"
+
+#define ENCODER_QUEUE_SIZE 32
+// Recordings shorter than this are dropped instead of uploaded
+#define MIN_RECORDING_SECONDS 1.0
+
+// Finished recordings are handed over as a closed <name>.wav.part. A worker
+// thread encodes them to <name>.opus or <name>.flac for UPLOAD_FORMAT, and
+// keeps a FLAC copy in ARCHIVE_DIRECTORY if one is set. With wav, or whenever
+// encoding is not possible, the WAV itself is published. Published uploads
+// go to the upload queue along with info.
+int encoder_start(void);
+void encoder_submit(const char *part_path, const char *final_path, const RecordingInfo *info);
+
+// Opus encoder fed by a recording worker while the transmission is still
+// going, so only the last block and the Ogg trailer are left to do when the
+// squelch closes. The WAV is still written alongside as the fallback and as
+// the source for the archive.
+typedef struct
+{
+    struct OggOpusEnc *opus;
+    struct OggOpusComments *comments;
+    char path[1024];
+    char part_path[1040];
+    double encode_seconds;
+} LiveEncoder;
+
+int live_encoder_open(LiveEncoder *live, const char *wav_path, int sample_rate);
+void live_encoder_write(LiveEncoder *live, const short *samples, size_t count);
+void live_encoder_discard(LiveEncoder *live);
+void encoder_finish(LiveEncoder *live, const char *part_path, const char *final_path, size_t samples, int sample_rate,
+                    const RecordingInfo *info);
+
+int encode_opus(const short *samples, size_t count, int sample_rate, const char *opus_path, int bitrate);
+int compress_to_flac(const char *wav_path);
+
+#endif
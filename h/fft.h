@@ -0,0 +1,27 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <stddef.h>
+
+// Real-input FFT of a fixed power-of-two size, computed as a half-size
+// complex FFT plus a split step. A plan owns its tables and scratch space,
+// so one plan must not be shared between threads.
+typedef struct
+{
+    size_t size;
+    size_t half;
+    float *twiddle_re;
+    float *twiddle_im;
+    float *split_re;
+    float *split_im;
+    unsigned int *bitrev;
+    float *work_re;
+    float *work_im;
+} FftPlan;
+
+int fft_plan_init(FftPlan *plan, size_t size);
+void fft_plan_free(FftPlan *plan);
+void fft_real_power(FftPlan *plan, const float *input, float *power);
+void fft_hann_window(float *window, size_t size);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef FILE_MOVE_H
+#define FILE_MOVE_H
+
+#include <sys/types.h>
+
+#define FILE_MOVE_BUFFER_SIZE (64 * 1024)
+
+typedef enum
+{
+    FILE_MOVE_RENAME,
+    FILE_MOVE_COPY_FILE_RANGE,
+    FILE_MOVE_SENDFILE,
+    FILE_MOVE_READ_WRITE
+} FileMoveMethod;
+
+typedef struct
+{
+    FileMoveMethod method;
+    off_t bytes;
+    // Bytes read and written again; 0 for a rename
+    off_t copied;
+    double seconds;
+} FileMoveStats;
+
+// Moves src to dst: a rename on the same filesystem, otherwise an in-kernel
+// copy with copy_file_range, then sendfile, with a read/write loop only where
+// neither is supported. With sync set, a copy is flushed to disk before src
+// is removed, so a power cut never loses both.
+int file_move(const char *src, const char *dst, int sync, FileMoveStats *stats);
+const char *file_move_method_name(FileMoveMethod method);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef FLAC_H
+#define FLAC_H
+
+#include <stddef.h>
+
+#define FLAC_BLOCK_SIZE 4096
+#define FLAC_MAX_THREADS 8
+
+typedef struct
+{
+    size_t samples;
+    int sample_rate;
+    size_t input_bytes;
+    size_t output_bytes;
+    double encode_seconds;
+    int threads;
+} FlacStats;
+
+// Native lossless encoder for 16-bit mono audio. Frames are independent, so
+// they are split across worker threads and written out in order afterwards.
+int flac_encode(const short *samples, size_t count, int sample_rate, int threads, const char *path, FlacStats *stats);
+int flac_default_threads(void);
+
+#endif
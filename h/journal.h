@@ -0,0 +1,69 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define JOURNAL_SUFFIX ".journal"
+#define JOURNAL_MIN_BYTES (1024 * 1024)
+// 100 ms per record at 48 kHz: small enough that a crash loses little
+#define JOURNAL_MAX_RECORD_FRAMES 4800
+
+typedef enum
+{
+    JOURNAL_START = 1,
+    JOURNAL_CONFIRM,
+    JOURNAL_AUDIO,
+    JOURNAL_END
+} JournalRecordType;
+
+// Fixed-size circular file, mapped into memory, that the worker appends every
+// captured block of a transmission to as it arrives. Each record carries a
+// sequence number, its stream frame and a CRC, so after a crash or brown-out
+// the unfinished transmission can be rebuilt from whatever survived.
+// Dirty pages are written back with msync at most every sync_ms.
+typedef struct
+{
+    int fd;
+    unsigned char *map;
+    size_t capacity;
+    size_t offset;
+    uint64_t sequence;
+    int sample_rate;
+
+    // Sequence number of the open segment's START record, 0 between segments
+    uint64_t segment;
+    int confirmed;
+
+    size_t page_size;
+    int sync_ms;
+    size_t dirty_start;
+    size_t dirty_end;
+    struct timespec last_sync;
+    unsigned long syncs;
+    uint64_t synced_bytes;
+    uint64_t sync_ns;
+} Journal;
+
+// A journal that failed to open (map == NULL) ignores every call below
+int journal_open(Journal *journal, const char *path, size_t bytes, int sample_rate, int sync_ms);
+void journal_close(Journal *journal);
+
+// final_path is where the recording is published, part_path the file it is
+// streamed to in the meantime
+void journal_begin(Journal *journal, uint64_t frame, const struct timespec *start, const char *final_path, const char *part_path);
+void journal_confirm(Journal *journal);
+void journal_append(Journal *journal, uint64_t frame, const struct timespec *time, const short *samples, size_t count);
+void journal_end(Journal *journal);
+void journal_sync(Journal *journal, int force);
+
+// Rebuilds every confirmed segment without an END record into a recording in
+// RECORDING_DIRECTORY and closes it in the journal. The segment's .part is
+// only replaced when the journal still has its START and more audio than
+// the .part; otherwise the .part is left to be recovered as it is.
+// Returns the number of recordings rebuilt, or -1 if the journal is unreadable.
+int journal_recover(const char *path);
+void journal_recover_directory(const char *directory);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#define LATENCY_TRACKED_FILES 64
+
+// Tracks how long a recording takes from the moment the squelch closes to the
+// moment its upload starts, with the time until the file is published in
+// between. Files are matched by name, since they move between directories.
+void latency_squelch_closed(const char *path);
+void latency_published(const char *path);
+void latency_upload_started(const char *path);
+
+#endif
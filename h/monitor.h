@@ -0,0 +1,63 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <portaudio.h>
+#include "ring_buffer.h"
+
+#define MONITOR_MAX_CHANNELS 8
+#define MONITOR_MAX_LATENCY_MS 500
+#define MONITOR_FRAMES_PER_BUFFER 256
+
+// Live-listen output on its own PortAudio stream. The capture callback only
+// pushes frames into a ring; the output callback plays them through a jitter
+// buffer whose target grows after underruns and shrinks back when playback is
+// steady. The two sound cards' clocks drift apart, so the output side reads
+// the ring slightly faster or slower to hold the buffer at its target.
+// A missing or stalled output device never holds up capture.
+typedef struct
+{
+    char device_name[128];
+    PaStream *stream;
+    RingBuffer ring;
+    int capture_channels;
+    int output_channels;
+    int sample_rate;
+    size_t min_target_frames;
+    size_t max_target_frames;
+    double input_latency;
+    double output_latency;
+    time_t next_open_attempt;
+    unsigned long last_callback_count;
+    int stalled_seconds;
+    unsigned long reported_underruns;
+
+    // Owned by the output callback
+    short *input;
+    size_t input_frames;
+    size_t input_capacity;
+    double phase;
+    double average_fill;
+    double ratio;
+    size_t target_frames;
+    int buffering;
+    uint64_t steady_frames;
+
+    // Published by the output callback for reporting
+    atomic_ulong callback_count;
+    atomic_ulong underruns;
+    atomic_ulong skipped_frames;
+    atomic_size_t reported_target;
+    atomic_size_t reported_fill;
+    atomic_long drift_ppm;
+} Monitor;
+
+int monitor_init(Monitor *monitor, int capture_channels, int sample_rate);
+void monitor_free(Monitor *monitor);
+void monitor_push(Monitor *monitor, const short *frames, size_t count);
+void monitor_poll(Monitor *monitor, int force_report);
+
+#endif
@@ -1,7 +1,18 @@
 #ifndef OPEN_SERIAL_PORT_H
 #define OPEN_SERIAL_PORT_H
 
-char *get_radio_name(void);
-void *serial_monitor_thread(void *arg);
+#include <pthread.h>
 
-#endif
\ No newline at end of file
+// Radio name reported over one serial port, with the last few kept
+typedef struct
+{
+    char com_port[128];
+    char name_history[3][128];
+    pthread_mutex_t lock;
+} RadioSerial;
+
+void radio_serial_init(RadioSerial *radio, const char *com_port);
+char *radio_serial_get_name(RadioSerial *radio);
+void *radio_serial_thread(void *arg);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef PREROLL_H
+#define PREROLL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PREROLL_INDEX_BLOCK 256
+
+// Ring of the most recent input, kept so a recording can start slightly before
+// the trigger. Alongside the samples it keeps peak/energy per index block so
+// the onset search walks blocks rather than samples.
+typedef struct
+{
+    short *samples;
+    size_t capacity;
+    uint64_t total_written;
+    int *block_peak;
+    uint64_t *block_energy;
+    size_t block_count;
+} PreRoll;
+
+typedef struct
+{
+    const short *data;
+    size_t count;
+} SampleSpan;
+
+int preroll_init(PreRoll *preroll, size_t frames);
+void preroll_free(PreRoll *preroll);
+void preroll_write(PreRoll *preroll, const short *samples, size_t count);
+size_t preroll_available(const PreRoll *preroll);
+long preroll_find_onset(const PreRoll *preroll, int threshold);
+int preroll_spans(const PreRoll *preroll, size_t offset, SampleSpan spans[2]);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Four buckets per power of two of nanoseconds, up to about nine minutes
+#define PROFILE_BUCKETS 160
+#define PROFILE_REPORT_INTERVAL 60
+
+typedef enum
+{
+    PROFILE_CALLBACK,
+    PROFILE_DETECT,
+    PROFILE_WRITE,
+    PROFILE_COPY,
+    PROFILE_QUEUE,
+    PROFILE_UPLOAD,
+    PROFILE_STAGE_COUNT
+} ProfileStage;
+
+// Always-on timing of the pipeline stages. Recording is a handful of relaxed
+// atomic adds, so it is safe in the PortAudio callback; all printing happens
+// in profiler_poll on the recorder's housekeeping loop.
+void profiler_init(void);
+void profiler_record(ProfileStage stage, uint64_t start_ticks, uint64_t budget_ns);
+int profiler_poll(int force_report);
+
+// Raw monotonic cycle counter, converted to nanoseconds only when recorded
+static inline uint64_t profiler_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+#endif
@@ -1,6 +1,33 @@
 #ifndef RECORDAUDIO_H
 #define RECORDAUDIO_H
 
-void recorder(const char *com_port);
+#include <stddef.h>
+#include <time.h>
+
+// What became of one detected segment, as collected by a replay
+typedef struct
+{
+    double start_seconds;
+    double seconds;
+    double voiced_seconds;
+    int part;
+    const char *result;
+    char path[1024];
+} SegmentRecord;
+
+typedef struct
+{
+    SegmentRecord *segments;
+    size_t count;
+    size_t capacity;
+} SegmentLog;
+
+void recorder(void);
+
+// Runs mono audio through the live detection and segmentation path, block by
+// block as fast as it goes, with frame 0 at start_time. Files are written as
+// a receiver named label would write them, and every segment is logged.
+int replay_recording(const char *label, const short *samples, size_t count, int sample_rate,
+                     const struct timespec *start_time, SegmentLog *log);
 
 #endif
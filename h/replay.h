@@ -0,0 +1,16 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#define REPLAY_DEFAULT_OUTPUT "./replay"
+#define REPLAY_DEFAULT_REPORT "replay.json"
+#define REPLAY_DEFAULT_START "2000-01-01 00:00:00"
+
+// recorder --replay [--env FILE] [--output DIR] [--report FILE] [--start "YYYY-MM-DD HH:MM:SS"] FILE.wav...
+//
+// Feeds recorded WAVs through the live detection and segmentation code
+// without a sound card, as fast as it runs, and writes the recordings it
+// would have made to the output directory plus a JSON report of every
+// segment. File names follow from --start, so runs are reproducible.
+int replay_main(int argc, char **argv);
+
+#endif
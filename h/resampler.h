@@ -0,0 +1,29 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stddef.h>
+
+#define RESAMPLER_CHUNK 1024
+
+// Rational-ratio polyphase resampler for 16-bit mono audio. A Kaiser-windowed
+// sinc low-pass is split into one sub-filter per output phase, so only the
+// taps needed for each output sample are evaluated. Equal rates copy through.
+typedef struct
+{
+    int in_rate;
+    int out_rate;
+    int up;
+    int down;
+    size_t taps;
+    float *coeffs;
+    float *work;
+    size_t position;
+} Resampler;
+
+int resampler_init(Resampler *resampler, int in_rate, int out_rate);
+void resampler_free(Resampler *resampler);
+void resampler_reset(Resampler *resampler);
+size_t resampler_max_output(const Resampler *resampler, size_t frames);
+size_t resampler_process(Resampler *resampler, const short *input, size_t frames, short *output);
+
+#endif
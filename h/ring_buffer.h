@@ -0,0 +1,29 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Single-producer/single-consumer sample ring. The producer (audio callback)
+// and consumer (recording worker) only ever touch their own index, so no
+// locks are taken on either side.
+typedef struct
+{
+    short *data;
+    size_t capacity;
+    size_t mask;
+    atomic_size_t head;
+    atomic_size_t tail;
+    atomic_size_t high_water;
+    atomic_ulong dropped_frames;
+} RingBuffer;
+
+int ring_buffer_init(RingBuffer *rb, size_t min_capacity);
+void ring_buffer_free(RingBuffer *rb);
+
+size_t ring_buffer_write(RingBuffer *rb, const short *src, size_t count);
+size_t ring_buffer_read(RingBuffer *rb, short *dst, size_t count);
+size_t ring_buffer_discard(RingBuffer *rb, size_t count);
+size_t ring_buffer_fill(RingBuffer *rb);
+
+#endif
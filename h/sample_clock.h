@@ -0,0 +1,29 @@
+#ifndef SAMPLE_CLOCK_H
+#define SAMPLE_CLOCK_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+// Maps a running frame counter to wall-clock time. CLOCK_REALTIME is sampled
+// once, on the first observation; after that every callback re-bases the
+// mapping on the stream's ADC timestamp so sound-card clock drift never
+// accumulates. Observations are published through a seqlock so the audio
+// callback never waits on the reader.
+typedef struct
+{
+    int sample_rate;
+    atomic_uint sequence;
+    atomic_int anchored;
+    atomic_llong realtime_offset_ns;
+    atomic_ullong obs_frame;
+    atomic_llong obs_time_ns;
+} SampleClock;
+
+void sample_clock_init(SampleClock *clock, int sample_rate);
+void sample_clock_observe(SampleClock *clock, uint64_t frame, double adc_time, double now_time);
+void sample_clock_realtime(SampleClock *clock, uint64_t frame, struct timespec *out);
+void sample_clock_anchor(SampleClock *clock, const struct timespec *start);
+double sample_clock_seconds(const SampleClock *clock, uint64_t frames);
+
+#endif
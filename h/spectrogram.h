@@ -0,0 +1,46 @@
+#ifndef SPECTROGRAM_H
+#define SPECTROGRAM_H
+
+#include <stddef.h>
+#include "fft.h"
+
+#define SPECTROGRAM_QUEUE_SIZE 16
+#define SPECTROGRAM_MAX_THREADS 4
+#define SPECTROGRAM_MAX_WIDTH 1200
+#define SPECTROGRAM_MAX_HZ 8000
+// Colour scale in dBFS per FFT bin; anything quieter is black
+#define SPECTROGRAM_FLOOR_DB -100.0
+#define SPECTROGRAM_CEILING_DB -20.0
+// Background work: below the recording and upload threads
+#define SPECTROGRAM_NICE 10
+
+typedef struct
+{
+    size_t samples;
+    int sample_rate;
+    size_t fft_size;
+    size_t frames;
+    int width;
+    int height;
+    size_t png_bytes;
+    double fft_seconds;
+    double render_seconds;
+} SpectrogramStats;
+
+// Called on a spectrogram worker once <png_path> is in place
+typedef void (*SpectrogramCallback)(const char *png_path, const char *recording_path);
+
+// Finished recordings get a PNG spectrogram in SPECTROGRAM_DIRECTORY, drawn
+// by a small pool of low-priority threads after the upload has been handed
+// on. A full queue drops the picture, never the recording.
+int spectrogram_start(SpectrogramCallback on_written);
+int spectrogram_enabled(void);
+// Takes ownership of samples, which must come from malloc
+void spectrogram_submit(const char *recording_path, short *samples, size_t count, int sample_rate);
+
+// Hann-windowed frames with 75% overlap, averaged down to at most
+// SPECTROGRAM_MAX_WIDTH columns, up to SPECTROGRAM_MAX_HZ
+size_t spectrogram_fft_size(int sample_rate);
+int spectrogram_write(FftPlan *plan, const short *samples, size_t count, int sample_rate, const char *png_path, SpectrogramStats *stats);
+
+#endif
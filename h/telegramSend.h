@@ -2,11 +2,19 @@
 #define TELEGRAM_SENDER_H
 
 #include <stdio.h>
+#include "upload_queue.h"
 
 void get_current_datetime(char *datetime_str, size_t size);
+// Once, before any thread that sends
+void telegram_init(void);
 
 int send_to_telegram(const char *file_path, const char *bot_token, char **chat_ids);
 int send_telegram_status(const char *bot_token, char **chat_ids, const char *message);
 int send_offline_to_telegram(const char *file_path, const char *bot_token, char **chat_ids);
+int send_recording_to_telegram(const char *file_path, const RecordingInfo *info, const char *bot_token, char **chat_ids);
+int send_telegram_photo(const char *photo_path, const char *recording_path, const char *bot_token, char **chat_ids);
+// Moves a recording into ./offline under the file name of name_path, for
+// the offline sync to send later
+void cache_offline_recording(const char *file_path, const char *name_path);
 
 #endif
@@ -0,0 +1,69 @@
+#ifndef UPLOAD_QUEUE_H
+#define UPLOAD_QUEUE_H
+
+#include <time.h>
+
+#define UPLOAD_QUEUE_SIZE 32
+#define UPLOAD_MAX_WORKERS 8
+// Longest path a job can hold, with its terminator
+#define UPLOAD_PATH_MAX 1024
+
+// What the recorder knows about a recording, handed to the uploader so it
+// does not have to be parsed back out of the file name
+typedef struct
+{
+    char prefix[64];
+    char radio[256];
+    // Wall-clock time of the first sample
+    struct timespec start;
+    double seconds;
+    int peak;
+    int part;
+} RecordingInfo;
+
+// Lower values are uploaded first; jobs of equal priority in arrival order
+typedef enum
+{
+    // Published by the recorder
+    UPLOAD_PRIORITY_LIVE,
+    // Found by the directory watcher
+    UPLOAD_PRIORITY_FOUND,
+    // Left in RECORDING_DIRECTORY by an earlier run
+    UPLOAD_PRIORITY_BACKLOG
+} UploadPriority;
+
+typedef struct
+{
+    char path[UPLOAD_PATH_MAX];
+    UploadPriority priority;
+    // Set for recordings published by the recorder
+    int has_info;
+    RecordingInfo info;
+} UploadJob;
+
+// Runs on an upload worker, which owns the file until it returns
+typedef void (*UploadHandler)(const UploadJob *job);
+// Takes a file the queue has no room for, on the thread that offered it.
+// name_path is the name the file would have been uploaded under.
+typedef void (*UploadOverflowHandler)(const char *path, const char *name_path);
+
+// A fixed pool of upload workers fed by a bounded priority queue. A file
+// that does not fit goes to the overflow handler rather than waiting.
+int upload_queue_start(int workers, UploadHandler handler, UploadOverflowHandler overflow);
+// Renames part_path to final_path. With info set it is a recording for
+// upload: it is queued, handed from part_path to the overflow handler if
+// the queue is full, or left to the watcher if the pool is not running or
+// final_path is too long for a job.
+// Returns -1 if the rename fails.
+int upload_queue_publish(const char *part_path, const char *final_path, const RecordingInfo *info);
+// Queues a file that has no metadata. Returns 0 if queued, 1 if it went to
+// the overflow handler, or -1 if the pool is not running or the path is too
+// long for a job, and the caller has to upload it itself.
+int upload_queue_submit(const char *path, UploadPriority priority);
+// Whether <path> is queued or being uploaded, matched by file name
+int upload_queue_owns(const char *path);
+// Logs an [UPLOAD] line with queue depth, workers in use and totals when
+// forced and the pool has done anything
+void upload_queue_poll(int force);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef VAD_H
+#define VAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "audio_stats.h"
+#include "fft.h"
+
+#define VAD_FFT_SIZE 512
+
+typedef struct VoiceDetector VoiceDetector;
+
+// A detector backend decides, block by block, whether the input is voice.
+typedef struct
+{
+    const char *name;
+    int (*init)(VoiceDetector *vad);
+    int (*process)(VoiceDetector *vad, const short *samples, size_t count, const BlockStats *stats);
+    void (*destroy)(VoiceDetector *vad);
+} VadBackend;
+
+typedef struct
+{
+    int sample_rate;
+    int amplitude_threshold;
+    double open_db;
+    double close_db;
+    double max_flatness;
+    size_t hang_frames;
+    size_t min_voice_frames;
+} VadConfig;
+
+struct VoiceDetector
+{
+    const VadBackend *backend;
+    VadConfig config;
+    int active;
+
+    // rms: level and adaptive noise floor in dBFS
+    double level_db;
+    double noise_floor_db;
+
+    // flatness: spectral flatness of the last full analysis frame
+    FftPlan fft;
+    float *window;
+    float *frame;
+    float *power;
+    float *smoothed;
+    size_t frame_fill;
+    double flatness;
+
+    // Trigger accounting, identical for every backend. A session opens on
+    // the first voiced block and closes after hang_frames without voice; a
+    // session with less than min_voice_frames of voice is a false trigger.
+    int in_session;
+    uint64_t session_voiced;
+    uint64_t session_silence;
+    unsigned long triggers;
+    unsigned long false_triggers;
+    uint64_t cpu_ns;
+    uint64_t frames;
+};
+
+const VadBackend *vad_find_backend(const char *name);
+int vad_backend_count(void);
+const VadBackend *vad_backend_at(int index);
+
+int vad_init(VoiceDetector *vad, const VadBackend *backend, const VadConfig *config);
+void vad_destroy(VoiceDetector *vad);
+int vad_process(VoiceDetector *vad, const short *samples, size_t count, const BlockStats *stats);
+double vad_cpu_percent(const VoiceDetector *vad);
+
+#endif
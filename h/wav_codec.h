@@ -0,0 +1,27 @@
+#ifndef WAV_CODEC_H
+#define WAV_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// WAVE format tags written to the fmt chunk
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_MULAW 0x0007
+#define WAVE_FORMAT_IMA_ADPCM 0x0011
+
+// G.711 mu-law, one byte per sample
+void mulaw_encode(const short *samples, size_t count, uint8_t *out);
+void mulaw_decode(const uint8_t *in, size_t count, short *samples);
+
+// IMA ADPCM, 4 bits per sample in self-contained blocks: a 4-byte header with
+// the first sample and step index, then two samples per byte, low nibble first.
+typedef struct
+{
+    int step_index;
+} ImaAdpcmState;
+
+size_t ima_adpcm_samples_per_block(size_t block_align);
+void ima_adpcm_encode_block(ImaAdpcmState *state, const short *samples, size_t samples_per_block, uint8_t *out);
+void ima_adpcm_decode_block(const uint8_t *in, size_t samples_per_block, short *samples);
+
+#endif
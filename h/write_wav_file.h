@@ -1,8 +1,52 @@
 #ifndef WRITE_WAV_FILE_H
 #define WRITE_WAV_FILE_H
 
+#include <stdio.h>
 #include <stddef.h>
+#include <stdint.h>
+#include "wav_codec.h"
+
+#define WAV_PART_SUFFIX ".part"
+#define WAV_WRITER_BUFFER_SIZE (64 * 1024)
+#define WAV_MAX_ADPCM_BLOCK 1024
+
+typedef enum
+{
+    WAV_ENCODING_PCM,
+    WAV_ENCODING_MULAW,
+    WAV_ENCODING_IMA_ADPCM
+} WavEncoding;
+
+// Incremental writer: frames are appended as they are captured into
+// <filename>.part, which is renamed to <filename> once the header is final.
+typedef struct
+{
+    FILE *file;
+    size_t frames;
+    size_t data_bytes;
+    int sample_rate;
+    WavEncoding encoding;
+    size_t block_align;
+    size_t samples_per_block;
+    ImaAdpcmState adpcm;
+    short pending[(WAV_MAX_ADPCM_BLOCK - 4) * 2 + 1];
+    size_t pending_count;
+    uint8_t encoded[4096];
+    char final_path[1024];
+    char part_path[1040];
+} WavWriter;
 
 int write_wav_file(const char *filename, short *data, size_t numSamples, int sampleRate);
 
+WavEncoding wav_encoding_from_name(const char *name);
+int wav_writer_open(WavWriter *writer, const char *filename, int sampleRate, WavEncoding encoding);
+int wav_writer_append(WavWriter *writer, const short *data, size_t numSamples);
+int wav_writer_close(WavWriter *writer);
+int wav_writer_finalize(WavWriter *writer);
+void wav_writer_discard(WavWriter *writer);
+
+long wav_file_repair(const char *filename);
+int wav_file_info(const char *filename, size_t *numSamples, int *sampleRate);
+short *wav_file_read(const char *filename, size_t *numSamples, int *sampleRate);
+
 #endif
@@ -5,7 +5,7 @@ set -e
 echo "🔄 Updating and installing dependencies..."
 
 sudo apt update -y && sudo apt upgrade -y
-sudo apt install -y build-essential portaudio19-dev libcurl4-openssl-dev libserialport-dev libuv1-dev libasound2-dev libjack-jackd2-dev
+sudo apt install -y build-essential portaudio19-dev libcurl4-openssl-dev libserialport-dev libasound2-dev libjack-jackd2-dev libopus-dev libopusenc-dev
 
 echo "✅ Dependencies installed."
 
@@ -53,9 +53,9 @@ fi
 echo "🔧 Compiling recorder..."
 SCRIPT_DIR="$(dirname "$(realpath "$0")")"
 
-gcc -o "$SCRIPT_DIR/recorder" main.c open_serial_port.c recordAudio.c \
-    telegramSend.c config.c write_wav_file.c getRadioImage.c \
-    -lportaudio -lm -lserialport -lpthread -lcurl -luv -lasound -ljack
+gcc -I/usr/include/opus -o "$SCRIPT_DIR/recorder" main.c open_serial_port.c recordAudio.c \
+    telegramSend.c config.c write_wav_file.c ring_buffer.c block_pool.c audio_stats.c preroll.c sample_clock.c fft.c vad.c resampler.c encoder.c wav_codec.c flac.c latency.c monitor.c dsp.c spectrogram.c profiler.c replay.c journal.c upload_queue.c file_move.c getRadioImage.c \
+    -lportaudio -lm -lserialport -lpthread -lcurl -lasound -ljack -lopusenc -lopus
 
 echo "✅ Compilation complete."
 
@@ -0,0 +1,572 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "h/journal.h"
+#include "h/resampler.h"
+#include "h/dsp.h"
+#include "h/write_wav_file.h"
+#include "h/encoder.h"
+#include "h/config.h"
+
+#define JOURNAL_MAGIC 0x4C4E524AU // "JRNL"
+#define JOURNAL_ALIGN 8
+#define JOURNAL_FLAG_CONFIRMED 1U
+
+// Followed by payload_bytes of payload: two NUL-terminated paths for START,
+// mono samples for AUDIO, nothing otherwise
+typedef struct
+{
+    uint32_t magic;
+    // CRC-32 of everything after this field, payload included
+    uint32_t crc;
+    uint32_t type;
+    uint32_t payload_bytes;
+    uint64_t sequence;
+    uint64_t segment;
+    uint64_t frame;
+    int64_t realtime_ns;
+    uint32_t sample_rate;
+    uint32_t flags;
+} JournalRecord;
+
+typedef struct
+{
+    size_t offset;
+    uint64_t sequence;
+} RecordRef;
+
+typedef struct
+{
+    uint64_t segment;
+    int confirmed;
+    int ended;
+} SegmentState;
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void build_crc_table(void)
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320U : crc >> 1;
+        crc_table[i] = crc;
+    }
+}
+
+static uint32_t crc32_update(uint32_t crc, const unsigned char *data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+        crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+static uint32_t record_crc(const JournalRecord *record)
+{
+    pthread_once(&crc_once, build_crc_table);
+    const unsigned char *fields = (const unsigned char *)record + offsetof(JournalRecord, type);
+    uint32_t crc = crc32_update(0xFFFFFFFFU, fields, sizeof(JournalRecord) - offsetof(JournalRecord, type));
+    crc = crc32_update(crc, (const unsigned char *)(record + 1), record->payload_bytes);
+    return ~crc;
+}
+
+static size_t record_size(size_t payload_bytes)
+{
+    return (sizeof(JournalRecord) + payload_bytes + JOURNAL_ALIGN - 1) & ~(size_t)(JOURNAL_ALIGN - 1);
+}
+
+static const JournalRecord *record_at(const unsigned char *map, size_t capacity, size_t offset)
+{
+    const JournalRecord *record = (const JournalRecord *)(map + offset);
+    if (record->magic != JOURNAL_MAGIC || record->payload_bytes > capacity - offset - sizeof(JournalRecord))
+        return NULL;
+    return record_crc(record) == record->crc ? record : NULL;
+}
+
+static int compare_refs(const void *a, const void *b)
+{
+    uint64_t sa = ((const RecordRef *)a)->sequence;
+    uint64_t sb = ((const RecordRef *)b)->sequence;
+    return sa < sb ? -1 : sa > sb;
+}
+
+// Every intact record, oldest first. Torn or overwritten records fail the
+// magic or CRC check and are stepped over.
+static long scan_records(const unsigned char *map, size_t capacity, RecordRef **out)
+{
+    RecordRef *refs = NULL;
+    size_t count = 0, allocated = 0;
+    size_t offset = 0;
+
+    while (offset + sizeof(JournalRecord) <= capacity)
+    {
+        const JournalRecord *record = record_at(map, capacity, offset);
+        if (!record)
+        {
+            offset += JOURNAL_ALIGN;
+            continue;
+        }
+
+        if (count == allocated)
+        {
+            allocated = allocated ? allocated * 2 : 256;
+            RecordRef *grown = realloc(refs, allocated * sizeof(RecordRef));
+            if (!grown)
+            {
+                free(refs);
+                return -1;
+            }
+            refs = grown;
+        }
+        refs[count].offset = offset;
+        refs[count].sequence = record->sequence;
+        count++;
+        offset += record_size(record->payload_bytes);
+    }
+
+    qsort(refs, count, sizeof(RecordRef), compare_refs);
+    *out = refs;
+    return (long)count;
+}
+
+int journal_open(Journal *journal, const char *path, size_t bytes, int sample_rate, int sync_ms)
+{
+    memset(journal, 0, sizeof(*journal));
+    journal->fd = -1;
+    bytes &= ~(size_t)(JOURNAL_ALIGN - 1);
+    if (bytes < JOURNAL_MIN_BYTES)
+    {
+        fprintf(stderr, "Capture journal %s: at least %d bytes are needed\n", path, JOURNAL_MIN_BYTES);
+        return -1;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+    {
+        perror("Failed to open capture journal");
+        return -1;
+    }
+
+    // A journal of another size was recovered at startup, so it starts over
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size != (off_t)bytes && ftruncate(fd, 0) != 0)
+    {
+        perror("Failed to resize capture journal");
+        close(fd);
+        return -1;
+    }
+    // Writing to a hole through the mapping on a full card would be a SIGBUS
+    int err = posix_fallocate(fd, 0, (off_t)bytes);
+    if (err != 0)
+    {
+        fprintf(stderr, "Failed to reserve %zu bytes for capture journal %s: %s\n", bytes, path, strerror(err));
+        close(fd);
+        return -1;
+    }
+
+    unsigned char *map = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        perror("Failed to map capture journal");
+        close(fd);
+        return -1;
+    }
+
+    RecordRef *refs;
+    long count = scan_records(map, bytes, &refs);
+    if (count < 0)
+    {
+        fprintf(stderr, "Failed to scan capture journal %s\n", path);
+        munmap(map, bytes);
+        close(fd);
+        return -1;
+    }
+
+    // Carries on after the newest record
+    journal->sequence = 1;
+    if (count > 0)
+    {
+        const JournalRecord *last = (const JournalRecord *)(map + refs[count - 1].offset);
+        journal->sequence = last->sequence + 1;
+        journal->offset = refs[count - 1].offset + record_size(last->payload_bytes);
+    }
+    free(refs);
+
+    journal->fd = fd;
+    journal->map = map;
+    journal->capacity = bytes;
+    journal->sample_rate = sample_rate;
+    journal->page_size = (size_t)sysconf(_SC_PAGESIZE);
+    journal->sync_ms = sync_ms;
+    journal->dirty_start = journal->offset;
+    journal->dirty_end = journal->offset;
+    clock_gettime(CLOCK_MONOTONIC, &journal->last_sync);
+    return 0;
+}
+
+void journal_close(Journal *journal)
+{
+    if (!journal->map)
+        return;
+
+    journal_sync(journal, 1);
+    munmap(journal->map, journal->capacity);
+    close(journal->fd);
+    journal->map = NULL;
+    journal->fd = -1;
+}
+
+// Writes back the pages touched since the last sync. MS_SYNC blocks the
+// worker until the card has them, which the ring buffer absorbs.
+void journal_sync(Journal *journal, int force)
+{
+    if (!journal->map || journal->dirty_end == journal->dirty_start)
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long elapsed_ms = (now.tv_sec - journal->last_sync.tv_sec) * 1000 + (now.tv_nsec - journal->last_sync.tv_nsec) / 1000000;
+    if (!force && elapsed_ms < journal->sync_ms)
+        return;
+
+    size_t start = journal->dirty_start & ~(journal->page_size - 1);
+    size_t length = journal->dirty_end - start;
+    if (msync(journal->map + start, length, MS_SYNC) != 0)
+        perror("Failed to sync capture journal");
+
+    clock_gettime(CLOCK_MONOTONIC, &journal->last_sync);
+    journal->sync_ns += (uint64_t)((journal->last_sync.tv_sec - now.tv_sec) * 1000000000LL + (journal->last_sync.tv_nsec - now.tv_nsec));
+    journal->syncs++;
+    journal->synced_bytes += length;
+    journal->dirty_start = journal->dirty_end;
+}
+
+static void write_record(Journal *journal, JournalRecordType type, uint64_t frame, int64_t realtime_ns,
+                         const void *payload, size_t payload_bytes)
+{
+    size_t size = record_size(payload_bytes);
+    if (journal->offset + size > journal->capacity)
+    {
+        // Records never straddle the end, so the rest of the lap is synced first
+        journal_sync(journal, 1);
+        journal->offset = 0;
+        journal->dirty_start = 0;
+        journal->dirty_end = 0;
+    }
+
+    JournalRecord *record = (JournalRecord *)(journal->map + journal->offset);
+    record->magic = 0;
+    record->type = type;
+    record->payload_bytes = (uint32_t)payload_bytes;
+    record->sequence = journal->sequence++;
+    record->segment = journal->segment;
+    record->frame = frame;
+    record->realtime_ns = realtime_ns;
+    record->sample_rate = (uint32_t)journal->sample_rate;
+    record->flags = journal->confirmed ? JOURNAL_FLAG_CONFIRMED : 0;
+    if (payload_bytes > 0)
+        memcpy(record + 1, payload, payload_bytes);
+    record->crc = record_crc(record);
+    record->magic = JOURNAL_MAGIC;
+
+    journal->offset += size;
+    journal->dirty_end = journal->offset;
+}
+
+static int64_t timespec_ns(const struct timespec *time)
+{
+    return (int64_t)time->tv_sec * 1000000000LL + time->tv_nsec;
+}
+
+void journal_begin(Journal *journal, uint64_t frame, const struct timespec *start, const char *final_path, const char *part_path)
+{
+    if (!journal->map)
+        return;
+
+    char payload[2080];
+    size_t final_len = strnlen(final_path, 1023);
+    size_t part_len = strnlen(part_path, sizeof(payload) - final_len - 2);
+    memcpy(payload, final_path, final_len);
+    payload[final_len] = '\0';
+    memcpy(payload + final_len + 1, part_path, part_len);
+    payload[final_len + 1 + part_len] = '\0';
+
+    journal->segment = journal->sequence;
+    journal->confirmed = 0;
+    write_record(journal, JOURNAL_START, frame, timespec_ns(start), payload, final_len + part_len + 2);
+}
+
+// Everything appended from here on carries the confirmed flag, so the
+// segment is still recognised once its START has been overwritten
+void journal_confirm(Journal *journal)
+{
+    if (!journal->map || !journal->segment || journal->confirmed)
+        return;
+
+    journal->confirmed = 1;
+    write_record(journal, JOURNAL_CONFIRM, 0, 0, NULL, 0);
+}
+
+void journal_append(Journal *journal, uint64_t frame, const struct timespec *time, const short *samples, size_t count)
+{
+    if (!journal->map || !journal->segment)
+        return;
+
+    int64_t start_ns = timespec_ns(time);
+    for (size_t done = 0; done < count; done += JOURNAL_MAX_RECORD_FRAMES)
+    {
+        size_t frames = count - done < JOURNAL_MAX_RECORD_FRAMES ? count - done : JOURNAL_MAX_RECORD_FRAMES;
+        int64_t offset_ns = (int64_t)(done * 1000000000ULL / journal->sample_rate);
+        write_record(journal, JOURNAL_AUDIO, frame + done, start_ns + offset_ns, samples + done, frames * sizeof(short));
+    }
+}
+
+void journal_end(Journal *journal)
+{
+    if (!journal->map || !journal->segment)
+        return;
+
+    // Synced at once, or a crash before the next sync would rebuild and
+    // upload a recording that was already published
+    write_record(journal, JOURNAL_END, 0, 0, NULL, 0);
+    journal_sync(journal, 1);
+    journal->segment = 0;
+    journal->confirmed = 0;
+}
+
+// A recording published before the power went is left alone
+static int recording_complete(const char *path)
+{
+    size_t samples;
+    int sample_rate;
+    return wav_file_info(path, &samples, &sample_rate) == 0 && samples > 0;
+}
+
+static int rebuild_segment(const Journal *journal, const RecordRef *refs, long count, uint64_t segment)
+{
+    const JournalRecord *start = NULL, *first = NULL;
+    size_t frames = 0;
+    for (long i = 0; i < count; i++)
+    {
+        const JournalRecord *record = (const JournalRecord *)(journal->map + refs[i].offset);
+        if (record->segment != segment)
+            continue;
+        if (record->type == JOURNAL_START && memchr(record + 1, '\0', record->payload_bytes))
+            start = record;
+        else if (record->type == JOURNAL_AUDIO && record->sample_rate > 0)
+        {
+            if (!first)
+                first = record;
+            if (record->sample_rate == first->sample_rate)
+                frames += record->payload_bytes / sizeof(short);
+        }
+    }
+    if (!first)
+        return 0;
+
+    // Without its START record the head of the segment was overwritten, and
+    // only its .part still has it
+    if (!start)
+    {
+        printf("[JOURNAL] Start of an unfinished recording was overwritten, leaving it to its .part\n");
+        return 0;
+    }
+
+    int in_rate = (int)first->sample_rate;
+    char final_path[1024], part_path[1040] = "";
+    const char *paths = (const char *)(start + 1);
+    snprintf(final_path, sizeof(final_path), "%s", paths);
+    size_t final_len = strlen(paths) + 1;
+    if (final_len < start->payload_bytes && memchr(paths + final_len, '\0', start->payload_bytes - final_len))
+        snprintf(part_path, sizeof(part_path), "%s", paths + final_len);
+
+    if (frames < MIN_RECORDING_SECONDS * in_rate)
+    {
+        printf("[JOURNAL] Unfinished recording too short (%.2fs), skipping: %s\n", (double)frames / in_rate, final_path);
+        return 0;
+    }
+    if (recording_complete(final_path))
+    {
+        printf("[JOURNAL] Already published: %s\n", final_path);
+        return 0;
+    }
+
+    // Converted and filtered the way the worker would have written it
+    int out_rate = RECORDING_SAMPLE_RATE > 0 ? RECORDING_SAMPLE_RATE : in_rate;
+
+    // The .part is replaced only if the journal has more of the transmission;
+    // otherwise recover_partial_recordings publishes it as it is
+    size_t part_frames;
+    int part_rate;
+    if (part_path[0] != '\0' && wav_file_repair(part_path) > 0 &&
+        wav_file_info(part_path, &part_frames, &part_rate) == 0 && part_rate > 0 &&
+        (uint64_t)part_frames * in_rate >= (uint64_t)frames * part_rate)
+    {
+        printf("[JOURNAL] Partial recording has all the journal holds, leaving it: %s\n", part_path);
+        return 0;
+    }
+
+    Resampler resampler;
+    if (resampler_init(&resampler, in_rate, out_rate) != 0)
+    {
+        fprintf(stderr, "Cannot rebuild %d Hz journal audio at %d Hz\n", in_rate, out_rate);
+        return -1;
+    }
+    size_t max_output = resampler_max_output(&resampler, JOURNAL_MAX_RECORD_FRAMES);
+    short *buffer = malloc(max_output * sizeof(short));
+    DspChain dsp;
+    if (!buffer || dsp_chain_init(&dsp, out_rate, max_output) != 0)
+    {
+        fprintf(stderr, "Failed to allocate journal recovery buffers\n");
+        free(buffer);
+        resampler_free(&resampler);
+        return -1;
+    }
+
+    WavWriter writer;
+    int failed = wav_writer_open(&writer, final_path, out_rate, wav_encoding_from_name(WAV_FORMAT)) != 0;
+    for (long i = 0; i < count && !failed; i++)
+    {
+        const JournalRecord *record = (const JournalRecord *)(journal->map + refs[i].offset);
+        size_t samples = record->payload_bytes / sizeof(short);
+        if (record->segment != segment || record->type != JOURNAL_AUDIO ||
+            record->sample_rate != first->sample_rate || samples > JOURNAL_MAX_RECORD_FRAMES)
+            continue;
+
+        size_t out = resampler_process(&resampler, (const short *)(record + 1), samples, buffer);
+        dsp_chain_process(&dsp, buffer, out);
+        if (wav_writer_append(&writer, buffer, out) != 0)
+        {
+            wav_writer_discard(&writer);
+            failed = 1;
+        }
+    }
+    if (!failed)
+    {
+        size_t tail = dsp_chain_flush(&dsp, buffer, max_output);
+        if (tail > 0 && wav_writer_append(&writer, buffer, tail) != 0)
+        {
+            wav_writer_discard(&writer);
+            failed = 1;
+        }
+    }
+    if (!failed && wav_writer_finalize(&writer) != 0)
+        failed = 1;
+
+    dsp_chain_free(&dsp);
+    free(buffer);
+    resampler_free(&resampler);
+    if (failed)
+    {
+        fprintf(stderr, "Failed to rebuild %s from the capture journal\n", final_path);
+        return -1;
+    }
+
+    // The journal has more than the .part, so it replaces it. Unless the
+    // segment was a later part, the writer has already reused its name.
+    if (part_path[0] != '\0' && strcmp(part_path, writer.part_path) != 0 && remove(part_path) == 0)
+        printf("[JOURNAL] Replaced partial recording: %s\n", part_path);
+    printf("[JOURNAL] Rebuilt unfinished recording: %s (%.2fs)\n", final_path, (double)frames / in_rate);
+    return 1;
+}
+
+int journal_recover(const char *path)
+{
+    struct stat file_stat;
+    if (stat(path, &file_stat) != 0)
+    {
+        perror("Failed to stat capture journal");
+        return -1;
+    }
+
+    Journal journal;
+    if (journal_open(&journal, path, (size_t)file_stat.st_size, 0, 0) != 0)
+        return -1;
+
+    RecordRef *refs;
+    long count = scan_records(journal.map, journal.capacity, &refs);
+    if (count < 0)
+    {
+        journal_close(&journal);
+        return -1;
+    }
+
+    SegmentState *segments = NULL;
+    size_t segment_count = 0;
+    for (long i = 0; i < count; i++)
+    {
+        const JournalRecord *record = (const JournalRecord *)(journal.map + refs[i].offset);
+        if (record->segment == 0)
+            continue;
+
+        SegmentState *state = NULL;
+        for (size_t s = 0; s < segment_count && !state; s++)
+        {
+            if (segments[s].segment == record->segment)
+                state = &segments[s];
+        }
+        if (!state)
+        {
+            SegmentState *grown = realloc(segments, (segment_count + 1) * sizeof(SegmentState));
+            if (!grown)
+                continue;
+            segments = grown;
+            state = &segments[segment_count++];
+            memset(state, 0, sizeof(*state));
+            state->segment = record->segment;
+        }
+        state->confirmed |= (record->flags & JOURNAL_FLAG_CONFIRMED) != 0;
+        state->ended |= record->type == JOURNAL_END;
+    }
+
+    int rebuilt = 0;
+    for (size_t s = 0; s < segment_count; s++)
+    {
+        if (segments[s].ended)
+            continue;
+        // A false trigger never reached confirmation and is dropped like one
+        if (segments[s].confirmed && rebuild_segment(&journal, refs, count, segments[s].segment) > 0)
+            rebuilt++;
+
+        journal.segment = segments[s].segment;
+        journal_end(&journal);
+    }
+
+    free(segments);
+    free(refs);
+    journal_close(&journal);
+    return rebuilt;
+}
+
+void journal_recover_directory(const char *directory)
+{
+    DIR *dir = opendir(directory);
+    if (!dir)
+    {
+        perror("Failed to open journal directory");
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        size_t name_len = strlen(entry->d_name);
+        size_t suffix_len = strlen(JOURNAL_SUFFIX);
+        if (name_len <= suffix_len || strcmp(entry->d_name + name_len - suffix_len, JOURNAL_SUFFIX) != 0)
+            continue;
+
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        journal_recover(path);
+    }
+    closedir(dir);
+}
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "h/latency.h"
+#include "h/write_wav_file.h"
+
+typedef struct
+{
+    char name[256];
+    struct timespec closed;
+    double publish_ms;
+} LatencyEntry;
+
+static LatencyEntry entries[LATENCY_TRACKED_FILES];
+static size_t next_entry;
+static pthread_mutex_t latency_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned long upload_count;
+static double total_ms;
+static double worst_ms;
+
+// Directory, upload format and the .part suffix all change on the way to the
+// uploader; only the base name stays the same
+static void recording_key(const char *path, char *key, size_t size)
+{
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    snprintf(key, size, "%s", name);
+
+    size_t len = strlen(key), suffix_len = strlen(WAV_PART_SUFFIX);
+    if (len > suffix_len && strcmp(key + len - suffix_len, WAV_PART_SUFFIX) == 0)
+        key[len - suffix_len] = '\0';
+    char *extension = strrchr(key, '.');
+    if (extension)
+        *extension = '\0';
+}
+
+static double ms_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static LatencyEntry *find_entry(const char *key)
+{
+    for (size_t i = 0; i < LATENCY_TRACKED_FILES; i++)
+    {
+        if (entries[i].name[0] != '\0' && strcmp(entries[i].name, key) == 0)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+void latency_squelch_closed(const char *path)
+{
+    pthread_mutex_lock(&latency_lock);
+    // Oldest entries are reused; they belong to files that were never uploaded
+    LatencyEntry *entry = &entries[next_entry];
+    next_entry = (next_entry + 1) % LATENCY_TRACKED_FILES;
+    recording_key(path, entry->name, sizeof(entry->name));
+    clock_gettime(CLOCK_MONOTONIC, &entry->closed);
+    entry->publish_ms = -1;
+    pthread_mutex_unlock(&latency_lock);
+}
+
+void latency_published(const char *path)
+{
+    char key[256];
+    recording_key(path, key, sizeof(key));
+
+    pthread_mutex_lock(&latency_lock);
+    LatencyEntry *entry = find_entry(key);
+    if (entry)
+        entry->publish_ms = ms_since(&entry->closed);
+    pthread_mutex_unlock(&latency_lock);
+}
+
+void latency_upload_started(const char *path)
+{
+    char key[256];
+    recording_key(path, key, sizeof(key));
+
+    pthread_mutex_lock(&latency_lock);
+    LatencyEntry *entry = find_entry(key);
+    if (!entry)
+    {
+        // Offline retries and files from before a restart are not tracked
+        pthread_mutex_unlock(&latency_lock);
+        return;
+    }
+
+    double upload_ms = ms_since(&entry->closed);
+    double publish_ms = entry->publish_ms;
+    entry->name[0] = '\0';
+
+    upload_count++;
+    total_ms += upload_ms;
+    if (upload_ms > worst_ms)
+        worst_ms = upload_ms;
+
+    printf("[LATENCY] %s | Squelch close -> published: %.0f ms | -> upload start: %.0f ms | Average: %.0f ms | Worst: %.0f ms over %lu uploads\n",
+           key,
+           publish_ms,
+           upload_ms,
+           total_ms / upload_count,
+           worst_ms,
+           upload_count);
+    pthread_mutex_unlock(&latency_lock);
+}
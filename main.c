@@ -2,7 +2,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
-#include <uv.h>
 #include <pthread.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -10,10 +9,19 @@
 #include <jack/jack.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/inotify.h>
 #include "h/telegramSend.h"
 #include "h/recordAudio.h"
 #include "h/config.h"
 #include "h/open_serial_port.h"
+#include "h/write_wav_file.h"
+#include "h/encoder.h"
+#include "h/spectrogram.h"
+#include "h/profiler.h"
+#include "h/replay.h"
+#include "h/journal.h"
+#include "h/upload_queue.h"
+#include "h/file_move.h"
 
 // Declaration for our offline upload function
 extern int send_offline_to_telegram(const char *file_path, const char *bot_token, char **chat_ids);
@@ -47,6 +55,19 @@ int create_directory_if_not_exists(const char *dir_path)
     return 0;
 }
 
+static int has_suffix(const char *name, const char *suffix)
+{
+    size_t name_len = strlen(name);
+    size_t suffix_len = strlen(suffix);
+    return name_len >= suffix_len && strcmp(name + name_len - suffix_len, suffix) == 0;
+}
+
+// Finished recordings, in any upload format; .part files are still being written
+static int is_recording_file(const char *name)
+{
+    return has_suffix(name, ".wav") || has_suffix(name, ".opus") || has_suffix(name, ".flac");
+}
+
 // Alphabetical compare for qsort (ensures chronological sequence since layout is YYYYMMDD_HHMMSS)
 int compare_strings(const void *a, const void *b)
 {
@@ -75,7 +96,7 @@ void process_offline_files(void)
     {
         if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
             continue;
-        if (strstr(entry->d_name, ".wav") == NULL)
+        if (!is_recording_file(entry->d_name))
             continue;
 
         if (count >= capacity)
@@ -107,6 +128,29 @@ void process_offline_files(void)
 
         printf("[OFFLINE SYNC] Found %d backlogged files. Syncing...\n", count);
 
+        // The backlog can grow for as long as the link is down; keep it small.
+        // Done here rather than when a file is cached, so neither a recorder
+        // nor an upload worker waits for the encode.
+        for (int i = 0; i < count && OFFLINE_FLAC; i++)
+        {
+            if (!has_suffix(files[i], ".wav"))
+                continue;
+
+            char wav_path[512];
+            snprintf(wav_path, sizeof(wav_path), "./offline/%s", files[i]);
+            size_t name_len = strlen(files[i]);
+            char *flac_name = malloc(name_len + 2);
+            if (!flac_name || compress_to_flac(wav_path) != 0)
+            {
+                free(flac_name);
+                continue;
+            }
+            snprintf(flac_name, name_len + 2, "%.*s.flac", (int)(name_len - strlen(".wav")), files[i]);
+            printf("[OFFLINE] Compressed cached recording to FLAC: %s\n", flac_name);
+            free(files[i]);
+            files[i] = flac_name;
+        }
+
         for (int i = 0; i < count; i++)
         {
             char full_path[512];
@@ -131,14 +175,67 @@ void process_offline_files(void)
 
 void *offline_sync_thread(void *arg)
 {
+    // Starts with whatever is left from previous runs, off the main thread
     while (1)
     {
-        sleep(30); // Checks the offline directory every 30 seconds
         process_offline_files();
+        sleep(30); // Checks the offline directory every 30 seconds
     }
     return NULL;
 }
 
+// Recordings are streamed to <name>.wav.part and renamed when complete. Any
+// .part left behind by a crash gets its header fixed up and is published.
+void recover_partial_recordings(const char *directory)
+{
+    DIR *dir;
+    struct dirent *entry;
+
+    if ((dir = opendir(directory)) == NULL)
+    {
+        perror("Failed to open directory");
+        return;
+    }
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        // An interrupted encode still has its WAV next to it, which is published below
+        if (has_suffix(entry->d_name, ".opus" WAV_PART_SUFFIX) || has_suffix(entry->d_name, ".flac" WAV_PART_SUFFIX))
+        {
+            char encoded_part[512];
+            snprintf(encoded_part, sizeof(encoded_part), "%s/%s", directory, entry->d_name);
+            remove(encoded_part);
+            continue;
+        }
+        if (!has_suffix(entry->d_name, ".wav" WAV_PART_SUFFIX))
+            continue;
+
+        char part_path[512], final_path[512];
+        snprintf(part_path, sizeof(part_path), "%s/%s", directory, entry->d_name);
+        snprintf(final_path, sizeof(final_path), "%s/%.*s", directory,
+                 (int)(strlen(entry->d_name) - strlen(WAV_PART_SUFFIX)), entry->d_name);
+
+        long samples = wav_file_repair(part_path);
+        if (samples <= 0)
+        {
+            printf("Discarding unrecoverable partial recording: %s\n", part_path);
+            remove(part_path);
+            continue;
+        }
+
+        if (rename(part_path, final_path) == 0)
+        {
+            printf("Recovered partial recording: %s (%ld samples)\n", final_path, samples);
+        }
+        else
+        {
+            perror("Failed to publish recovered recording");
+        }
+    }
+
+    closedir(dir);
+}
+
 void send_existing_files(const char *directory)
 {
     DIR *dir;
@@ -156,7 +253,7 @@ void send_existing_files(const char *directory)
             continue;
         if (strstr(entry->d_name, ".wav.wav") != NULL)
             continue;
-        if (strstr(entry->d_name, ".wav") == NULL)
+        if (!is_recording_file(entry->d_name))
             continue;
 
         char file_path[512];
@@ -168,7 +265,8 @@ void send_existing_files(const char *directory)
             if (S_ISREG(file_stat.st_mode))
             {
                 printf("Sending existing file: %s\n", file_path);
-                send_to_telegram(file_path, BOT_TOKEN, CHAT_IDS);
+                if (upload_queue_submit(file_path, UPLOAD_PRIORITY_BACKLOG) < 0)
+                    send_to_telegram(file_path, BOT_TOKEN, CHAT_IDS);
             }
         }
         else
@@ -180,141 +278,193 @@ void send_existing_files(const char *directory)
     closedir(dir);
 }
 
-void on_new_file_created(uv_fs_event_t *handle, const char *filename, int events, int status)
+// Moves a recording that appeared in <directory> into ./processing and uploads it
+static void handle_new_file(const char *directory, const char *filename)
 {
-    if (filename == NULL)
-        return;
     if (strstr(filename, ".wav.wav") != NULL)
         return;
-    if (strstr(filename, ".wav") == NULL)
+    if (!is_recording_file(filename))
         return;
 
-    if ((events & UV_RENAME) || (events & UV_CHANGE))
-    {
-        const char *directory = (const char *)handle->data;
-        char full_path[512];
-        snprintf(full_path, sizeof(full_path), "%s/%s", directory, filename);
+    char full_path[512];
+    snprintf(full_path, sizeof(full_path), "%s/%s", directory, filename);
 
-        sleep(1);
-
-        struct stat file_stat;
-        if (stat(full_path, &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
-            return;
-
-        printf("New file detected: %s\n", full_path);
-
-        create_directory_if_not_exists("./processing");
-
-        char dest_path[512];
-        snprintf(dest_path, sizeof(dest_path), "./processing/%s", filename);
-
-        FILE *src = fopen(full_path, "rb");
-        if (!src)
-        {
-            perror("Failed to open source file");
-            return;
-        }
-
-        FILE *dst = fopen(dest_path, "wb");
-        if (!dst)
-        {
-            perror("Failed to open destination file");
-            fclose(src);
-            return;
-        }
-
-        char buffer[4096];
-        size_t bytes;
-        while ((bytes = fread(buffer, 1, sizeof(buffer), src)) > 0)
-        {
-            fwrite(buffer, 1, bytes, dst);
-        }
+    // The recorder's own files are already on their way to the uploader
+    if (upload_queue_owns(full_path))
+        return;
 
-        fclose(src);
-        fclose(dst);
+    // Events only arrive once a file is complete, renamed into place or
+    // closed by its writer, so there is nothing to wait for
+    struct stat file_stat;
+    if (stat(full_path, &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+        return;
 
-        if (remove(full_path) == 0)
-        {
-            printf("Removed original file: %s\n", full_path);
-        }
-        else
-        {
-            perror("Error removing original file");
-        }
+    printf("New file detected: %s\n", full_path);
 
-        printf("Copied to processing: %s\n", dest_path);
+    create_directory_if_not_exists("./processing");
 
-        struct stat dest_stat;
-        if (stat(dest_path, &dest_stat) != 0)
-        {
-            perror("Failed to stat copied file");
-            return;
-        }
+    char dest_path[512];
+    snprintf(dest_path, sizeof(dest_path), "./processing/%s", filename);
 
-        if (dest_stat.st_size < 102400)
-        {
-            printf("File too small (<100KB), deleting: %s\n", dest_path);
-            remove(dest_path);
-            return;
-        }
+    // A rename unless ./processing is on another filesystem
+    uint64_t copy_start = profiler_ticks();
+    FileMoveStats move;
+    if (file_move(full_path, dest_path, MOVE_FSYNC, &move) != 0)
+        return;
+    profiler_record(PROFILE_COPY, copy_start, 0);
+
+    printf("[MOVE] %s | Method: %s | Size: %ld KB | Copied: %ld KB | Time: %.2f ms\n",
+           dest_path,
+           file_move_method_name(move.method),
+           (long)(move.bytes / 1024),
+           (long)(move.copied / 1024),
+           move.seconds * 1000);
+
+    // Encoded files were already checked by the encoder; the length of a
+    // WAV is taken from its header since the sample rate is configurable
+    size_t samples;
+    int sample_rate;
+    if (has_suffix(dest_path, ".wav") &&
+        (wav_file_info(dest_path, &samples, &sample_rate) != 0 || sample_rate <= 0 ||
+         (double)samples / sample_rate < MIN_RECORDING_SECONDS))
+    {
+        printf("File too short (<%.0fs), deleting: %s\n", MIN_RECORDING_SECONDS, dest_path);
+        remove(dest_path);
+        return;
+    }
 
+    // Uploaded here only if the worker pool could not be started
+    if (upload_queue_submit(dest_path, UPLOAD_PRIORITY_FOUND) < 0)
+    {
+        uint64_t upload_start = profiler_ticks();
         send_to_telegram(dest_path, BOT_TOKEN, CHAT_IDS);
+        profiler_record(PROFILE_UPLOAD, upload_start, 0);
     }
 }
 
-void *monitor_directory_thread(void *arg)
+// Events were dropped while the inotify queue was full, so look for anything
+// published in the meantime
+static void rescan_directory(const char *directory)
 {
-    uv_loop_t loop;
+    DIR *dir = opendir(directory);
+    if (!dir)
+    {
+        perror("Failed to open directory");
+        return;
+    }
 
-    if (uv_loop_init(&loop))
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
     {
-        fprintf(stderr, "Error initializing uv loop\n");
-        return NULL;
+        if (entry->d_type == DT_REG || entry->d_type == DT_UNKNOWN)
+            handle_new_file(directory, entry->d_name);
     }
+    closedir(dir);
+}
 
-    uv_fs_event_t fs_event;
-    int status = uv_fs_event_init(&loop, &fs_event);
-    if (status != 0)
+void *monitor_directory_thread(void *arg)
+{
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0)
     {
-        fprintf(stderr, "Error initializing fs event: %s\n", uv_strerror(status));
-        uv_loop_close(&loop);
+        perror("Error initializing inotify");
         return NULL;
     }
 
-    fs_event.data = RECORDING_DIRECTORY;
-
-    status = uv_fs_event_start(&fs_event, on_new_file_created, RECORDING_DIRECTORY, UV_FS_EVENT_RECURSIVE);
-    if (status != 0)
+    // Recordings appear by rename once complete; IN_CLOSE_WRITE covers files
+    // written in place by other tools, once their writer is done
+    if (inotify_add_watch(fd, RECORDING_DIRECTORY, IN_MOVED_TO | IN_CLOSE_WRITE | IN_ONLYDIR) < 0)
     {
-        fprintf(stderr, "Error starting file event monitoring: %s\n", uv_strerror(status));
-        uv_fs_event_stop(&fs_event);
-        uv_loop_close(&loop);
+        fprintf(stderr, "Error starting file event monitoring on %s: %s\n", RECORDING_DIRECTORY, strerror(errno));
+        close(fd);
         return NULL;
     }
 
     printf("Monitoring directory: %s\n", RECORDING_DIRECTORY);
-    uv_run(&loop, UV_RUN_DEFAULT);
 
-    uv_fs_event_stop(&fs_event);
-    uv_loop_close(&loop);
+    char buffer[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (1)
+    {
+        ssize_t len = read(fd, buffer, sizeof(buffer));
+        if (len < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("Error reading file events");
+            break;
+        }
+
+        for (char *p = buffer; p < buffer + len;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                fprintf(stderr, "File event queue overflowed, rescanning %s\n", RECORDING_DIRECTORY);
+                rescan_directory(RECORDING_DIRECTORY);
+            }
+            else if (event->mask & IN_IGNORED)
+            {
+                fprintf(stderr, "Directory %s is no longer monitored\n", RECORDING_DIRECTORY);
+                close(fd);
+                return NULL;
+            }
+            else if (event->len > 0 && !(event->mask & IN_ISDIR))
+            {
+                handle_new_file(RECORDING_DIRECTORY, event->name);
+            }
+        }
+    }
+
+    close(fd);
     return NULL;
 }
 
+// Runs on an upload worker, for recordings the recorder publishes and for
+// files found on disk
+static void on_upload_ready(const UploadJob *job)
+{
+    uint64_t upload_start = profiler_ticks();
+    if (job->has_info)
+    {
+        printf("Uploading %s | Radio: %s | Length: %.2fs | Peak: %d\n", job->path, job->info.radio, job->info.seconds, job->info.peak);
+        send_recording_to_telegram(job->path, &job->info, BOT_TOKEN, CHAT_IDS);
+    }
+    else
+    {
+        printf("Uploading %s\n", job->path);
+        send_to_telegram(job->path, BOT_TOKEN, CHAT_IDS);
+    }
+    profiler_record(PROFILE_UPLOAD, upload_start, 0);
+}
+
+// Runs on a spectrogram worker, after the recording itself was handed on
+static void on_spectrogram_written(const char *png_path, const char *recording_path)
+{
+    if (SPECTROGRAM_TELEGRAM)
+        send_telegram_photo(png_path, recording_path, BOT_TOKEN, CHAT_IDS);
+}
+
 void *recorder_thread(void *arg)
 {
-    printf("Starting recording on device with COM port %s\n", COM_PORT);
+    printf("Starting recording\n");
     send_telegram_status(BOT_TOKEN, CHAT_IDS, "Rozpoczynanie nagrywania");
     fflush(stdout);
-    recorder(COM_PORT);
+    recorder();
     return NULL;
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
     snd_lib_error_set_handler(silent_alsa_error);
     setvbuf(stdout, NULL, _IOLBF, 0);
     setvbuf(stderr, NULL, _IOLBF, 0);
 
+    // Offline: no sound card, no uploads
+    if (argc > 1 && strcmp(argv[1], "--replay") == 0)
+        return replay_main(argc - 1, argv + 1);
+
     if (load_env(".env") != 0)
     {
         printf("Failed to load config\n");
@@ -329,18 +479,24 @@ int main(void)
     // Ensure offline directory is up and ready
     create_directory_if_not_exists("./offline");
 
-    pthread_t recorder_thread_id, monitor_thread_id, radio_thread_id, offline_thread_id;
+    pthread_t recorder_thread_id, monitor_thread_id, offline_thread_id;
 
-    send_existing_files(RECORDING_DIRECTORY);
-    
-    // Process any remaining offline files from previous execution cycles
-    process_offline_files();
+    // Before any thread starts, so SIGUSR1 is handled process-wide
+    profiler_init();
 
-    if (pthread_create(&radio_thread_id, NULL, serial_monitor_thread, (void *)COM_PORT) != 0)
-    {
-        perror("Failed to create radio serial thread");
-        return 1;
-    }
+    telegram_init();
+    // Before the encoder, which hands every recording it publishes to the
+    // uploaders. Whatever does not fit in the queue goes to the offline cache.
+    upload_queue_start(UPLOAD_WORKERS, on_upload_ready, cache_offline_recording);
+    // Before the encoder, which only runs for WAV uploads if there is a spectrogram to draw
+    spectrogram_start(on_spectrogram_written);
+    encoder_start();
+
+    // Before the .part files are repaired: the journal also holds what never reached them
+    if (JOURNAL_DIRECTORY[0] != '\0' && create_directory_if_not_exists(JOURNAL_DIRECTORY) == 0)
+        journal_recover_directory(JOURNAL_DIRECTORY);
+    recover_partial_recordings(RECORDING_DIRECTORY);
+    send_existing_files(RECORDING_DIRECTORY);
 
     if (pthread_create(&recorder_thread_id, NULL, recorder_thread, NULL) != 0)
     {
@@ -363,7 +519,6 @@ int main(void)
 
     pthread_join(recorder_thread_id, NULL);
     pthread_join(monitor_thread_id, NULL);
-    pthread_join(radio_thread_id, NULL);
     pthread_join(offline_thread_id, NULL);
 
     printf("All files processed successfully.\n");
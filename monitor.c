@@ -0,0 +1,335 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "h/monitor.h"
+#include "h/config.h"
+
+#define MONITOR_RETRY_SECONDS 10
+#define MONITOR_STALL_SECONDS 2
+#define MONITOR_ADAPT_STEP_MS 10
+#define MONITOR_STEADY_SECONDS 30
+// Time constant of the fill average that drives drift compensation
+#define MONITOR_FILL_SMOOTHING_SECONDS 2.0
+// Rate correction per second of fill error, and its limit (2000 ppm)
+#define MONITOR_DRIFT_GAIN 0.05
+#define MONITOR_MAX_DRIFT 0.002
+
+static int find_output_device(const char *name)
+{
+    if (name[0] == '\0')
+        return Pa_GetDefaultOutputDevice();
+
+    int numDevices = Pa_GetDeviceCount();
+    for (int i = 0; i < numDevices; i++)
+    {
+        const PaDeviceInfo *info = Pa_GetDeviceInfo(i);
+        if (info && info->maxOutputChannels > 0 && strstr(info->name, name) != NULL)
+            return i;
+    }
+    return paNoDevice;
+}
+
+static size_t buffered_frames(Monitor *monitor)
+{
+    size_t pending = monitor->input_frames > 0 ? monitor->input_frames - 1 : 0;
+    return ring_buffer_fill(&monitor->ring) / monitor->capture_channels + pending;
+}
+
+// Pulls frames from the ring until the local buffer holds count frames
+static void fill_input(Monitor *monitor, size_t count)
+{
+    int channels = monitor->capture_channels;
+    if (count > monitor->input_capacity)
+        count = monitor->input_capacity;
+    if (monitor->input_frames >= count)
+        return;
+
+    size_t read = ring_buffer_read(&monitor->ring, monitor->input + monitor->input_frames * channels,
+                                   (count - monitor->input_frames) * channels);
+    monitor->input_frames += read / channels;
+}
+
+// Linear interpolation between input frames at a position that advances by
+// ratio per output frame. Capture channels are folded onto the output
+// channels, so a stereo speaker plays channel 1 left and channel 2 right.
+static size_t play(Monitor *monitor, short *output, size_t frames)
+{
+    int channels = monitor->capture_channels;
+    int outputs = monitor->output_channels;
+    const short *input = monitor->input;
+    if (monitor->input_frames == 0)
+        return 0;
+
+    size_t played = 0;
+    for (; played < frames; played++)
+    {
+        size_t index = (size_t)monitor->phase;
+        if (index + 1 >= monitor->input_frames)
+            break;
+
+        double fraction = monitor->phase - index;
+        int mix[MONITOR_MAX_CHANNELS] = {0};
+        for (int c = 0; c < channels; c++)
+        {
+            double a = input[index * channels + c];
+            double b = input[(index + 1) * channels + c];
+            mix[c % outputs] += (int)lrint(a + (b - a) * fraction);
+        }
+        for (int o = 0; o < outputs; o++)
+        {
+            int v = mix[o];
+            output[played * outputs + o] = (short)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+        }
+        monitor->phase += monitor->ratio;
+    }
+
+    // Keep the frame the position now points into; it starts the next buffer
+    size_t consumed = (size_t)monitor->phase;
+    if (consumed > monitor->input_frames - 1)
+        consumed = monitor->input_frames - 1;
+    memmove(monitor->input, monitor->input + consumed * channels,
+            (monitor->input_frames - consumed) * channels * sizeof(short));
+    monitor->input_frames -= consumed;
+    monitor->phase -= consumed;
+    return played;
+}
+
+// Runs in the output device's real-time thread
+static int monitor_callback(const void *inputBuffer, void *outputBuffer,
+                            unsigned long framesPerBuffer,
+                            const PaStreamCallbackTimeInfo *timeInfo,
+                            PaStreamCallbackFlags statusFlags,
+                            void *userData)
+{
+    Monitor *monitor = (Monitor *)userData;
+    short *output = (short *)outputBuffer;
+    size_t frames = framesPerBuffer;
+    atomic_fetch_add_explicit(&monitor->callback_count, 1, memory_order_relaxed);
+
+    size_t fill = buffered_frames(monitor);
+    size_t played = 0;
+
+    if (monitor->buffering)
+    {
+        if (fill >= monitor->target_frames)
+        {
+            monitor->buffering = 0;
+            monitor->average_fill = fill;
+        }
+    }
+    else if (fill > 2 * monitor->target_frames + frames)
+    {
+        // After a stall the backlog is stale; skip straight back to the target
+        size_t skip = fill - monitor->target_frames;
+        size_t dropped = ring_buffer_discard(&monitor->ring, skip * monitor->capture_channels) / monitor->capture_channels;
+        atomic_fetch_add_explicit(&monitor->skipped_frames, dropped, memory_order_relaxed);
+        fill -= dropped;
+        monitor->average_fill = fill;
+    }
+
+    if (!monitor->buffering)
+    {
+        double alpha = frames / (monitor->sample_rate * MONITOR_FILL_SMOOTHING_SECONDS);
+        monitor->average_fill += (fill - monitor->average_fill) * alpha;
+
+        double error = (monitor->average_fill - monitor->target_frames) / monitor->sample_rate;
+        double correction = error * MONITOR_DRIFT_GAIN;
+        if (correction > MONITOR_MAX_DRIFT)
+            correction = MONITOR_MAX_DRIFT;
+        if (correction < -MONITOR_MAX_DRIFT)
+            correction = -MONITOR_MAX_DRIFT;
+        monitor->ratio = 1.0 + correction;
+
+        fill_input(monitor, (size_t)(monitor->phase + frames * monitor->ratio) + 2);
+        played = play(monitor, output, frames);
+
+        if (played < frames)
+        {
+            // Underrun: rebuffer, with a little more headroom than before
+            atomic_fetch_add_explicit(&monitor->underruns, 1, memory_order_relaxed);
+            monitor->buffering = 1;
+            monitor->steady_frames = 0;
+            size_t step = (size_t)monitor->sample_rate * MONITOR_ADAPT_STEP_MS / 1000;
+            if (monitor->target_frames + step <= monitor->max_target_frames)
+                monitor->target_frames += step;
+        }
+        else if ((monitor->steady_frames += frames) >= (uint64_t)monitor->sample_rate * MONITOR_STEADY_SECONDS)
+        {
+            monitor->steady_frames = 0;
+            size_t step = (size_t)monitor->sample_rate * MONITOR_ADAPT_STEP_MS / 1000;
+            if (monitor->target_frames >= monitor->min_target_frames + step)
+                monitor->target_frames -= step;
+        }
+    }
+
+    memset(output + played * monitor->output_channels, 0, (frames - played) * monitor->output_channels * sizeof(short));
+
+    atomic_store_explicit(&monitor->reported_target, monitor->target_frames, memory_order_relaxed);
+    atomic_store_explicit(&monitor->reported_fill, (size_t)monitor->average_fill, memory_order_relaxed);
+    atomic_store_explicit(&monitor->drift_ppm, lrint((monitor->ratio - 1.0) * 1e6), memory_order_relaxed);
+    return paContinue;
+}
+
+int monitor_init(Monitor *monitor, int capture_channels, int sample_rate)
+{
+    memset(monitor, 0, sizeof(*monitor));
+    snprintf(monitor->device_name, sizeof(monitor->device_name), "%s", MONITOR_DEVICE);
+    monitor->capture_channels = capture_channels < MONITOR_MAX_CHANNELS ? capture_channels : MONITOR_MAX_CHANNELS;
+    monitor->sample_rate = sample_rate;
+
+    int latency_ms = MONITOR_LATENCY_MS;
+    if (latency_ms < MONITOR_ADAPT_STEP_MS)
+        latency_ms = MONITOR_ADAPT_STEP_MS;
+    if (latency_ms > MONITOR_MAX_LATENCY_MS)
+        latency_ms = MONITOR_MAX_LATENCY_MS;
+    monitor->min_target_frames = (size_t)sample_rate * latency_ms / 1000;
+    monitor->max_target_frames = (size_t)sample_rate * MONITOR_MAX_LATENCY_MS / 1000;
+    monitor->target_frames = monitor->min_target_frames;
+
+    // Room for a backlog past twice the largest target, so a stall is detected
+    // and skipped rather than just filling the ring
+    if (ring_buffer_init(&monitor->ring, 3 * monitor->max_target_frames * monitor->capture_channels) != 0)
+        return -1;
+
+    monitor->input_capacity = (size_t)(MONITOR_FRAMES_PER_BUFFER * 4 * (1.0 + MONITOR_MAX_DRIFT)) + 2;
+    monitor->input = malloc(monitor->input_capacity * monitor->capture_channels * sizeof(short));
+    if (!monitor->input)
+    {
+        ring_buffer_free(&monitor->ring);
+        return -1;
+    }
+    monitor->ratio = 1.0;
+    monitor->buffering = 1;
+    return 0;
+}
+
+static void close_stream(Monitor *monitor)
+{
+    if (!monitor->stream)
+        return;
+    Pa_AbortStream(monitor->stream);
+    Pa_CloseStream(monitor->stream);
+    monitor->stream = NULL;
+}
+
+void monitor_free(Monitor *monitor)
+{
+    close_stream(monitor);
+    ring_buffer_free(&monitor->ring);
+    free(monitor->input);
+    monitor->input = NULL;
+}
+
+// Called from the capture callback: never blocks. When the output is not
+// draining the ring the block is simply dropped.
+void monitor_push(Monitor *monitor, const short *frames, size_t count)
+{
+    if (monitor->capture_channels > 0)
+        ring_buffer_write(&monitor->ring, frames, count * monitor->capture_channels);
+}
+
+static void open_stream(Monitor *monitor)
+{
+    PaStreamParameters outputParams;
+    outputParams.device = find_output_device(monitor->device_name);
+    if (outputParams.device == paNoDevice)
+    {
+        fprintf(stderr, "[MONITOR] No output device%s%s, retrying in %ds. Recording continues.\n",
+                monitor->device_name[0] ? " matching " : "", monitor->device_name, MONITOR_RETRY_SECONDS);
+        return;
+    }
+
+    const PaDeviceInfo *info = Pa_GetDeviceInfo(outputParams.device);
+    int outputs = info->maxOutputChannels < monitor->capture_channels ? info->maxOutputChannels : monitor->capture_channels;
+    outputParams.channelCount = outputs;
+    outputParams.sampleFormat = paInt16;
+    outputParams.suggestedLatency = info->defaultLowOutputLatency;
+    outputParams.hostApiSpecificStreamInfo = NULL;
+
+    // Playback starts from fresh audio, not from what piled up while closed
+    monitor->output_channels = outputs;
+    monitor->input_frames = 0;
+    monitor->phase = 0;
+    monitor->ratio = 1.0;
+    monitor->buffering = 1;
+    ring_buffer_discard(&monitor->ring, ring_buffer_fill(&monitor->ring));
+
+    PaError err = Pa_OpenStream(&monitor->stream, NULL, &outputParams, monitor->sample_rate,
+                                MONITOR_FRAMES_PER_BUFFER, paClipOff, monitor_callback, monitor);
+    if (err == paNoError)
+    {
+        err = Pa_StartStream(monitor->stream);
+        if (err != paNoError)
+        {
+            Pa_CloseStream(monitor->stream);
+            monitor->stream = NULL;
+        }
+    }
+    if (err != paNoError)
+    {
+        monitor->stream = NULL;
+        fprintf(stderr, "[MONITOR] Could not open %s: %s, retrying in %ds. Recording continues.\n",
+                info->name, Pa_GetErrorText(err), MONITOR_RETRY_SECONDS);
+        return;
+    }
+
+    const PaStreamInfo *stream_info = Pa_GetStreamInfo(monitor->stream);
+    monitor->output_latency = stream_info ? stream_info->outputLatency : outputParams.suggestedLatency;
+    monitor->last_callback_count = atomic_load_explicit(&monitor->callback_count, memory_order_relaxed);
+    monitor->stalled_seconds = 0;
+    printf("[MONITOR] Live listen on %s | %d channel(s) | Target latency: %d ms\n",
+           info->name, outputs, MONITOR_LATENCY_MS);
+}
+
+// Called once a second by the recorder. Opens the output when it is missing,
+// closes it when its callback has stopped, and reports the latency breakdown.
+void monitor_poll(Monitor *monitor, int force_report)
+{
+    time_t now = time(NULL);
+
+    if (monitor->stream)
+    {
+        unsigned long callbacks = atomic_load_explicit(&monitor->callback_count, memory_order_relaxed);
+        if (callbacks == monitor->last_callback_count && ++monitor->stalled_seconds >= MONITOR_STALL_SECONDS)
+        {
+            fprintf(stderr, "[MONITOR] Output stalled, reopening in %ds. Recording continues.\n", MONITOR_RETRY_SECONDS);
+            close_stream(monitor);
+            monitor->next_open_attempt = now + MONITOR_RETRY_SECONDS;
+        }
+        else if (callbacks != monitor->last_callback_count)
+        {
+            monitor->stalled_seconds = 0;
+        }
+        monitor->last_callback_count = callbacks;
+    }
+
+    if (!monitor->stream)
+    {
+        if (now >= monitor->next_open_attempt)
+        {
+            open_stream(monitor);
+            if (!monitor->stream)
+                monitor->next_open_attempt = now + MONITOR_RETRY_SECONDS;
+        }
+        return;
+    }
+
+    unsigned long underruns = atomic_load_explicit(&monitor->underruns, memory_order_relaxed);
+    if (!force_report && underruns == monitor->reported_underruns)
+        return;
+    monitor->reported_underruns = underruns;
+
+    double buffer_ms = 1000.0 * atomic_load_explicit(&monitor->reported_fill, memory_order_relaxed) / monitor->sample_rate;
+    double target_ms = 1000.0 * atomic_load_explicit(&monitor->reported_target, memory_order_relaxed) / monitor->sample_rate;
+    printf("[MONITOR] Latency: %.0f ms (input %.0f + buffer %.0f + output %.0f) | Target: %.0f ms | Drift: %+ld ppm | Underruns: %lu | Skipped: %.0f ms | Dropped at capture: %.0f ms\n",
+           monitor->input_latency * 1000 + buffer_ms + monitor->output_latency * 1000,
+           monitor->input_latency * 1000,
+           buffer_ms,
+           monitor->output_latency * 1000,
+           target_ms,
+           atomic_load_explicit(&monitor->drift_ppm, memory_order_relaxed),
+           underruns,
+           1000.0 * atomic_load_explicit(&monitor->skipped_frames, memory_order_relaxed) / monitor->sample_rate,
+           1000.0 * atomic_load_explicit(&monitor->ring.dropped_frames, memory_order_relaxed) / monitor->capture_channels / monitor->sample_rate);
+}
@@ -6,22 +6,38 @@
 #include <libserialport.h>
 #include <pthread.h>
 
-static char name_history[3][128] = {"radio", "radio", "radio"};
-static pthread_mutex_t radio_name_mutex = PTHREAD_MUTEX_INITIALIZER;
+void radio_serial_init(RadioSerial *radio, const char *com_port)
+{
+    snprintf(radio->com_port, sizeof(radio->com_port), "%s", com_port ? com_port : "");
+    for (int i = 0; i < 3; i++)
+        strcpy(radio->name_history[i], "radio");
+    pthread_mutex_init(&radio->lock, NULL);
+}
 
-char *get_radio_name(void)
+char *radio_serial_get_name(RadioSerial *radio)
 {
-    pthread_mutex_lock(&radio_name_mutex);
-    char *dup = malloc(strlen(name_history[0]) + 1);
+    pthread_mutex_lock(&radio->lock);
+    char *dup = malloc(strlen(radio->name_history[0]) + 1);
     if (dup)
-        strcpy(dup, name_history[0]);
-    pthread_mutex_unlock(&radio_name_mutex);
+        strcpy(dup, radio->name_history[0]);
+    pthread_mutex_unlock(&radio->lock);
     return dup;
 }
 
-void *serial_monitor_thread(void *arg)
+static void push_radio_name(RadioSerial *radio, const char *name)
+{
+    pthread_mutex_lock(&radio->lock);
+    strncpy(radio->name_history[2], radio->name_history[1], 128);
+    strncpy(radio->name_history[1], radio->name_history[0], 128);
+    strncpy(radio->name_history[0], name, 128);
+    pthread_mutex_unlock(&radio->lock);
+}
+
+// Thread entry; arg is the RadioSerial to keep updated
+void *radio_serial_thread(void *arg)
 {
-    const char *com_port = (const char *)arg;
+    RadioSerial *radio = (RadioSerial *)arg;
+    const char *com_port = radio->com_port;
     struct sp_port *port;
 
     printf("[Serial] Monitor thread starting. Looking for %s...\n", com_port);
@@ -53,12 +69,7 @@ void *serial_monitor_thread(void *arg)
                             if (idx > 0)
                             {
                                 word_buffer[idx] = '\0';
-
-                                pthread_mutex_lock(&radio_name_mutex);
-                                strncpy(name_history[2], name_history[1], 128);
-                                strncpy(name_history[1], name_history[0], 128);
-                                strncpy(name_history[0], word_buffer, 128);
-                                pthread_mutex_unlock(&radio_name_mutex);
+                                push_radio_name(radio, word_buffer);
                                 idx = 0;
                             }
                         }
@@ -78,12 +89,7 @@ void *serial_monitor_thread(void *arg)
                         if (idx > 0)
                         {
                             word_buffer[idx] = '\0';
-
-                            pthread_mutex_lock(&radio_name_mutex);
-                            strncpy(name_history[2], name_history[1], 128);
-                            strncpy(name_history[1], name_history[0], 128);
-                            strncpy(name_history[0], word_buffer, 128);
-                            pthread_mutex_unlock(&radio_name_mutex);
+                            push_radio_name(radio, word_buffer);
                             idx = 0;
                         }
                     }
@@ -95,4 +101,4 @@ void *serial_monitor_thread(void *arg)
         sleep(1);
     }
     return NULL;
-}
\ No newline at end of file
+}
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <string.h>
+#include "h/audio_stats.h"
+#include "h/preroll.h"
+
+int preroll_init(PreRoll *preroll, size_t frames)
+{
+    memset(preroll, 0, sizeof(*preroll));
+
+    size_t blocks = (frames + PREROLL_INDEX_BLOCK - 1) / PREROLL_INDEX_BLOCK;
+    if (blocks == 0)
+        blocks = 1;
+
+    preroll->capacity = blocks * PREROLL_INDEX_BLOCK;
+    preroll->block_count = blocks;
+    preroll->samples = calloc(preroll->capacity, sizeof(short));
+    preroll->block_peak = calloc(blocks, sizeof(int));
+    preroll->block_energy = calloc(blocks, sizeof(uint64_t));
+
+    if (!preroll->samples || !preroll->block_peak || !preroll->block_energy)
+    {
+        preroll_free(preroll);
+        return -1;
+    }
+    return 0;
+}
+
+void preroll_free(PreRoll *preroll)
+{
+    free(preroll->samples);
+    free(preroll->block_peak);
+    free(preroll->block_energy);
+    memset(preroll, 0, sizeof(*preroll));
+}
+
+// Copies in at most two memcpy spans and folds the new samples into the
+// stats of each index block they land in.
+void preroll_write(PreRoll *preroll, const short *samples, size_t count)
+{
+    if (count > preroll->capacity)
+    {
+        samples += count - preroll->capacity;
+        preroll->total_written += count - preroll->capacity;
+        count = preroll->capacity;
+    }
+
+    size_t pos = preroll->total_written % preroll->capacity;
+    size_t first = preroll->capacity - pos < count ? preroll->capacity - pos : count;
+    memcpy(preroll->samples + pos, samples, first * sizeof(short));
+    memcpy(preroll->samples, samples + first, (count - first) * sizeof(short));
+
+    size_t done = 0;
+    while (done < count)
+    {
+        size_t at = (pos + done) % preroll->capacity;
+        size_t block = at / PREROLL_INDEX_BLOCK;
+        size_t offset = at % PREROLL_INDEX_BLOCK;
+        size_t n = PREROLL_INDEX_BLOCK - offset < count - done ? PREROLL_INDEX_BLOCK - offset : count - done;
+
+        BlockStats stats;
+        block_stats(samples + done, n, &stats);
+
+        if (offset == 0)
+        {
+            preroll->block_peak[block] = stats.peak;
+            preroll->block_energy[block] = stats.sum_squares;
+        }
+        else
+        {
+            if (stats.peak > preroll->block_peak[block])
+                preroll->block_peak[block] = stats.peak;
+            preroll->block_energy[block] += stats.sum_squares;
+        }
+        done += n;
+    }
+
+    preroll->total_written += count;
+}
+
+size_t preroll_available(const PreRoll *preroll)
+{
+    return preroll->total_written < preroll->capacity ? (size_t)preroll->total_written : preroll->capacity;
+}
+
+// Offset, counted from the oldest sample held, of the first sample whose
+// magnitude exceeds threshold; -1 if there is none.
+long preroll_find_onset(const PreRoll *preroll, int threshold)
+{
+    size_t available = preroll_available(preroll);
+    size_t oldest = (size_t)((preroll->total_written - available) % preroll->capacity);
+    size_t scanned = 0;
+
+    // The oldest block may be partly overwritten, so its index entry only
+    // describes the newer samples; search its older tail directly.
+    size_t head = oldest % PREROLL_INDEX_BLOCK;
+    if (head != 0)
+    {
+        size_t n = PREROLL_INDEX_BLOCK - head;
+        if (n > available)
+            n = available;
+        long hit = block_find_first_above(preroll->samples + oldest, n, threshold);
+        if (hit != -1)
+            return hit;
+        scanned = n;
+    }
+
+    while (scanned < available)
+    {
+        size_t at = (oldest + scanned) % preroll->capacity;
+        size_t n = available - scanned < PREROLL_INDEX_BLOCK ? available - scanned : PREROLL_INDEX_BLOCK;
+
+        if (preroll->block_peak[at / PREROLL_INDEX_BLOCK] > threshold)
+        {
+            long hit = block_find_first_above(preroll->samples + at, n, threshold);
+            if (hit != -1)
+                return (long)scanned + hit;
+        }
+        scanned += n;
+    }
+    return -1;
+}
+
+// Describes the samples from offset to the newest as up to two contiguous
+// spans. Returns the number of non-empty spans.
+int preroll_spans(const PreRoll *preroll, size_t offset, SampleSpan spans[2])
+{
+    size_t available = preroll_available(preroll);
+    if (offset >= available)
+        return 0;
+
+    size_t start = (size_t)((preroll->total_written - available + offset) % preroll->capacity);
+    size_t count = available - offset;
+    size_t first = preroll->capacity - start < count ? preroll->capacity - start : count;
+
+    spans[0].data = preroll->samples + start;
+    spans[0].count = first;
+    spans[1].data = preroll->samples;
+    spans[1].count = count - first;
+    return spans[1].count ? 2 : 1;
+}
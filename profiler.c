@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include "h/profiler.h"
+
+typedef struct
+{
+    atomic_ulong buckets[PROFILE_BUCKETS];
+    atomic_ullong total_ns;
+    atomic_ullong max_ns;
+    atomic_ulong over_budget;
+    // Worst time over budget since the last poll, in thousandths of the budget
+    atomic_ulong worst_permille;
+    unsigned long reported_over_budget;
+} ProfileHistogram;
+
+static const char *const stage_names[PROFILE_STAGE_COUNT] = {"callback", "detect", "write", "copy", "queue", "upload"};
+static ProfileHistogram stages[PROFILE_STAGE_COUNT];
+static double ns_per_tick = 1.0;
+static volatile sig_atomic_t dump_requested;
+static time_t next_report;
+
+static void request_dump(int signal_number)
+{
+    dump_requested = 1;
+}
+
+static double calibrate_ticks(void)
+{
+#if defined(__aarch64__)
+    uint64_t frequency;
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(frequency));
+    return frequency > 0 ? 1e9 / frequency : 1.0;
+#elif defined(__x86_64__) || defined(__i386__)
+    struct timespec start, end, pause = {0, 20000000};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t start_ticks = profiler_ticks();
+    nanosleep(&pause, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    uint64_t ticks = profiler_ticks() - start_ticks;
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    return ticks > 0 ? ns / ticks : 1.0;
+#else
+    return 1.0;
+#endif
+}
+
+void profiler_init(void)
+{
+    ns_per_tick = calibrate_ticks();
+    next_report = time(NULL) + PROFILE_REPORT_INTERVAL;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_dump;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (sigaction(SIGUSR1, &action, NULL) != 0)
+        perror("Failed to install SIGUSR1 handler");
+
+    printf("[PROFILE] Cycle counter: %.3f ns per tick | Send SIGUSR1 for a report\n", ns_per_tick);
+}
+
+static int bucket_index(uint64_t ns)
+{
+    if (ns < 4)
+        return (int)ns;
+    int octave = 63 - __builtin_clzll(ns);
+    int index = (octave - 1) * 4 + (int)((ns >> (octave - 2)) & 3);
+    return index < PROFILE_BUCKETS ? index : PROFILE_BUCKETS - 1;
+}
+
+// Upper edge of a bucket, so percentiles err on the slow side
+static uint64_t bucket_limit(int index)
+{
+    if (index < 4)
+        return (uint64_t)index + 1;
+    int octave = index / 4 + 1;
+    return (uint64_t)(4 + index % 4 + 1) << (octave - 2);
+}
+
+static void store_max(atomic_ullong *target, unsigned long long value)
+{
+    unsigned long long current = atomic_load_explicit(target, memory_order_relaxed);
+    while (value > current && !atomic_compare_exchange_weak_explicit(target, &current, value, memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+// Safe in the PortAudio callback: no locks, no allocation, no I/O
+void profiler_record(ProfileStage stage, uint64_t start_ticks, uint64_t budget_ns)
+{
+    ProfileHistogram *histogram = &stages[stage];
+    uint64_t ns = (uint64_t)((profiler_ticks() - start_ticks) * ns_per_tick);
+
+    atomic_fetch_add_explicit(&histogram->buckets[bucket_index(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->total_ns, ns, memory_order_relaxed);
+    store_max(&histogram->max_ns, ns);
+
+    if (budget_ns > 0 && ns > budget_ns)
+    {
+        atomic_fetch_add_explicit(&histogram->over_budget, 1, memory_order_relaxed);
+        unsigned long permille = (unsigned long)(ns * 1000 / budget_ns);
+        unsigned long worst = atomic_load_explicit(&histogram->worst_permille, memory_order_relaxed);
+        while (permille > worst && !atomic_compare_exchange_weak_explicit(&histogram->worst_permille, &worst, permille, memory_order_relaxed, memory_order_relaxed))
+            ;
+    }
+}
+
+static void format_duration(uint64_t ns, char *out, size_t size)
+{
+    if (ns < 1000)
+        snprintf(out, size, "%llu ns", (unsigned long long)ns);
+    else if (ns < 1000000)
+        snprintf(out, size, "%.1f us", ns / 1e3);
+    else if (ns < 1000000000)
+        snprintf(out, size, "%.2f ms", ns / 1e6);
+    else
+        snprintf(out, size, "%.2f s", ns / 1e9);
+}
+
+static uint64_t percentile(const unsigned long *buckets, unsigned long count, double fraction)
+{
+    unsigned long rank = (unsigned long)(count * fraction);
+    unsigned long seen = 0;
+    for (int i = 0; i < PROFILE_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen > rank)
+            return bucket_limit(i);
+    }
+    return bucket_limit(PROFILE_BUCKETS - 1);
+}
+
+static void report_stage(ProfileStage stage)
+{
+    ProfileHistogram *histogram = &stages[stage];
+    unsigned long buckets[PROFILE_BUCKETS];
+    unsigned long count = 0;
+    for (int i = 0; i < PROFILE_BUCKETS; i++)
+    {
+        buckets[i] = atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+        count += buckets[i];
+    }
+    if (count == 0)
+        return;
+
+    char mean[32], p50[32], p99[32], p999[32], max[32];
+    format_duration(atomic_load_explicit(&histogram->total_ns, memory_order_relaxed) / count, mean, sizeof(mean));
+    format_duration(percentile(buckets, count, 0.5), p50, sizeof(p50));
+    format_duration(percentile(buckets, count, 0.99), p99, sizeof(p99));
+    format_duration(percentile(buckets, count, 0.999), p999, sizeof(p999));
+    format_duration(atomic_load_explicit(&histogram->max_ns, memory_order_relaxed), max, sizeof(max));
+
+    printf("[PROFILE] %-8s | Count: %lu | Mean: %s | p50: %s | p99: %s | p99.9: %s | Max: %s | Over budget: %lu\n",
+           stage_names[stage],
+           count,
+           mean,
+           p50,
+           p99,
+           p999,
+           max,
+           atomic_load_explicit(&histogram->over_budget, memory_order_relaxed));
+}
+
+// Called once a second. Reports budget overruns as they happen and the full
+// histograms every PROFILE_REPORT_INTERVAL, on SIGUSR1 or when forced.
+// Returns 1 when the full report was printed.
+int profiler_poll(int force_report)
+{
+    for (int stage = 0; stage < PROFILE_STAGE_COUNT; stage++)
+    {
+        ProfileHistogram *histogram = &stages[stage];
+        unsigned long over = atomic_load_explicit(&histogram->over_budget, memory_order_relaxed);
+        if (over == histogram->reported_over_budget)
+            continue;
+
+        unsigned long worst = atomic_exchange_explicit(&histogram->worst_permille, 0, memory_order_relaxed);
+        printf("[PROFILE] %s over budget %lu time(s), worst %.0f%% of budget (%lu in total)\n",
+               stage_names[stage],
+               over - histogram->reported_over_budget,
+               worst / 10.0,
+               over);
+        histogram->reported_over_budget = over;
+    }
+
+    time_t now = time(NULL);
+    if (!force_report && !dump_requested && now < next_report)
+        return 0;
+
+    dump_requested = 0;
+    next_report = now + PROFILE_REPORT_INTERVAL;
+    for (int stage = 0; stage < PROFILE_STAGE_COUNT; stage++)
+        report_stage(stage);
+    return 1;
+}
@@ -5,88 +5,671 @@
 #include <time.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
 #include <portaudio.h>
+#include "h/audio_stats.h"
+#include "h/block_pool.h"
+#include "h/dsp.h"
+#include "h/preroll.h"
+#include "h/resampler.h"
+#include "h/sample_clock.h"
+#include "h/vad.h"
+#include "h/ring_buffer.h"
 #include "h/write_wav_file.h"
+#include "h/encoder.h"
+#include "h/journal.h"
+#include "h/latency.h"
+#include "h/monitor.h"
+#include "h/upload_queue.h"
+#include "h/profiler.h"
 #include "h/open_serial_port.h"
 #include "h/recordAudio.h"
 #include "h/config.h"
 
 #define SAMPLE_RATE 48000
-#define CHANNELS 1
-#define PREBUFFER_SECONDS 1
-#define PREBUFFER_SIZE (SAMPLE_RATE * PREBUFFER_SECONDS)
 #define RECORDING_CHECK_INTERVAL 20
+#define RING_BUFFER_SECONDS 4
+#define DEFAULT_CHUNK_SIZE 1024
+#define WORKER_WAIT_MS 100
+#define RING_STATUS_INTERVAL 60
+#define VAD_MAX_BACKENDS 4
+#define DEFAULT_AUDIO_DEVICE_NAME "All-In-One-Cable"
+#define MAX_STREAM_CHANNELS 8
 
+// One receiver: a single channel of a capture stream with its own ring,
+// recording worker and radio-name serial monitor.
 typedef struct
 {
-    short *buffer;
-    size_t size;
-    size_t capacity;
+    char label[64];
+    char prefix[64];
+    int channel;
+    RadioSerial radio;
+    int has_radio;
+    unsigned long reported_dropped;
+    unsigned long reported_missing;
+
+    BlockPool pool;
+    // This receiver's share of RECORDING_MEMORY_MB, or 0 for all of it
+    size_t pool_budget;
+    BlockChain chain;
+    WavWriter writer;
+    LiveEncoder live;
+    WavEncoding wav_encoding;
+    Resampler resampler;
+    short *resample_buffer;
+    uint64_t resample_ns;
+    DspChain dsp;
+    size_t holdback_frames;
     int recording;
     int recording_check_counter;
     int recording_total_chunks;
-    time_t last_sound_time;
+    uint64_t stream_frame;
+    uint64_t last_sound_frame;
+    uint64_t segment_start_frame;
+    size_t segment_frames;
+    size_t segment_voiced_frames;
+    int segment_confirmed;
+    int segment_part;
+    int segment_peak;
+    char segment_path[1024];
+    VoiceDetector vad;
+    VoiceDetector shadow_vads[VAD_MAX_BACKENDS];
+    int shadow_vad_count;
+    unsigned long discarded_segments;
+    uint64_t next_vad_report_frame;
     char serial_name[256];
     int amplitude_threshold;
     int chunk_size;
-    short prebuffer[PREBUFFER_SIZE];
-    size_t prebuffer_index;
-    int prebuffer_full;
-    int live_listen;
+    PreRoll preroll;
+    Journal journal;
+    // Only set when replaying a file
+    SegmentLog *segment_log;
+
+    // Shared between the PortAudio callback (producer) and the worker (consumer)
+    RingBuffer ring;
+    SampleClock clock;
+    sem_t frames_ready;
+    atomic_int worker_running;
+    atomic_ulong callback_count;
+    atomic_ulong missing_input_count;
+    pthread_t worker;
+    short *work_buffer;
+    size_t work_buffer_frames;
 } AudioData;
 
+// One PortAudio stream per capture device. The callback splits interleaved
+// frames into a ring per receiver, so every channel costs no extra stream.
+typedef struct
+{
+    char device_name[128];
+    PaStream *stream;
+    int channels;
+    Monitor *monitor;
+    AudioData *receivers[MAX_STREAM_CHANNELS];
+    short *split[MAX_STREAM_CHANNELS];
+    size_t split_frames;
+    int callback_budget_percent;
+
+    // PortAudio status flags, counted by the callback
+    atomic_ulong input_overflows;
+    atomic_ulong input_underflows;
+    unsigned long reported_overflows;
+    unsigned long reported_underflows;
+} CaptureStream;
+
+static void push_frames(AudioData *data, const short *samples, size_t frames, double adc_time, double now_time)
+{
+    // Stream position of this buffer is the ring's write index before the copy
+    uint64_t frame = atomic_load_explicit(&data->ring.head, memory_order_relaxed);
+    if (ring_buffer_write(&data->ring, samples, frames) == frames)
+    {
+        sample_clock_observe(&data->clock, frame, adc_time, now_time);
+    }
+}
+
+// Runs in the PortAudio real-time thread: no allocation, no locks, no I/O.
+// Frames are handed to each receiver's worker through its lock-free ring.
 static int audioCallback(const void *inputBuffer, void *outputBuffer,
                          unsigned long framesPerBuffer,
                          const PaStreamCallbackTimeInfo *timeInfo,
                          PaStreamCallbackFlags statusFlags,
                          void *userData)
 {
-    AudioData *data = (AudioData *)userData;
+    uint64_t start_ticks = profiler_ticks();
+    CaptureStream *capture = (CaptureStream *)userData;
     const short *input = (const short *)inputBuffer;
-    short *output = (short *)outputBuffer;
+    int channels = capture->channels;
+
+    if (statusFlags & paInputOverflow)
+        atomic_fetch_add_explicit(&capture->input_overflows, 1, memory_order_relaxed);
+    if (statusFlags & paInputUnderflow)
+        atomic_fetch_add_explicit(&capture->input_underflows, 1, memory_order_relaxed);
 
-    if (output)
+    if (!input)
     {
-        if (data->live_listen && input)
+        for (int c = 0; c < channels; c++)
         {
-            memcpy(output, input, framesPerBuffer * sizeof(short));
+            if (capture->receivers[c])
+                atomic_fetch_add_explicit(&capture->receivers[c]->missing_input_count, 1, memory_order_relaxed);
         }
-        else
+        return paContinue;
+    }
+
+    double now_time = timeInfo ? timeInfo->currentTime : 0;
+    double adc_time = timeInfo ? timeInfo->inputBufferAdcTime : 0;
+    if (now_time <= 0)
+    {
+        // Host API without stream timestamps: fall back to the monotonic clock
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        now_time = ts.tv_sec + ts.tv_nsec / 1e9;
+        adc_time = 0;
+    }
+    if (adc_time <= 0)
+        adc_time = now_time - (double)framesPerBuffer / SAMPLE_RATE;
+
+    if (capture->monitor)
+        monitor_push(capture->monitor, input, framesPerBuffer);
+
+    if (channels == 1)
+    {
+        push_frames(capture->receivers[0], input, framesPerBuffer, adc_time, now_time);
+    }
+    else
+    {
+        for (size_t done = 0; done < framesPerBuffer;)
         {
-            memset(output, 0, framesPerBuffer * sizeof(short));
+            size_t frames = framesPerBuffer - done;
+            if (frames > capture->split_frames)
+                frames = capture->split_frames;
+
+            deinterleave(input + done * channels, frames, channels, capture->split);
+            for (int c = 0; c < channels; c++)
+            {
+                if (capture->receivers[c])
+                    push_frames(capture->receivers[c], capture->split[c], frames, adc_time + (double)done / SAMPLE_RATE, now_time);
+            }
+            done += frames;
         }
     }
 
-    if (!input)
+    for (int c = 0; c < channels; c++)
     {
-        fprintf(stderr, "No input detected!\n");
-        return paContinue;
+        if (!capture->receivers[c])
+            continue;
+        atomic_fetch_add_explicit(&capture->receivers[c]->callback_count, 1, memory_order_relaxed);
+        sem_post(&capture->receivers[c]->frames_ready);
     }
 
-    for (unsigned int i = 0; i < framesPerBuffer; i++)
+    // Budget: a share of the time until the next buffer is due
+    profiler_record(PROFILE_CALLBACK, start_ticks,
+                    (uint64_t)framesPerBuffer * capture->callback_budget_percent * 10000000ULL / SAMPLE_RATE);
+    return paContinue;
+}
+
+// Formats the wall-clock time of a stream frame; ms_separator appends milliseconds
+static void format_frame_time(AudioData *data, uint64_t frame, const char *format, const char *ms_separator, char *out, size_t size)
+{
+    struct timespec ts;
+    sample_clock_realtime(&data->clock, frame, &ts);
+
+    struct tm tm_info;
+    localtime_r(&ts.tv_sec, &tm_info);
+    size_t len = strftime(out, size, format, &tm_info);
+
+    if (ms_separator && len < size)
+        snprintf(out + len, size - len, "%s%03ld", ms_separator, ts.tv_nsec / 1000000);
+}
+
+// Room kept at the end of a segment path for "-<n>", "_part<N>" and WAV_PART_SUFFIX
+#define SEGMENT_SUFFIX_ROOM 32
+
+// Names the file after the wall-clock time of its first sample, to the
+// millisecond. A numeric suffix guards against the rare exact collision.
+static void start_segment(AudioData *data, uint64_t start_frame)
+{
+    char final_file_path[1024], part_path[1040], time_str[64];
+    format_frame_time(data, start_frame, "%Y%m%d_%H%M%S", "_", time_str, sizeof(time_str));
+
+    char base_name[384];
+    if (data->prefix[0] != '\0')
+        snprintf(base_name, sizeof(base_name), "%s_%s", data->prefix, data->serial_name);
+    else
+        snprintf(base_name, sizeof(base_name), "%s", data->serial_name);
+
+    int length = snprintf(final_file_path, sizeof(final_file_path), "%s/%s_%s.wav", RECORDING_DIRECTORY, base_name, time_str);
+    if (length < 0 || (size_t)length + SEGMENT_SUFFIX_ROOM >= sizeof(final_file_path))
+    {
+        // Shortens the name rather than letting a suffix be cut off later
+        size_t excess = (size_t)length + SEGMENT_SUFFIX_ROOM - sizeof(final_file_path) + 1;
+        size_t base_len = strlen(base_name);
+        base_name[base_len > excess ? base_len - excess : 0] = '\0';
+        fprintf(stderr, "[%s] Recording path too long, shortening the name to \"%s\"\n", data->label, base_name);
+        snprintf(final_file_path, sizeof(final_file_path), "%s/%s_%s.wav", RECORDING_DIRECTORY, base_name, time_str);
+    }
+    for (int attempt = 1; attempt < 100; attempt++)
     {
-        data->prebuffer[data->prebuffer_index] = input[i];
-        data->prebuffer_index = (data->prebuffer_index + 1) % PREBUFFER_SIZE;
+        snprintf(part_path, sizeof(part_path), "%s%s", final_file_path, WAV_PART_SUFFIX);
+        if (access(final_file_path, F_OK) != 0 && access(part_path, F_OK) != 0)
+            break;
+        snprintf(final_file_path, sizeof(final_file_path), "%s/%s_%s-%d.wav", RECORDING_DIRECTORY, base_name, time_str, attempt);
     }
-    if (data->prebuffer_index == 0)
-        data->prebuffer_full = 1;
 
-    int max_amplitude = 0;
-    for (unsigned int i = 0; i < framesPerBuffer; i++)
+    snprintf(data->segment_path, sizeof(data->segment_path), "%s", final_file_path);
+    data->segment_start_frame = start_frame;
+    data->segment_frames = 0;
+    data->segment_voiced_frames = 0;
+    data->segment_confirmed = 0;
+    data->segment_part = 0;
+    data->segment_peak = 0;
+}
+
+// <name>.<ext> -> <name>_part<N>.<ext>. start_segment leaves room for the
+// tag; should it still not fit, path is left as it was and -1 returned.
+static int tag_part(char *path, size_t size, int part)
+{
+    char tagged[1040];
+    const char *extension = strrchr(path, '.');
+    const char *slash = strrchr(path, '/');
+    if (!extension || (slash && extension < slash))
+        extension = path + strlen(path);
+    int length = snprintf(tagged, sizeof(tagged), "%.*s_part%d%s", (int)(extension - path), path, part, extension);
+    if (length < 0 || (size_t)length >= size)
     {
-        int sample = abs(input[i]);
-        if (sample > max_amplitude)
-            max_amplitude = sample;
+        fprintf(stderr, "Cannot name part %d of %s: path too long\n", part, path);
+        return -1;
     }
-    time_t current_time = time(NULL);
+    memcpy(path, tagged, (size_t)length + 1);
+    return 0;
+}
 
-    if (max_amplitude > data->amplitude_threshold && !data->recording)
+static void open_segment(AudioData *data)
+{
+    data->segment_confirmed = 1;
+    journal_confirm(&data->journal);
+    if (wav_writer_open(&data->writer, data->segment_path, data->resampler.out_rate, data->wav_encoding) != 0)
+    {
+        fprintf(stderr, "Failed to open WAV file, this transmission will not be saved.\n");
+    }
+    else if (live_encoder_open(&data->live, data->segment_path, data->resampler.out_rate) != 0)
+    {
+        fprintf(stderr, "Failed to start live encoder, encoding after the transmission instead.\n");
+    }
+}
+
+// Nothing touches the disk until the detector has heard VAD_MIN_VOICE_MS of
+// voice in the segment, so false triggers cost no writes or uploads.
+static int confirm_segment(AudioData *data)
+{
+    if (data->segment_confirmed)
+        return 1;
+    if (data->segment_voiced_frames < data->vad.config.min_voice_frames)
+        return 0;
+
+    resampler_reset(&data->resampler);
+    dsp_chain_reset(&data->dsp);
+    open_segment(data);
+    return 1;
+}
+
+static void write_samples(AudioData *data, const short *samples, size_t frames)
+{
+    if (wav_writer_append(&data->writer, samples, frames) != 0)
+    {
+        fprintf(stderr, "Failed to write WAV data, dropping segment.\n");
+        wav_writer_discard(&data->writer);
+        live_encoder_discard(&data->live);
+    }
+    else
+    {
+        live_encoder_write(&data->live, samples, frames);
+    }
+}
+
+// Blocks are converted to the recording rate and run through the DSP chain on
+// their way to disk, and to the live encoder so the upload is ready as soon
+// as the squelch closes
+static void write_block(AudioData *data, AudioBlock *block)
+{
+    if (!data->writer.file)
+    {
+        block_pool_release(&data->pool, block);
+        return;
+    }
+
+    uint64_t start_ticks = profiler_ticks();
+    size_t block_frames = block->used;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t frames = resampler_process(&data->resampler, block->samples, block->used, data->resample_buffer);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    data->resample_ns += (uint64_t)((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec));
+
+    dsp_chain_process(&data->dsp, data->resample_buffer, frames);
+    write_samples(data, data->resample_buffer, frames);
+    block_pool_release(&data->pool, block);
+    // The worker falls behind if a block takes longer than it lasts
+    profiler_record(PROFILE_WRITE, start_ticks, (uint64_t)block_frames * 1000000000ULL / SAMPLE_RATE);
+}
+
+// Streams every block older than the hold-back window to disk. The window is
+// what REMOVE_LAST_SECONDS may still cut off when silence is detected.
+static void flush_recording(AudioData *data, size_t holdback)
+{
+    if (!confirm_segment(data))
+        return;
+
+    while (data->chain.head && data->chain.frames - data->chain.head->used >= holdback)
+    {
+        write_block(data, block_chain_pop(&data->chain));
+    }
+}
+
+static void log_segment(AudioData *data, const char *result, double seconds, const char *path)
+{
+    SegmentLog *log = data->segment_log;
+    if (!log)
+        return;
+
+    if (log->count == log->capacity)
+    {
+        size_t capacity = log->capacity ? log->capacity * 2 : 16;
+        SegmentRecord *segments = realloc(log->segments, capacity * sizeof(SegmentRecord));
+        if (!segments)
+            return;
+        log->segments = segments;
+        log->capacity = capacity;
+    }
+
+    SegmentRecord *record = &log->segments[log->count++];
+    record->start_seconds = sample_clock_seconds(&data->clock, data->segment_start_frame);
+    record->seconds = seconds;
+    record->voiced_seconds = sample_clock_seconds(&data->clock, data->segment_voiced_frames);
+    record->part = data->segment_part;
+    record->result = result;
+    snprintf(record->path, sizeof(record->path), "%s", path ? path : "");
+}
+
+// ends_transmission is 0 when a long transmission is cut into parts: the
+// DSP chain then carries its last samples over into the next part
+static void finish_segment(AudioData *data, int ends_transmission)
+{
+    // Settled one way or another from here on; a crash while the file is
+    // being closed leaves a .part behind for recover_partial_recordings
+    journal_end(&data->journal);
+    if (!confirm_segment(data))
+    {
+        printf("Discarding false trigger: %.2fs of voice in %.2fs (%s detector).\n",
+               sample_clock_seconds(&data->clock, data->segment_voiced_frames),
+               sample_clock_seconds(&data->clock, data->segment_frames),
+               data->vad.backend->name);
+        log_segment(data, "false_trigger", sample_clock_seconds(&data->clock, data->segment_frames), NULL);
+        data->discarded_segments++;
+        block_chain_release(&data->chain, &data->pool);
+        return;
+    }
+
+    // A tag that does not fit leaves the whole untagged name, never a cut one
+    if (data->segment_part > 0)
+    {
+        tag_part(data->segment_path, sizeof(data->segment_path), data->segment_part);
+        tag_part(data->writer.final_path, sizeof(data->writer.final_path), data->segment_part);
+        if (data->live.opus)
+            tag_part(data->live.path, sizeof(data->live.path), data->segment_part);
+    }
+    latency_squelch_closed(data->segment_path);
+    flush_recording(data, 0);
+    if (ends_transmission && data->writer.file)
+    {
+        size_t frames = dsp_chain_flush(&data->dsp, data->resample_buffer,
+                                        resampler_max_output(&data->resampler, data->pool.block_frames));
+        if (frames > 0)
+            write_samples(data, data->resample_buffer, frames);
+    }
+
+    if (!data->writer.file)
+    {
+        log_segment(data, "write_failed", sample_clock_seconds(&data->clock, data->segment_frames), NULL);
+        return;
+    }
+
+    int rate = data->resampler.out_rate;
+    double seconds = (double)data->writer.frames / rate;
+    if (data->writer.frames < MIN_RECORDING_SECONDS * rate)
+    {
+        printf("Recording too short (%.2fs), skipping save.\n", seconds);
+        log_segment(data, "too_short", seconds, NULL);
+        wav_writer_discard(&data->writer);
+        live_encoder_discard(&data->live);
+    }
+    else if (wav_writer_close(&data->writer) == 0)
+    {
+        printf("Recording saved: %s\n", data->writer.final_path);
+        log_segment(data, "saved", seconds, data->live.opus ? data->live.path : data->writer.final_path);
+
+        RecordingInfo info;
+        snprintf(info.prefix, sizeof(info.prefix), "%s", data->prefix);
+        snprintf(info.radio, sizeof(info.radio), "%s", data->serial_name);
+        sample_clock_realtime(&data->clock, data->segment_start_frame, &info.start);
+        info.seconds = seconds;
+        info.peak = data->segment_peak;
+        info.part = data->segment_part;
+        encoder_finish(&data->live, data->writer.part_path, data->writer.final_path, data->writer.frames, rate, &info);
+    }
+    else
+    {
+        fprintf(stderr, "Failed to write WAV file.\n");
+        log_segment(data, "write_failed", seconds, NULL);
+        live_encoder_discard(&data->live);
+    }
+}
+
+// Publishes the segment recorded so far and carries on with the same
+// transmission in a new file, tagged as the next part. The resampler is not
+// reset, so the parts join up without a gap.
+static void cut_segment(AudioData *data)
+{
+    int part = data->segment_part > 0 ? data->segment_part : 1;
+    int confirmed = data->segment_confirmed;
+
+    data->segment_part = part;
+    finish_segment(data, 0);
+    start_segment(data, data->segment_start_frame + data->segment_frames);
+    data->segment_part = part + 1;
+    if (confirmed)
+        open_segment(data);
+}
+
+// Long transmissions are cut once they near MAX_SEGMENT_SECONDS, on the first
+// quiet block in the last SEGMENT_SEARCH_SECONDS, or at the limit itself
+static int segment_cut_due(const AudioData *data, int voice, int max_amplitude)
+{
+    if (MAX_SEGMENT_SECONDS <= 0)
+        return 0;
+
+    uint64_t max_frames = (uint64_t)MAX_SEGMENT_SECONDS * SAMPLE_RATE;
+    uint64_t search_frames = (uint64_t)SEGMENT_SEARCH_SECONDS * SAMPLE_RATE;
+    if (data->segment_frames >= max_frames)
+        return 1;
+    if (data->segment_frames + search_frames < max_frames)
+        return 0;
+    return !voice || max_amplitude < data->amplitude_threshold;
+}
+
+// The journal learns about a segment with its first samples, once
+// cut_segment has settled which part it is
+static void journal_frames(AudioData *data, uint64_t frame, const short *frames, size_t count)
+{
+    if (!data->journal.map || count == 0)
+        return;
+
+    if (!data->journal.segment)
+    {
+        char final_path[1024], part_path[1040];
+        snprintf(final_path, sizeof(final_path), "%s", data->segment_path);
+        if (data->segment_part > 0)
+            tag_part(final_path, sizeof(final_path), data->segment_part);
+        snprintf(part_path, sizeof(part_path), "%s%s", data->segment_path, WAV_PART_SUFFIX);
+
+        struct timespec start;
+        sample_clock_realtime(&data->clock, data->segment_start_frame, &start);
+        journal_begin(&data->journal, data->segment_start_frame, &start, final_path, part_path);
+        if (data->segment_confirmed)
+            journal_confirm(&data->journal);
+    }
+
+    struct timespec time;
+    sample_clock_realtime(&data->clock, frame, &time);
+    journal_append(&data->journal, frame, &time, frames, count);
+}
+
+// Appends frames to the current recording. If the pool budget is used up
+// anyway the segment recorded so far is closed and a new one is started.
+static void append_recording(AudioData *data, const short *frames, size_t count)
+{
+    size_t written = block_chain_append(&data->chain, &data->pool, frames, count);
+    journal_frames(data, data->segment_start_frame + data->segment_frames, frames, written);
+    data->segment_frames += written;
+    if (written < count)
+    {
+        printf("Recording memory budget exhausted after %zu samples. Cutting segment...\n", data->segment_frames);
+        cut_segment(data);
+        data->segment_frames = block_chain_append(&data->chain, &data->pool, frames + written, count - written);
+        journal_frames(data, data->segment_start_frame, frames + written, data->segment_frames);
+    }
+
+    flush_recording(data, data->holdback_frames);
+}
+
+static void report_vad_line(const AudioData *data, const VoiceDetector *vad, const char *role)
+{
+    printf("[VAD] Input: %s | %s: %s | CPU: %.3f%% of real time | Triggers: %lu | False triggers: %lu",
+           data->label,
+           role,
+           vad->backend->name,
+           vad_cpu_percent(vad),
+           vad->triggers,
+           vad->false_triggers);
+    if (vad->backend->init)
+        printf(" | Noise floor: %.1f dBFS", vad->noise_floor_db);
+    printf("\n");
+}
+
+static void report_vad(AudioData *data)
+{
+    if (data->vad.frames == 0)
+        return;
+
+    report_vad_line(data, &data->vad, "active");
+    for (int i = 0; i < data->shadow_vad_count; i++)
+        report_vad_line(data, &data->shadow_vads[i], "shadow");
+    printf("[VAD] Input: %s | Discarded segments: %lu\n", data->label, data->discarded_segments);
+}
+
+// CPU cost of each stage between the block pool and the encoder
+static void report_dsp(const AudioData *data)
+{
+    const DspChain *dsp = &data->dsp;
+    if (!dsp_chain_enabled(dsp) || dsp->frames == 0)
+        return;
+
+    printf("[DSP] Input: %s | Resample: %.3f%% | Filters: %.3f%% | AGC: %.3f%% | Total: %.3f%% of real time",
+           data->label,
+           dsp_cpu_percent(dsp, data->resample_ns),
+           dsp_cpu_percent(dsp, dsp->filter_ns),
+           dsp_cpu_percent(dsp, dsp->agc_ns),
+           dsp_cpu_percent(dsp, data->resample_ns + dsp->filter_ns + dsp->agc_ns));
+    if (dsp->agc_enabled)
+        printf(" | AGC gain: %+.1f dB", 20 * log10(dsp->agc.gain));
+    printf("\n");
+}
+
+static void report_journal(const AudioData *data)
+{
+    const Journal *journal = &data->journal;
+    if (!journal->map || journal->syncs == 0)
+        return;
+
+    printf("[JOURNAL] Input: %s | Syncs: %lu | Written back: %.1f MB | Mean sync: %.2f ms\n",
+           data->label,
+           journal->syncs,
+           journal->synced_bytes / (1024.0 * 1024.0),
+           journal->sync_ns / 1e6 / journal->syncs);
+}
+
+static int init_voice_detectors(AudioData *data)
+{
+    VadConfig config = {
+        .sample_rate = SAMPLE_RATE,
+        .amplitude_threshold = data->amplitude_threshold,
+        .open_db = VAD_OPEN_DB,
+        .close_db = VAD_CLOSE_DB,
+        .max_flatness = VAD_MAX_FLATNESS,
+        .hang_frames = (size_t)SILENCE_THRESHOLD * SAMPLE_RATE,
+        .min_voice_frames = (size_t)VAD_MIN_VOICE_MS * SAMPLE_RATE / 1000,
+    };
+
+    const VadBackend *backend = vad_find_backend(VAD_MODE);
+    if (!backend)
+    {
+        fprintf(stderr, "Unknown VAD_MODE '%s', using peak detector\n", VAD_MODE);
+        backend = vad_find_backend("peak");
+    }
+
+    if (vad_init(&data->vad, backend, &config) != 0)
+    {
+        fprintf(stderr, "Failed to initialise %s voice detector\n", backend->name);
+        return -1;
+    }
+    printf("[%s] Voice detector: %s\n", data->label, backend->name);
+
+    // With VAD_COMPARE the other backends run on the same audio purely to
+    // collect trigger and CPU statistics for comparison.
+    data->shadow_vad_count = 0;
+    for (int i = 0; VAD_COMPARE && i < vad_backend_count() && data->shadow_vad_count < VAD_MAX_BACKENDS; i++)
+    {
+        const VadBackend *other = vad_backend_at(i);
+        if (other == backend)
+            continue;
+        if (vad_init(&data->shadow_vads[data->shadow_vad_count], other, &config) == 0)
+            data->shadow_vad_count++;
+    }
+    return 0;
+}
+
+static void destroy_voice_detectors(AudioData *data)
+{
+    vad_destroy(&data->vad);
+    for (int i = 0; i < data->shadow_vad_count; i++)
+        vad_destroy(&data->shadow_vads[i]);
+    data->shadow_vad_count = 0;
+}
+
+// Segmentation, logging and file output for one block drained from the ring.
+// Runs on the recording worker thread, so it is free to allocate and block.
+static void process_block(AudioData *data, const short *input, unsigned long framesPerBuffer)
+{
+    uint64_t start_ticks = profiler_ticks();
+    BlockStats stats;
+    block_stats(input, framesPerBuffer, &stats);
+    int max_amplitude = stats.peak;
+
+    int voice = vad_process(&data->vad, input, framesPerBuffer, &stats);
+    for (int i = 0; i < data->shadow_vad_count; i++)
+        vad_process(&data->shadow_vads[i], input, framesPerBuffer, &stats);
+    profiler_record(PROFILE_DETECT, start_ticks, (uint64_t)framesPerBuffer * 1000000000ULL / SAMPLE_RATE);
+    uint64_t block_start = data->stream_frame;
+    uint64_t block_end = block_start + framesPerBuffer;
+    data->stream_frame = block_end;
+
+    if (voice && !data->recording)
     {
         data->recording = 1;
         data->recording_check_counter = 0;
-        data->size = 0;
 
-        char *actual_name = get_radio_name();
+        char *actual_name = data->has_radio ? radio_serial_get_name(&data->radio) : NULL;
         if (actual_name)
         {
             strncpy(data->serial_name, actual_name, sizeof(data->serial_name) - 1);
@@ -94,55 +677,32 @@ static int audioCallback(const void *inputBuffer, void *outputBuffer,
             free(actual_name);
         }
 
-        data->capacity = SAMPLE_RATE * 10;
-        data->buffer = (short *)malloc(data->capacity * sizeof(short));
-        if (!data->buffer)
-        {
-            fprintf(stderr, "Memory allocation failed!\n");
-            return paAbort;
-        }
-
-        size_t pre_count = data->prebuffer_full ? PREBUFFER_SIZE : data->prebuffer_index;
-        size_t start_index = data->prebuffer_index;
+        // The pre-roll only holds earlier blocks; the current one is appended below
+        long start_offset = preroll_find_onset(&data->preroll, data->amplitude_threshold / 2);
+        size_t preroll_frames = start_offset != -1 ? preroll_available(&data->preroll) - (size_t)start_offset : 0;
 
-        int start_offset = -1;
-        for (size_t i = 0; i < pre_count; i++)
-        {
-            size_t idx = (start_index + i) % PREBUFFER_SIZE;
-            if (abs(data->prebuffer[idx]) > data->amplitude_threshold / 2)
-            {
-                start_offset = i;
-                break;
-            }
-        }
+        start_segment(data, block_start - preroll_frames);
 
         if (start_offset != -1)
         {
-            for (size_t i = start_offset; i < pre_count; i++)
-            {
-                size_t idx = (start_index + i) % PREBUFFER_SIZE;
-                data->buffer[data->size++] = data->prebuffer[idx];
-            }
+            SampleSpan spans[2];
+            int span_count = preroll_spans(&data->preroll, (size_t)start_offset, spans);
+            for (int i = 0; i < span_count; i++)
+                append_recording(data, spans[i].data, spans[i].count);
         }
 
-        data->last_sound_time = current_time;
+        data->last_sound_frame = block_end;
     }
 
+    preroll_write(&data->preroll, input, framesPerBuffer);
+
     if (data->recording)
     {
-        if (data->size + framesPerBuffer > data->capacity)
-        {
-            data->capacity *= 2;
-            data->buffer = realloc(data->buffer, data->capacity * sizeof(short));
-            if (!data->buffer)
-            {
-                fprintf(stderr, "Memory reallocation failed!\n");
-                return paAbort;
-            }
-        }
-
-        memcpy(data->buffer + data->size, input, framesPerBuffer * sizeof(short));
-        data->size += framesPerBuffer;
+        if (voice)
+            data->segment_voiced_frames += framesPerBuffer;
+        if (max_amplitude > data->segment_peak)
+            data->segment_peak = max_amplitude;
+        append_recording(data, input, framesPerBuffer);
         data->recording_total_chunks++;
 
         data->recording_check_counter++;
@@ -150,80 +710,294 @@ static int audioCallback(const void *inputBuffer, void *outputBuffer,
         {
             data->recording_check_counter = 0;
 
-            double recording_time_sec = (double)data->size / SAMPLE_RATE;
+            size_t recorded_samples = data->segment_frames;
+            double recording_time_sec = sample_clock_seconds(&data->clock, recorded_samples);
 
-            time_t raw_time = time(NULL);
-            struct tm *time_info = localtime(&raw_time);
             char datetime_str[64];
-            strftime(datetime_str, sizeof(datetime_str), "%Y-%m-%d %H:%M:%S", time_info);
+            format_frame_time(data, block_end, "%Y-%m-%d %H:%M:%S", NULL, datetime_str, sizeof(datetime_str));
 
-            struct tm *last_tm = localtime(&data->last_sound_time);
             char last_sound_str[32];
-            strftime(last_sound_str, sizeof(last_sound_str), "%H:%M:%S", last_tm);
+            format_frame_time(data, data->last_sound_frame, "%H:%M:%S", ".", last_sound_str, sizeof(last_sound_str));
 
-            double silence_duration = difftime(raw_time, data->last_sound_time);
-            printf("[RECORDING] Name: %s | DateTime: %s | Last sound: %s | Silence: %.2fs | Max Amplitude: %d | Chunks: %d | Samples: %zu | Recording time: %.2fs\n",
+            size_t pool_in_use, pool_high_water;
+            unsigned long pool_exhausted;
+            block_pool_stats(&data->pool, &pool_in_use, &pool_high_water, &pool_exhausted);
+
+            double silence_duration = sample_clock_seconds(&data->clock, block_end - data->last_sound_frame);
+            printf("[RECORDING] Input: %s | Name: %s | DateTime: %s | Last sound: %s | Silence: %.2fs | Max Amplitude: %d | RMS: %.0f | Chunks: %d | Samples: %zu | Recording time: %.2fs | Ring: %zu/%zu | Dropped: %lu | Pool: %zu/%zu (high water %zu, exhausted %lu)\n",
+                   data->label,
                    data->serial_name,
                    datetime_str,
                    last_sound_str,
                    silence_duration,
                    max_amplitude,
+                   framesPerBuffer ? sqrt((double)stats.sum_squares / framesPerBuffer) : 0.0,
                    data->recording_total_chunks,
-                   data->size,
-                   recording_time_sec);
+                   recorded_samples,
+                   recording_time_sec,
+                   ring_buffer_fill(&data->ring),
+                   data->ring.capacity,
+                   atomic_load_explicit(&data->ring.dropped_frames, memory_order_relaxed),
+                   pool_in_use,
+                   data->pool.block_count,
+                   pool_high_water,
+                   pool_exhausted);
         }
 
-        if (max_amplitude > data->amplitude_threshold)
+        if (voice)
         {
-            data->last_sound_time = current_time;
+            data->last_sound_frame = block_end;
         }
 
-        if (difftime(current_time, data->last_sound_time) > SILENCE_THRESHOLD)
+        if (block_end - data->last_sound_frame > (uint64_t)SILENCE_THRESHOLD * SAMPLE_RATE)
         {
             printf("Silence detected. Stopping recording...\n");
 
-            size_t remove_samples = REMOVE_LAST_SECONDS * SAMPLE_RATE;
-            if (data->size > remove_samples)
+            size_t remove_samples = (size_t)REMOVE_LAST_SECONDS * SAMPLE_RATE;
+            if (data->chain.frames > remove_samples)
             {
-                data->size -= remove_samples;
+                block_chain_truncate(&data->chain, &data->pool, data->chain.frames - remove_samples);
             }
             else
             {
-                data->size = 0;
+                block_chain_release(&data->chain, &data->pool);
             }
 
-            if (data->size > 0)
-            {
-                char filename[512], final_file_path[1024], time_str[64];
-                time_t now = time(NULL);
-                struct tm *t = localtime(&now);
-                strftime(time_str, sizeof(time_str), "%Y%m%d_%H%M%S", t);
-
-                snprintf(filename, sizeof(filename), "%s_%s.wav", data->serial_name, time_str);
-                snprintf(final_file_path, sizeof(final_file_path), "%s/%s", RECORDING_DIRECTORY, filename);
-
-                if (write_wav_file(final_file_path, data->buffer, data->size, SAMPLE_RATE) == 0)
-                {
-                    printf("Recording saved: %s\n", final_file_path);
-                }
-                else
-                {
-                    fprintf(stderr, "Failed to write WAV file.\n");
-                }
-            }
-            else
-            {
-                printf("Recording too short, skipping save.\n");
-            }
-
-            free(data->buffer);
-            data->buffer = NULL;
-            data->size = 0;
-            data->capacity = 0;
+            finish_segment(data, 1);
             data->recording = 0;
         }
+        else if (segment_cut_due(data, voice, max_amplitude))
+        {
+            printf("Transmission reached %.0fs, saving part %d and continuing...\n",
+                   sample_clock_seconds(&data->clock, data->segment_frames),
+                   data->segment_part > 0 ? data->segment_part : 1);
+            cut_segment(data);
+        }
     }
-    return paContinue;
+
+    if (block_end >= data->next_vad_report_frame)
+    {
+        report_vad(data);
+        report_dsp(data);
+        report_journal(data);
+        data->next_vad_report_frame = block_end + (uint64_t)RING_STATUS_INTERVAL * SAMPLE_RATE;
+    }
+}
+
+static void *recording_worker(void *arg)
+{
+    AudioData *data = (AudioData *)arg;
+
+    while (atomic_load(&data->worker_running))
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += WORKER_WAIT_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        sem_timedwait(&data->frames_ready, &deadline);
+
+        size_t frames;
+        while ((frames = ring_buffer_read(&data->ring, data->work_buffer, data->work_buffer_frames)) > 0)
+        {
+            process_block(data, data->work_buffer, frames);
+        }
+        journal_sync(&data->journal, 0);
+    }
+    return NULL;
+}
+
+// Buffers, detectors and the DSP chain of one receiver, shared by the live
+// worker and the file replay
+static int init_recording_state(AudioData *data)
+{
+    data->work_buffer_frames = data->chunk_size > 0 ? (size_t)data->chunk_size : DEFAULT_CHUNK_SIZE;
+    data->work_buffer = malloc(data->work_buffer_frames * sizeof(short));
+    if (!data->work_buffer)
+    {
+        fprintf(stderr, "Failed to allocate worker buffer\n");
+        return -1;
+    }
+
+    if (ring_buffer_init(&data->ring, (size_t)SAMPLE_RATE * RING_BUFFER_SECONDS) != 0)
+    {
+        fprintf(stderr, "Failed to allocate audio ring buffer\n");
+        free(data->work_buffer);
+        return -1;
+    }
+
+    if (preroll_init(&data->preroll, (size_t)PREROLL_MS * SAMPLE_RATE / 1000) != 0)
+    {
+        fprintf(stderr, "Failed to allocate pre-roll buffer\n");
+        ring_buffer_free(&data->ring);
+        free(data->work_buffer);
+        return -1;
+    }
+
+    // Segments are streamed to disk as they grow, so the pool only has to
+    // hold the holdback window on top of what one append can bring: the
+    // pre-roll when a segment starts, or a worker chunk
+    data->holdback_frames = (size_t)REMOVE_LAST_SECONDS * SAMPLE_RATE;
+    size_t budget = data->pool_budget > 0 ? data->pool_budget : (size_t)RECORDING_MEMORY_MB * 1024 * 1024;
+    if (RECORDING_BLOCK_FRAMES > 0)
+    {
+        size_t frames = data->holdback_frames + data->preroll.capacity + data->work_buffer_frames;
+        size_t block_bytes = sizeof(AudioBlock) + (size_t)RECORDING_BLOCK_FRAMES * sizeof(short);
+        size_t minimum = ((frames + RECORDING_BLOCK_FRAMES - 1) / RECORDING_BLOCK_FRAMES + 2) * (block_bytes + BLOCK_ALIGNMENT);
+        if (budget < minimum)
+        {
+            fprintf(stderr, "[%s] Recording memory share of %.1f MB is too small for %d s of holdback, using %.1f MB\n",
+                    data->label, budget / (1024.0 * 1024.0), REMOVE_LAST_SECONDS, minimum / (1024.0 * 1024.0));
+            budget = minimum;
+        }
+    }
+
+    if (block_pool_init(&data->pool, RECORDING_BLOCK_FRAMES, budget) != 0)
+    {
+        fprintf(stderr, "Failed to allocate recording block pool\n");
+        preroll_free(&data->preroll);
+        ring_buffer_free(&data->ring);
+        free(data->work_buffer);
+        return -1;
+    }
+    printf("[%s] Recording pool: %zu blocks of %zu samples (%.1f MB of the %d MB budget)\n",
+           data->label, data->pool.block_count, data->pool.block_frames, budget / (1024.0 * 1024.0), RECORDING_MEMORY_MB);
+
+    int recording_rate = RECORDING_SAMPLE_RATE > 0 ? RECORDING_SAMPLE_RATE : SAMPLE_RATE;
+    if (resampler_init(&data->resampler, SAMPLE_RATE, recording_rate) != 0 ||
+        !(data->resample_buffer = malloc(resampler_max_output(&data->resampler, data->pool.block_frames) * sizeof(short))))
+    {
+        fprintf(stderr, "Failed to set up %d Hz resampler\n", recording_rate);
+        resampler_free(&data->resampler);
+        block_pool_destroy(&data->pool);
+        preroll_free(&data->preroll);
+        ring_buffer_free(&data->ring);
+        free(data->work_buffer);
+        return -1;
+    }
+    printf("[%s] Recording at %d Hz (%zu taps per phase)\n", data->label, recording_rate, data->resampler.taps);
+    data->wav_encoding = wav_encoding_from_name(WAV_FORMAT);
+
+    if (dsp_chain_init(&data->dsp, recording_rate, resampler_max_output(&data->resampler, data->pool.block_frames)) != 0)
+    {
+        fprintf(stderr, "Failed to set up DSP chain\n");
+        resampler_free(&data->resampler);
+        free(data->resample_buffer);
+        block_pool_destroy(&data->pool);
+        preroll_free(&data->preroll);
+        ring_buffer_free(&data->ring);
+        free(data->work_buffer);
+        return -1;
+    }
+    if (dsp_chain_enabled(&data->dsp))
+        printf("[%s] DSP: high-pass %d Hz | notch %.1f Hz | AGC %s | Delay: %.2f ms\n", data->label, DSP_HIGHPASS_HZ, DSP_NOTCH_HZ, DSP_AGC ? "on" : "off",
+               dsp_chain_delay(&data->dsp) * 1000.0 / recording_rate);
+
+    if (init_voice_detectors(data) != 0)
+    {
+        dsp_chain_free(&data->dsp);
+        resampler_free(&data->resampler);
+        free(data->resample_buffer);
+        block_pool_destroy(&data->pool);
+        preroll_free(&data->preroll);
+        ring_buffer_free(&data->ring);
+        free(data->work_buffer);
+        return -1;
+    }
+
+    sample_clock_init(&data->clock, SAMPLE_RATE);
+    return 0;
+}
+
+// Publishes a transmission still in progress and frees what
+// init_recording_state set up
+static void free_recording_state(AudioData *data)
+{
+    if (data->recording)
+        finish_segment(data, 1);
+    journal_close(&data->journal);
+    block_chain_release(&data->chain, &data->pool);
+    destroy_voice_detectors(data);
+    dsp_chain_free(&data->dsp);
+    resampler_free(&data->resampler);
+    free(data->resample_buffer);
+    data->resample_buffer = NULL;
+    block_pool_destroy(&data->pool);
+    preroll_free(&data->preroll);
+    ring_buffer_free(&data->ring);
+    free(data->work_buffer);
+    data->work_buffer = NULL;
+}
+
+static int start_recording_worker(AudioData *data)
+{
+    if (init_recording_state(data) != 0)
+        return -1;
+
+    sem_init(&data->frames_ready, 0, 0);
+    atomic_store(&data->worker_running, 1);
+
+    if (pthread_create(&data->worker, NULL, recording_worker, data) != 0)
+    {
+        perror("Failed to create recording worker thread");
+        atomic_store(&data->worker_running, 0);
+        sem_destroy(&data->frames_ready);
+        free_recording_state(data);
+        return -1;
+    }
+    return 0;
+}
+
+static void stop_recording_worker(AudioData *data)
+{
+    atomic_store(&data->worker_running, 0);
+    sem_post(&data->frames_ready);
+    pthread_join(data->worker, NULL);
+    sem_destroy(&data->frames_ready);
+    free_recording_state(data);
+}
+
+static void report_ring_status(AudioData *data, int force)
+{
+    unsigned long dropped = atomic_load_explicit(&data->ring.dropped_frames, memory_order_relaxed);
+    unsigned long missing = atomic_load_explicit(&data->missing_input_count, memory_order_relaxed);
+
+    if (!force && dropped == data->reported_dropped && missing == data->reported_missing)
+        return;
+
+    printf("[RING] Input: %s | Callbacks: %lu | Fill: %zu/%zu | High water: %zu | Dropped frames: %lu | Missing input: %lu\n",
+           data->label,
+           atomic_load_explicit(&data->callback_count, memory_order_relaxed),
+           ring_buffer_fill(&data->ring),
+           data->ring.capacity,
+           atomic_load_explicit(&data->ring.high_water, memory_order_relaxed),
+           dropped,
+           missing);
+
+    data->reported_dropped = dropped;
+    data->reported_missing = missing;
+}
+
+static void report_xruns(CaptureStream *capture, int force)
+{
+    unsigned long overflows = atomic_load_explicit(&capture->input_overflows, memory_order_relaxed);
+    unsigned long underflows = atomic_load_explicit(&capture->input_underflows, memory_order_relaxed);
+
+    if (!force && overflows == capture->reported_overflows && underflows == capture->reported_underflows)
+        return;
+
+    printf("[XRUN] Device: %s | Input overflows: %lu (+%lu) | Input underflows: %lu (+%lu)\n",
+           capture->device_name,
+           overflows,
+           overflows - capture->reported_overflows,
+           underflows,
+           underflows - capture->reported_underflows);
+
+    capture->reported_overflows = overflows;
+    capture->reported_underflows = underflows;
 }
 
 int findInputDeviceByName(const char *name)
@@ -250,107 +1024,378 @@ int findInputDeviceByName(const char *name)
     return paNoDevice;
 }
 
-void recorder(const char *com_port)
+// Starts the recording worker for one receiver; the stream is opened later
+// once every receiver on the device is known.
+static int start_receiver(AudioData *data, const InputConfig *input, int index)
 {
-    PaError err;
-    PaStream *stream;
-    AudioData data = {0};
+    snprintf(data->prefix, sizeof(data->prefix), "%s", input->prefix);
+    if (input->prefix[0] != '\0')
+        snprintf(data->label, sizeof(data->label), "%s", input->prefix);
+    else
+        snprintf(data->label, sizeof(data->label), "input%d", index + 1);
+
+    data->channel = input->channel;
+    data->amplitude_threshold = input->amplitude_threshold;
+    data->chunk_size = CHUNK_SIZE;
+    data->recording_total_chunks = 0;
+    snprintf(data->serial_name, sizeof(data->serial_name), "radio");
+    radio_serial_init(&data->radio, input->com_port);
 
-    if (load_env(".env") != 0)
+    printf("[%s] Device: %s | Channel: %d | COM port: %s | Threshold: %d\n",
+           data->label, input->device, data->channel, input->com_port[0] ? input->com_port : "none", data->amplitude_threshold);
+
+    // Without a journal the receiver records as before
+    if (JOURNAL_DIRECTORY[0] != '\0')
     {
-        printf("Failed to load config\n");
-        return;
+        char journal_path[512];
+        snprintf(journal_path, sizeof(journal_path), "%s/%s%s", JOURNAL_DIRECTORY, data->label, JOURNAL_SUFFIX);
+        if (journal_open(&data->journal, journal_path, (size_t)JOURNAL_MB * 1024 * 1024, SAMPLE_RATE, JOURNAL_SYNC_MS) == 0)
+            printf("[%s] Capture journal: %s | %d MB | Sync every %d ms\n", data->label, journal_path, JOURNAL_MB, JOURNAL_SYNC_MS);
     }
 
-    data.amplitude_threshold = AMPLITUDE_THRESHOLD;
-    data.chunk_size = CHUNK_SIZE;
-    data.recording_total_chunks = 0;
-    data.live_listen = LIVE_LISTEN;
+    if (start_recording_worker(data) != 0)
+    {
+        journal_close(&data->journal);
+        return -1;
+    }
+    return 0;
+}
 
-    const char *AUDIO_DEVICE_NAME = "All-In-One-Cable";
+// The serial monitor runs for the life of the process, so it is only started
+// once the receiver's stream is known to work
+static void start_radio_monitor(AudioData *data)
+{
+    if (data->radio.com_port[0] == '\0' || strcmp(data->radio.com_port, "false") == 0)
+        return;
 
-    snprintf(data.serial_name, sizeof(data.serial_name), "radio");
+    pthread_t radio_thread;
+    if (pthread_create(&radio_thread, NULL, radio_serial_thread, &data->radio) == 0)
+    {
+        pthread_detach(radio_thread);
+        data->has_radio = 1;
+    }
+    else
+    {
+        perror("Failed to create radio serial thread");
+    }
+}
 
-    if (data.live_listen)
+static void free_capture_stream(CaptureStream *capture)
+{
+    for (int c = 0; c < MAX_STREAM_CHANNELS; c++)
     {
-        printf("Live Listen ENABLED (Outputting to default speakers)\n");
+        if (capture->receivers[c])
+        {
+            stop_recording_worker(capture->receivers[c]);
+            free(capture->receivers[c]);
+        }
+        free(capture->split[c]);
     }
+    free(capture);
+}
 
-    err = Pa_Initialize();
-    if (err != paNoError)
+// Opens one input-only stream with as many channels as the highest receiver
+// channel. Live listen plays from its own output stream, see monitor.c.
+static int open_capture_stream(CaptureStream *capture)
+{
+    capture->split_frames = CHUNK_SIZE > 0 ? (size_t)CHUNK_SIZE : DEFAULT_CHUNK_SIZE;
+    capture->callback_budget_percent = CALLBACK_BUDGET_PERCENT > 0 ? CALLBACK_BUDGET_PERCENT : 50;
+    if (capture->channels > 1)
     {
-        fprintf(stderr, "PortAudio init error: %s\n", Pa_GetErrorText(err));
-        return;
+        for (int c = 0; c < capture->channels; c++)
+        {
+            capture->split[c] = malloc(capture->split_frames * sizeof(short));
+            if (!capture->split[c])
+            {
+                fprintf(stderr, "Failed to allocate channel split buffer\n");
+                return -1;
+            }
+        }
     }
 
     PaStreamParameters inputParams;
-    int inputDeviceIndex = findInputDeviceByName(AUDIO_DEVICE_NAME);
+    int inputDeviceIndex = findInputDeviceByName(capture->device_name);
 
     if (inputDeviceIndex == paNoDevice)
     {
-        fprintf(stderr, "No default input device.\n");
-        Pa_Terminate();
-        return;
+        fprintf(stderr, "No input device matching \"%s\".\n", capture->device_name);
+        return -1;
     }
 
     inputParams.device = inputDeviceIndex;
-    inputParams.channelCount = CHANNELS;
+    inputParams.channelCount = capture->channels;
     inputParams.sampleFormat = paInt16;
     inputParams.suggestedLatency = Pa_GetDeviceInfo(inputParams.device)->defaultLowInputLatency;
     inputParams.hostApiSpecificStreamInfo = NULL;
 
-    PaStreamParameters outputParams;
-    PaStreamParameters *pOutputParams = NULL;
+    PaError err = Pa_OpenStream(&capture->stream,
+                                &inputParams,
+                                NULL,
+                                SAMPLE_RATE,
+                                capture->split_frames,
+                                paClipOff,
+                                audioCallback,
+                                capture);
 
-    if (data.live_listen)
+    if (err != paNoError)
     {
-        outputParams.device = Pa_GetDefaultOutputDevice();
-        if (outputParams.device == paNoDevice)
-        {
-            fprintf(stderr, "Warning: Live listen enabled but no output device found. Disabling live listen.\n");
-            data.live_listen = 0;
-        }
-        else
+        fprintf(stderr, "[%s] Stream error: %s\n", capture->device_name, Pa_GetErrorText(err));
+        return -1;
+    }
+
+    err = Pa_StartStream(capture->stream);
+    if (err != paNoError)
+    {
+        fprintf(stderr, "[%s] Start error: %s\n", capture->device_name, Pa_GetErrorText(err));
+        Pa_CloseStream(capture->stream);
+        return -1;
+    }
+
+    if (capture->monitor)
+    {
+        const PaStreamInfo *info = Pa_GetStreamInfo(capture->stream);
+        capture->monitor->input_latency = info ? info->inputLatency : inputParams.suggestedLatency;
+    }
+
+    printf("[%s] Capturing %d channel(s)\n", capture->device_name, capture->channels);
+    return 0;
+}
+
+static void close_capture_stream(CaptureStream *capture)
+{
+    Pa_StopStream(capture->stream);
+    Pa_CloseStream(capture->stream);
+    free_capture_stream(capture);
+}
+
+int replay_recording(const char *label, const short *samples, size_t count, int sample_rate,
+                     const struct timespec *start_time, SegmentLog *log)
+{
+    AudioData *data = calloc(1, sizeof(AudioData));
+    if (!data)
+        return -1;
+
+    snprintf(data->label, sizeof(data->label), "%s", label);
+    snprintf(data->prefix, sizeof(data->prefix), "%s", label);
+    snprintf(data->serial_name, sizeof(data->serial_name), "radio");
+    data->channel = 1;
+    data->amplitude_threshold = AMPLITUDE_THRESHOLD;
+    data->chunk_size = CHUNK_SIZE;
+    data->segment_log = log;
+
+    Resampler input;
+    if (init_recording_state(data) != 0)
+    {
+        free(data);
+        return -1;
+    }
+    if (resampler_init(&input, sample_rate, SAMPLE_RATE) != 0)
+    {
+        fprintf(stderr, "Cannot replay %d Hz audio\n", sample_rate);
+        free_recording_state(data);
+        free(data);
+        return -1;
+    }
+    sample_clock_anchor(&data->clock, start_time);
+
+    // Converted to the capture rate and cut into CHUNK_SIZE blocks, as the
+    // callback would deliver them
+    size_t chunk = data->work_buffer_frames;
+    size_t staged_capacity = chunk + resampler_max_output(&input, chunk);
+    short *staged = malloc(staged_capacity * sizeof(short));
+    if (!staged)
+    {
+        resampler_free(&input);
+        free_recording_state(data);
+        free(data);
+        return -1;
+    }
+
+    size_t staged_frames = 0;
+    for (size_t done = 0; done < count; done += chunk)
+    {
+        size_t frames = count - done < chunk ? count - done : chunk;
+        staged_frames += resampler_process(&input, samples + done, frames, staged + staged_frames);
+
+        size_t used = 0;
+        while (staged_frames - used >= chunk)
         {
-            outputParams.channelCount = CHANNELS;
-            outputParams.sampleFormat = paInt16;
-            outputParams.suggestedLatency = Pa_GetDeviceInfo(outputParams.device)->defaultLowOutputLatency;
-            outputParams.hostApiSpecificStreamInfo = NULL;
-            pOutputParams = &outputParams;
+            process_block(data, staged + used, chunk);
+            used += chunk;
         }
+        memmove(staged, staged + used, (staged_frames - used) * sizeof(short));
+        staged_frames -= used;
+    }
+    if (staged_frames > 0)
+        process_block(data, staged, staged_frames);
+
+    report_vad(data);
+    free(staged);
+    resampler_free(&input);
+    free_recording_state(data);
+    free(data);
+    return 0;
+}
+
+void recorder(void)
+{
+    PaError err;
+
+    // Settings come from main(), loaded before the uploaders and the encoder
+    // started; loading .env again here would rewrite them under those threads
+
+    // Without INPUT_<n>_ entries, record the single legacy input
+    InputConfig inputs[MAX_INPUTS];
+    int input_count = INPUT_COUNT;
+    memcpy(inputs, INPUTS, sizeof(inputs));
+    if (input_count == 0)
+    {
+        memset(&inputs[0], 0, sizeof(inputs[0]));
+        snprintf(inputs[0].device, sizeof(inputs[0].device), "%s", DEFAULT_AUDIO_DEVICE_NAME);
+        snprintf(inputs[0].com_port, sizeof(inputs[0].com_port), "%s", COM_PORT);
+        inputs[0].channel = 1;
+        inputs[0].amplitude_threshold = AMPLITUDE_THRESHOLD;
+        input_count = 1;
     }
 
-    err = Pa_OpenStream(&stream,
-                        &inputParams,
-                        pOutputParams,
-                        SAMPLE_RATE,
-                        data.chunk_size,
-                        paClipOff,
-                        audioCallback,
-                        &data);
+    audio_stats_init();
+    printf("Amplitude kernel: %s\n", block_stats_backend());
 
+    err = Pa_Initialize();
     if (err != paNoError)
     {
-        fprintf(stderr, "Stream error: %s\n", Pa_GetErrorText(err));
-        Pa_Terminate();
+        fprintf(stderr, "PortAudio init error: %s\n", Pa_GetErrorText(err));
         return;
     }
 
-    err = Pa_StartStream(stream);
-    if (err != paNoError)
+    // Receivers naming the same device share one stream
+    CaptureStream *captures[MAX_INPUTS] = {0};
+    int capture_count = 0;
+    for (int i = 0; i < input_count; i++)
+    {
+        const InputConfig *input = &inputs[i];
+        if (input->channel > MAX_STREAM_CHANNELS)
+        {
+            fprintf(stderr, "Input %d: channel %d is out of range (1-%d)\n", i + 1, input->channel, MAX_STREAM_CHANNELS);
+            continue;
+        }
+
+        CaptureStream *capture = NULL;
+        for (int s = 0; s < capture_count; s++)
+        {
+            if (strcmp(captures[s]->device_name, input->device) == 0)
+                capture = captures[s];
+        }
+        if (!capture)
+        {
+            capture = calloc(1, sizeof(CaptureStream));
+            if (!capture)
+            {
+                fprintf(stderr, "Failed to allocate state for input %d\n", i + 1);
+                continue;
+            }
+            strncpy(capture->device_name, input->device, sizeof(capture->device_name) - 1);
+            capture->device_name[sizeof(capture->device_name) - 1] = '\0';
+            captures[capture_count++] = capture;
+        }
+
+        if (capture->receivers[input->channel - 1])
+        {
+            fprintf(stderr, "Input %d: channel %d of \"%s\" is already in use\n", i + 1, input->channel, input->device);
+            continue;
+        }
+
+        AudioData *data = calloc(1, sizeof(AudioData));
+        if (!data)
+        {
+            fprintf(stderr, "Failed to allocate state for input %d\n", i + 1);
+            continue;
+        }
+        // RECORDING_MEMORY_MB is the budget for all receivers together
+        data->pool_budget = (size_t)RECORDING_MEMORY_MB * 1024 * 1024 / input_count;
+        if (start_receiver(data, input, i) != 0)
+        {
+            free(data);
+            continue;
+        }
+
+        capture->receivers[input->channel - 1] = data;
+        if (input->channel > capture->channels)
+            capture->channels = input->channel;
+    }
+
+    // Live listen follows the first stream that starts, since there is one speaker
+    AudioData *receivers[MAX_INPUTS];
+    int receiver_count = 0;
+    int running = 0;
+    Monitor *monitor = NULL;
+    for (int s = 0; s < capture_count; s++)
+    {
+        CaptureStream *capture = captures[s];
+        if (LIVE_LISTEN && !monitor && capture->channels > 0)
+        {
+            monitor = calloc(1, sizeof(Monitor));
+            if (!monitor || monitor_init(monitor, capture->channels, SAMPLE_RATE) != 0)
+            {
+                fprintf(stderr, "Failed to allocate live listen buffer, live listen disabled\n");
+                free(monitor);
+                monitor = NULL;
+            }
+            capture->monitor = monitor;
+        }
+
+        if (capture->channels == 0 || open_capture_stream(capture) != 0)
+        {
+            if (capture->monitor)
+            {
+                monitor_free(monitor);
+                free(monitor);
+                monitor = NULL;
+            }
+            free_capture_stream(capture);
+            continue;
+        }
+        captures[running++] = capture;
+
+        for (int c = 0; c < capture->channels; c++)
+        {
+            if (!capture->receivers[c])
+                continue;
+            start_radio_monitor(capture->receivers[c]);
+            receivers[receiver_count++] = capture->receivers[c];
+        }
+    }
+
+    if (running == 0)
     {
-        fprintf(stderr, "Start error: %s\n", Pa_GetErrorText(err));
-        Pa_CloseStream(stream);
+        fprintf(stderr, "No input could be started.\n");
         Pa_Terminate();
         return;
     }
+    printf("Recording %d receiver(s) on %d stream(s)\n", receiver_count, running);
 
+    int seconds = 0;
     while (1)
     {
         sleep(1);
+        seconds++;
+        // SIGUSR1 brings the counters along with the profile
+        int force = profiler_poll(0) || seconds % RING_STATUS_INTERVAL == 0;
+        for (int s = 0; s < running; s++)
+            report_xruns(captures[s], force);
+        for (int i = 0; i < receiver_count; i++)
+            report_ring_status(receivers[i], force);
+        if (monitor)
+            monitor_poll(monitor, force);
+        upload_queue_poll(force);
     }
 
-    Pa_StopStream(stream);
-    Pa_CloseStream(stream);
+    for (int s = 0; s < running; s++)
+        close_capture_stream(captures[s]);
+    if (monitor)
+    {
+        monitor_free(monitor);
+        free(monitor);
+    }
     Pa_Terminate();
-}
\ No newline at end of file
+}
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "h/replay.h"
+#include "h/recordAudio.h"
+#include "h/write_wav_file.h"
+#include "h/profiler.h"
+#include "h/config.h"
+
+typedef struct
+{
+    const char *input;
+    int sample_rate;
+    double audio_seconds;
+    double replay_seconds;
+    int failed;
+    SegmentLog log;
+} ReplayFile;
+
+static double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int parse_start_time(const char *text, struct timespec *out)
+{
+    struct tm tm_info;
+    memset(&tm_info, 0, sizeof(tm_info));
+    if (sscanf(text, "%d-%d-%d %d:%d:%d", &tm_info.tm_year, &tm_info.tm_mon, &tm_info.tm_mday,
+               &tm_info.tm_hour, &tm_info.tm_min, &tm_info.tm_sec) != 6)
+        return -1;
+    tm_info.tm_year -= 1900;
+    tm_info.tm_mon -= 1;
+    tm_info.tm_isdst = -1;
+
+    out->tv_sec = mktime(&tm_info);
+    out->tv_nsec = 0;
+    return out->tv_sec == (time_t)-1 ? -1 : 0;
+}
+
+// <dir>/<name>.wav -> <name>, which becomes the receiver prefix
+static void input_label(const char *path, char *out, size_t size)
+{
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    const char *extension = strrchr(name, '.');
+    int name_len = extension ? (int)(extension - name) : (int)strlen(name);
+    snprintf(out, size, "%.*s", name_len, name);
+}
+
+static void write_json_string(FILE *file, const char *text)
+{
+    fputc('"', file);
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf(file, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf(file, "\\u%04x", *c);
+        else
+            fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+static int write_report(const char *path, const ReplayFile *files, int file_count, double wall_seconds)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        perror("Failed to create replay report");
+        return -1;
+    }
+
+    double audio_seconds = 0;
+    for (int i = 0; i < file_count; i++)
+        audio_seconds += files[i].audio_seconds;
+
+    fprintf(file, "{\n  \"config\": {\n");
+    fprintf(file, "    \"chunk_size\": %d,\n", CHUNK_SIZE);
+    fprintf(file, "    \"amplitude_threshold\": %d,\n", AMPLITUDE_THRESHOLD);
+    fprintf(file, "    \"vad_mode\": ");
+    write_json_string(file, VAD_MODE);
+    fprintf(file, ",\n    \"vad_open_db\": %d,\n", VAD_OPEN_DB);
+    fprintf(file, "    \"vad_close_db\": %d,\n", VAD_CLOSE_DB);
+    fprintf(file, "    \"vad_min_voice_ms\": %d,\n", VAD_MIN_VOICE_MS);
+    fprintf(file, "    \"silence_threshold\": %d,\n", SILENCE_THRESHOLD);
+    fprintf(file, "    \"remove_last_seconds\": %d,\n", REMOVE_LAST_SECONDS);
+    fprintf(file, "    \"preroll_ms\": %d,\n", PREROLL_MS);
+    fprintf(file, "    \"max_segment_seconds\": %d,\n", MAX_SEGMENT_SECONDS);
+    fprintf(file, "    \"recording_sample_rate\": %d\n", RECORDING_SAMPLE_RATE);
+    fprintf(file, "  },\n");
+    fprintf(file, "  \"audio_seconds\": %.3f,\n", audio_seconds);
+    fprintf(file, "  \"replay_seconds\": %.3f,\n", wall_seconds);
+    fprintf(file, "  \"speed\": %.1f,\n", wall_seconds > 0 ? audio_seconds / wall_seconds : 0);
+    fprintf(file, "  \"files\": [");
+
+    for (int i = 0; i < file_count; i++)
+    {
+        const ReplayFile *replay = &files[i];
+        fprintf(file, "%s\n    {\n      \"input\": ", i > 0 ? "," : "");
+        write_json_string(file, replay->input);
+        fprintf(file, ",\n      \"ok\": %s,\n", replay->failed ? "false" : "true");
+        fprintf(file, "      \"sample_rate\": %d,\n", replay->sample_rate);
+        fprintf(file, "      \"audio_seconds\": %.3f,\n", replay->audio_seconds);
+        fprintf(file, "      \"replay_seconds\": %.3f,\n", replay->replay_seconds);
+        fprintf(file, "      \"segments\": [");
+
+        for (size_t s = 0; s < replay->log.count; s++)
+        {
+            const SegmentRecord *segment = &replay->log.segments[s];
+            fprintf(file, "%s\n        {\"start\": %.3f, \"end\": %.3f, \"seconds\": %.3f, \"voiced\": %.3f, \"part\": %d, \"result\": ",
+                    s > 0 ? "," : "",
+                    segment->start_seconds,
+                    segment->start_seconds + segment->seconds,
+                    segment->seconds,
+                    segment->voiced_seconds,
+                    segment->part);
+            write_json_string(file, segment->result);
+            fprintf(file, ", \"path\": ");
+            write_json_string(file, segment->path);
+            fprintf(file, "}");
+        }
+        fprintf(file, "%s]\n    }", replay->log.count > 0 ? "\n      " : "");
+    }
+    fprintf(file, "%s]\n}\n", file_count > 0 ? "\n  " : "");
+
+    if (fclose(file) != 0)
+    {
+        perror("Failed to write replay report");
+        return -1;
+    }
+    return 0;
+}
+
+static void replay_file(ReplayFile *replay, const struct timespec *start_time)
+{
+    size_t count;
+    short *samples = wav_file_read(replay->input, &count, &replay->sample_rate);
+    if (!samples || replay->sample_rate <= 0)
+    {
+        fprintf(stderr, "Failed to read %s (mono WAV expected)\n", replay->input);
+        free(samples);
+        replay->failed = 1;
+        return;
+    }
+    replay->audio_seconds = (double)count / replay->sample_rate;
+
+    char label[64];
+    input_label(replay->input, label, sizeof(label));
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    replay->failed = replay_recording(label, samples, count, replay->sample_rate, start_time, &replay->log) != 0;
+    replay->replay_seconds = elapsed_seconds(&start);
+    free(samples);
+
+    printf("[REPLAY] %s | Audio: %.2fs | Replay: %.3fs (%.0fx real time) | Segments: %zu\n",
+           replay->input,
+           replay->audio_seconds,
+           replay->replay_seconds,
+           replay->replay_seconds > 0 ? replay->audio_seconds / replay->replay_seconds : 0,
+           replay->log.count);
+}
+
+int replay_main(int argc, char **argv)
+{
+    const char *env_path = ".env";
+    const char *output = REPLAY_DEFAULT_OUTPUT;
+    const char *report = REPLAY_DEFAULT_REPORT;
+    const char *start_text = REPLAY_DEFAULT_START;
+
+    int first_input = 1;
+    while (first_input + 1 < argc && strncmp(argv[first_input], "--", 2) == 0)
+    {
+        const char *option = argv[first_input];
+        const char *value = argv[first_input + 1];
+        if (strcmp(option, "--env") == 0)
+            env_path = value;
+        else if (strcmp(option, "--output") == 0)
+            output = value;
+        else if (strcmp(option, "--report") == 0)
+            report = value;
+        else if (strcmp(option, "--start") == 0)
+            start_text = value;
+        else
+            break;
+        first_input += 2;
+    }
+
+    struct timespec start_time;
+    if (first_input >= argc || strncmp(argv[first_input], "--", 2) == 0 || parse_start_time(start_text, &start_time) != 0)
+    {
+        fprintf(stderr, "Usage: recorder --replay [--env FILE] [--output DIR] [--report FILE] [--start \"YYYY-MM-DD HH:MM:SS\"] FILE.wav...\n");
+        return 1;
+    }
+
+    if (load_env(env_path) != 0)
+    {
+        printf("Failed to load config\n");
+        return 1;
+    }
+    // Never into the watched directory, where the recordings would be uploaded
+    snprintf(RECORDING_DIRECTORY, sizeof(RECORDING_DIRECTORY), "%s", output);
+    mkdir(RECORDING_DIRECTORY, 0700);
+    profiler_init();
+
+    int file_count = argc - first_input;
+    ReplayFile *files = calloc(file_count, sizeof(ReplayFile));
+    if (!files)
+        return 1;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int failed = 0;
+    for (int i = 0; i < file_count; i++)
+    {
+        files[i].input = argv[first_input + i];
+        replay_file(&files[i], &start_time);
+        failed |= files[i].failed;
+    }
+    double wall_seconds = elapsed_seconds(&start);
+
+    profiler_poll(1);
+    if (write_report(report, files, file_count, wall_seconds) != 0)
+        failed = 1;
+    else
+        printf("[REPLAY] Report written to %s\n", report);
+
+    for (int i = 0; i < file_count; i++)
+        free(files[i].log.segments);
+    free(files);
+    return failed ? 1 : 0;
+}
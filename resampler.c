@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "h/resampler.h"
+
+// Zero crossings of the sinc kept on each side, at the lower of the two rates
+#define RESAMPLER_ZERO_CROSSINGS 24
+#define RESAMPLER_KAISER_BETA 8.6
+// Cutoff as a fraction of the lower rate: 0.42 puts the end of the
+// transition band at that rate's Nyquist frequency
+#define RESAMPLER_CUTOFF 0.42
+
+// Portable 4-lane vectors: SSE on x86, NEON on ARM, scalar code elsewhere
+typedef float v4sf __attribute__((vector_size(16)));
+typedef float v4sf_unaligned __attribute__((vector_size(16), aligned(4)));
+
+static int gcd(int a, int b)
+{
+    while (b)
+    {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; k++)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+int resampler_init(Resampler *resampler, int in_rate, int out_rate)
+{
+    memset(resampler, 0, sizeof(*resampler));
+    if (in_rate <= 0 || out_rate <= 0)
+        return -1;
+
+    int divisor = gcd(in_rate, out_rate);
+    resampler->in_rate = in_rate;
+    resampler->out_rate = out_rate;
+    resampler->up = out_rate / divisor;
+    resampler->down = in_rate / divisor;
+    if (resampler->up == 1 && resampler->down == 1)
+        return 0;
+
+    // Sub-filter length in input samples, rounded up to whole vectors
+    double ratio = resampler->down > resampler->up ? (double)resampler->down / resampler->up : 1.0;
+    size_t taps = (size_t)ceil(2 * RESAMPLER_ZERO_CROSSINGS * ratio);
+    taps = (taps + 3) & ~(size_t)3;
+    resampler->taps = taps;
+
+    size_t up = (size_t)resampler->up;
+    resampler->coeffs = aligned_alloc(16, up * taps * sizeof(float));
+    resampler->work = malloc((taps - 1 + RESAMPLER_CHUNK) * sizeof(float));
+    if (!resampler->coeffs || !resampler->work)
+    {
+        resampler_free(resampler);
+        return -1;
+    }
+
+    // Prototype filter runs at the upsampled rate in_rate * up
+    size_t length = up * taps;
+    double center = (length - 1) / 2.0;
+    double cutoff = RESAMPLER_CUTOFF / (up * ratio);
+    double norm = bessel_i0(RESAMPLER_KAISER_BETA);
+
+    for (size_t j = 0; j < length; j++)
+    {
+        double t = j - center;
+        double sinc = t == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * t) / (M_PI * t);
+        double r = t / (center + 0.5);
+        double window = bessel_i0(RESAMPLER_KAISER_BETA * sqrt(1 - r * r)) / norm;
+        double h = up * sinc * window;
+
+        // Phase p tap k multiplies x[n - k]; stored reversed so each output
+        // is a dot product against consecutive work samples
+        size_t p = j % up, k = j / up;
+        resampler->coeffs[p * taps + (taps - 1 - k)] = (float)h;
+    }
+
+    resampler_reset(resampler);
+    return 0;
+}
+
+void resampler_free(Resampler *resampler)
+{
+    free(resampler->coeffs);
+    free(resampler->work);
+    resampler->coeffs = NULL;
+    resampler->work = NULL;
+}
+
+// Forgets the history so the next input starts a new, unrelated signal
+void resampler_reset(Resampler *resampler)
+{
+    if (resampler->work)
+        memset(resampler->work, 0, (resampler->taps - 1) * sizeof(float));
+    resampler->position = 0;
+}
+
+size_t resampler_max_output(const Resampler *resampler, size_t frames)
+{
+    return (frames * resampler->up + resampler->down - 1) / resampler->down + 1;
+}
+
+static float dot_product(const float *samples, const float *coeffs, size_t taps)
+{
+    v4sf acc0 = {0, 0, 0, 0};
+    v4sf acc1 = {0, 0, 0, 0};
+    size_t i = 0;
+
+    for (; i + 8 <= taps; i += 8)
+    {
+        acc0 += *(const v4sf_unaligned *)(samples + i) * *(const v4sf *)(coeffs + i);
+        acc1 += *(const v4sf_unaligned *)(samples + i + 4) * *(const v4sf *)(coeffs + i + 4);
+    }
+    if (i < taps)
+        acc0 += *(const v4sf_unaligned *)(samples + i) * *(const v4sf *)(coeffs + i);
+
+    acc0 += acc1;
+    return acc0[0] + acc0[1] + acc0[2] + acc0[3];
+}
+
+static short to_sample(float value)
+{
+    if (value >= 32767.0f)
+        return 32767;
+    if (value <= -32768.0f)
+        return -32768;
+    return (short)lrintf(value);
+}
+
+// Returns the number of output frames written, at most resampler_max_output()
+size_t resampler_process(Resampler *resampler, const short *input, size_t frames, short *output)
+{
+    if (!resampler->coeffs)
+    {
+        memcpy(output, input, frames * sizeof(short));
+        return frames;
+    }
+
+    size_t taps = resampler->taps;
+    size_t up = (size_t)resampler->up;
+    size_t down = (size_t)resampler->down;
+    float *work = resampler->work;
+    size_t produced = 0;
+
+    for (size_t start = 0; start < frames; start += RESAMPLER_CHUNK)
+    {
+        size_t count = frames - start < RESAMPLER_CHUNK ? frames - start : RESAMPLER_CHUNK;
+        for (size_t i = 0; i < count; i++)
+            work[taps - 1 + i] = input[start + i];
+
+        // position counts in 1/up input samples from the start of this chunk
+        size_t position = resampler->position;
+        while (position / up < count)
+        {
+            size_t base = position / up;
+            const float *coeffs = resampler->coeffs + (position % up) * taps;
+            output[produced++] = to_sample(dot_product(work + base, coeffs, taps));
+            position += down;
+        }
+        resampler->position = position - count * up;
+
+        memmove(work, work + count, (taps - 1) * sizeof(float));
+    }
+
+    return produced;
+}
@@ -0,0 +1,105 @@
+#include <stdlib.h>
+#include <string.h>
+#include "h/ring_buffer.h"
+
+int ring_buffer_init(RingBuffer *rb, size_t min_capacity)
+{
+    size_t capacity = 1;
+    while (capacity < min_capacity)
+        capacity <<= 1;
+
+    rb->data = calloc(capacity, sizeof(short));
+    if (!rb->data)
+        return -1;
+
+    rb->capacity = capacity;
+    rb->mask = capacity - 1;
+    atomic_init(&rb->head, 0);
+    atomic_init(&rb->tail, 0);
+    atomic_init(&rb->high_water, 0);
+    atomic_init(&rb->dropped_frames, 0);
+    return 0;
+}
+
+void ring_buffer_free(RingBuffer *rb)
+{
+    free(rb->data);
+    rb->data = NULL;
+    rb->capacity = 0;
+    rb->mask = 0;
+}
+
+// Producer side. Writes the whole block or nothing, so the consumer never sees
+// a torn callback buffer; a rejected block is counted in dropped_frames.
+size_t ring_buffer_write(RingBuffer *rb, const short *src, size_t count)
+{
+    size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    size_t used = head - tail;
+
+    if (count > rb->capacity - used)
+    {
+        atomic_fetch_add_explicit(&rb->dropped_frames, count, memory_order_relaxed);
+        return 0;
+    }
+
+    size_t start = head & rb->mask;
+    size_t first = rb->capacity - start;
+    if (first > count)
+        first = count;
+
+    memcpy(rb->data + start, src, first * sizeof(short));
+    memcpy(rb->data, src + first, (count - first) * sizeof(short));
+
+    atomic_store_explicit(&rb->head, head + count, memory_order_release);
+
+    used += count;
+    if (used > atomic_load_explicit(&rb->high_water, memory_order_relaxed))
+        atomic_store_explicit(&rb->high_water, used, memory_order_relaxed);
+
+    return count;
+}
+
+// Consumer side. Copies up to count frames out and returns how many were read.
+size_t ring_buffer_read(RingBuffer *rb, short *dst, size_t count)
+{
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    size_t available = head - tail;
+
+    if (count > available)
+        count = available;
+    if (count == 0)
+        return 0;
+
+    size_t start = tail & rb->mask;
+    size_t first = rb->capacity - start;
+    if (first > count)
+        first = count;
+
+    memcpy(dst, rb->data + start, first * sizeof(short));
+    memcpy(dst + first, rb->data, (count - first) * sizeof(short));
+
+    atomic_store_explicit(&rb->tail, tail + count, memory_order_release);
+    return count;
+}
+
+// Consumer side. Drops up to count frames without copying them out.
+size_t ring_buffer_discard(RingBuffer *rb, size_t count)
+{
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    size_t available = head - tail;
+
+    if (count > available)
+        count = available;
+    atomic_store_explicit(&rb->tail, tail + count, memory_order_release);
+    return count;
+}
+
+size_t ring_buffer_fill(RingBuffer *rb)
+{
+    size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+    return head - tail;
+}
@@ -0,0 +1,82 @@
+#include <string.h>
+#include "h/sample_clock.h"
+
+#define NS_PER_SEC 1000000000LL
+
+void sample_clock_init(SampleClock *clock, int sample_rate)
+{
+    clock->sample_rate = sample_rate;
+    atomic_init(&clock->sequence, 0);
+    atomic_init(&clock->anchored, 0);
+    atomic_init(&clock->realtime_offset_ns, 0);
+    atomic_init(&clock->obs_frame, 0);
+    atomic_init(&clock->obs_time_ns, 0);
+}
+
+// Producer side, called from the audio callback. frame is the stream position
+// of the first sample in the buffer and adc_time its capture time on the
+// stream clock; now_time is the stream clock at the moment of the call.
+void sample_clock_observe(SampleClock *clock, uint64_t frame, double adc_time, double now_time)
+{
+    if (!atomic_load_explicit(&clock->anchored, memory_order_relaxed))
+    {
+        struct timespec rt;
+        clock_gettime(CLOCK_REALTIME, &rt);
+        long long rt_ns = rt.tv_sec * NS_PER_SEC + rt.tv_nsec;
+        atomic_store_explicit(&clock->realtime_offset_ns, rt_ns - (long long)(now_time * 1e9), memory_order_relaxed);
+    }
+
+    unsigned int seq = atomic_load_explicit(&clock->sequence, memory_order_relaxed);
+    atomic_store_explicit(&clock->sequence, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_explicit(&clock->obs_frame, frame, memory_order_relaxed);
+    atomic_store_explicit(&clock->obs_time_ns, (long long)(adc_time * 1e9), memory_order_relaxed);
+
+    atomic_store_explicit(&clock->sequence, seq + 2, memory_order_release);
+    atomic_store_explicit(&clock->anchored, 1, memory_order_release);
+}
+
+// Consumer side. Falls back to the current wall-clock time before the first
+// callback has anchored the clock.
+void sample_clock_realtime(SampleClock *clock, uint64_t frame, struct timespec *out)
+{
+    if (!atomic_load_explicit(&clock->anchored, memory_order_acquire))
+    {
+        clock_gettime(CLOCK_REALTIME, out);
+        return;
+    }
+
+    unsigned int before, after;
+    uint64_t obs_frame;
+    long long obs_time_ns;
+    do
+    {
+        before = atomic_load_explicit(&clock->sequence, memory_order_acquire);
+        obs_frame = atomic_load_explicit(&clock->obs_frame, memory_order_relaxed);
+        obs_time_ns = atomic_load_explicit(&clock->obs_time_ns, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&clock->sequence, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    long long delta_frames = (long long)(frame - obs_frame);
+    long long ns = atomic_load_explicit(&clock->realtime_offset_ns, memory_order_relaxed) +
+                   obs_time_ns + delta_frames * NS_PER_SEC / clock->sample_rate;
+
+    out->tv_sec = ns / NS_PER_SEC;
+    out->tv_nsec = ns % NS_PER_SEC;
+}
+
+// Pins frame 0 to a fixed wall-clock time, for replaying recorded audio
+void sample_clock_anchor(SampleClock *clock, const struct timespec *start)
+{
+    atomic_store_explicit(&clock->realtime_offset_ns, start->tv_sec * NS_PER_SEC + start->tv_nsec, memory_order_relaxed);
+    atomic_store_explicit(&clock->obs_frame, 0, memory_order_relaxed);
+    atomic_store_explicit(&clock->obs_time_ns, 0, memory_order_relaxed);
+    atomic_store_explicit(&clock->anchored, 1, memory_order_release);
+}
+
+double sample_clock_seconds(const SampleClock *clock, uint64_t frames)
+{
+    return (double)frames / clock->sample_rate;
+}
@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "h/spectrogram.h"
+#include "h/write_wav_file.h"
+#include "h/config.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#define STBI_WRITE_NO_STDIO
+#include "h/stb_image_write.h"
+
+typedef struct
+{
+    char recording_path[1024];
+    short *samples;
+    size_t count;
+    int sample_rate;
+} SpectrogramJob;
+
+typedef struct
+{
+    FILE *file;
+    size_t bytes;
+    int failed;
+} PngOutput;
+
+static SpectrogramJob queue[SPECTROGRAM_QUEUE_SIZE];
+static size_t queue_head;
+static size_t queue_count;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+static SpectrogramCallback written_callback;
+static int worker_count;
+
+static double elapsed_seconds(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Black through blue, magenta, red and orange to pale yellow
+static void fill_palette(unsigned char palette[256][3])
+{
+    static const float stops[][3] = {
+        {0, 0, 0}, {20, 10, 80}, {120, 20, 130}, {210, 50, 70}, {250, 140, 20}, {255, 250, 190}};
+    const int last = sizeof(stops) / sizeof(stops[0]) - 1;
+
+    for (int i = 0; i < 256; i++)
+    {
+        float x = i / 255.0f * last;
+        int k = x < last ? (int)x : last - 1;
+        float f = x - k;
+        for (int c = 0; c < 3; c++)
+            palette[i][c] = (unsigned char)lrintf(stops[k][c] + f * (stops[k + 1][c] - stops[k][c]));
+    }
+}
+
+size_t spectrogram_fft_size(int sample_rate)
+{
+    // About 32 ms, enough to resolve the harmonics of a voice
+    size_t size = 256;
+    while (size < (size_t)sample_rate * 32 / 1000)
+        size <<= 1;
+    return size;
+}
+
+// Mean power per column and bin, bins 1..height, relative to a full-scale sine
+static void compute_columns(FftPlan *plan, const short *samples, size_t count, size_t frames,
+                            int width, int height, float *window, float *frame, float *power,
+                            float *columns, unsigned int *column_frames)
+{
+    size_t size = plan->size;
+    size_t hop = size / 4;
+
+    // A full-scale sine through a Hann window peaks at size / 4
+    fft_hann_window(window, size);
+    for (size_t i = 0; i < size; i++)
+        window[i] *= 4.0f / (32768.0f * size);
+
+    memset(columns, 0, (size_t)width * height * sizeof(float));
+    memset(column_frames, 0, width * sizeof(unsigned int));
+
+    for (size_t f = 0; f < frames; f++)
+    {
+        size_t start = f * hop;
+        size_t available = start < count ? count - start : 0;
+        if (available > size)
+            available = size;
+        for (size_t i = 0; i < available; i++)
+            frame[i] = samples[start + i] * window[i];
+        for (size_t i = available; i < size; i++)
+            frame[i] = 0;
+
+        fft_real_power(plan, frame, power);
+
+        size_t column = f * width / frames;
+        float *out = columns + column * height;
+        for (int b = 0; b < height; b++)
+            out[b] += power[b + 1];
+        column_frames[column]++;
+    }
+}
+
+static void render_pixels(const float *columns, const unsigned int *column_frames, int width, int height,
+                          size_t fft_size, int sample_rate, unsigned char *pixels)
+{
+    unsigned char palette[256][3];
+    fill_palette(palette);
+    const float scale = 255.0f / (SPECTROGRAM_CEILING_DB - SPECTROGRAM_FLOOR_DB);
+
+    for (int x = 0; x < width; x++)
+    {
+        const float *column = columns + (size_t)x * height;
+        float norm = column_frames[x] > 0 ? 1.0f / column_frames[x] : 0;
+        for (int y = 0; y < height; y++)
+        {
+            // Low frequencies at the bottom
+            float db = 10.0f * log10f(column[height - 1 - y] * norm + 1e-20f);
+            float level = (db - (float)SPECTROGRAM_FLOOR_DB) * scale;
+            int index = level <= 0 ? 0 : level >= 255 ? 255 : (int)level;
+            unsigned char *pixel = pixels + ((size_t)y * width + x) * 3;
+            memcpy(pixel, palette[index], 3);
+        }
+    }
+
+    // Faint line every kHz
+    for (int khz = 1; ; khz++)
+    {
+        int bin = (int)lrint(khz * 1000.0 * fft_size / sample_rate);
+        if (bin < 1 || bin > height)
+            break;
+        unsigned char *row = pixels + (size_t)(height - bin) * width * 3;
+        for (int i = 0; i < width * 3; i++)
+            row[i] = (unsigned char)((row[i] + 96) / 2);
+    }
+}
+
+static void write_png_data(void *context, void *data, int size)
+{
+    PngOutput *output = context;
+    if (fwrite(data, 1, size, output->file) != (size_t)size)
+        output->failed = 1;
+    output->bytes += size;
+}
+
+// Written to <path>.part and renamed into place
+static int write_png(const char *path, const unsigned char *pixels, int width, int height, size_t *bytes)
+{
+    char part[1040];
+    snprintf(part, sizeof(part), "%s%s", path, WAV_PART_SUFFIX);
+
+    PngOutput output = {fopen(part, "wb"), 0, 0};
+    if (!output.file)
+    {
+        perror("Failed to create spectrogram");
+        return -1;
+    }
+
+    int written = stbi_write_png_to_func(write_png_data, &output, width, height, 3, pixels, width * 3);
+    if (fclose(output.file) != 0)
+        output.failed = 1;
+    if (!written || output.failed || rename(part, path) != 0)
+    {
+        fprintf(stderr, "Failed to write %s\n", path);
+        remove(part);
+        return -1;
+    }
+    *bytes = output.bytes;
+    return 0;
+}
+
+int spectrogram_write(FftPlan *plan, const short *samples, size_t count, int sample_rate, const char *png_path, SpectrogramStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (sample_rate <= 0)
+        return -1;
+
+    size_t size = spectrogram_fft_size(sample_rate);
+    if (plan->size != size)
+    {
+        fft_plan_free(plan);
+        if (fft_plan_init(plan, size) != 0)
+            return -1;
+    }
+
+    size_t hop = size / 4;
+    size_t frames = count > size ? 1 + (count - size + hop - 1) / hop : 1;
+    int width = frames < SPECTROGRAM_MAX_WIDTH ? (int)frames : SPECTROGRAM_MAX_WIDTH;
+    double top_hz = sample_rate / 2.0 < SPECTROGRAM_MAX_HZ ? sample_rate / 2.0 : SPECTROGRAM_MAX_HZ;
+    int height = (int)(top_hz * size / sample_rate);
+
+    float *window = malloc(size * sizeof(float));
+    float *frame = malloc(size * sizeof(float));
+    float *power = malloc((size / 2 + 1) * sizeof(float));
+    float *columns = malloc((size_t)width * height * sizeof(float));
+    unsigned int *column_frames = malloc(width * sizeof(unsigned int));
+    unsigned char *pixels = malloc((size_t)width * height * 3);
+    int result = -1;
+
+    if (window && frame && power && columns && column_frames && pixels)
+    {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        compute_columns(plan, samples, count, frames, width, height, window, frame, power, columns, column_frames);
+        stats->fft_seconds = elapsed_seconds(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        render_pixels(columns, column_frames, width, height, size, sample_rate, pixels);
+        result = write_png(png_path, pixels, width, height, &stats->png_bytes);
+        stats->render_seconds = elapsed_seconds(&start);
+    }
+    else
+    {
+        fprintf(stderr, "Out of memory for spectrogram %s\n", png_path);
+    }
+
+    stats->samples = count;
+    stats->sample_rate = sample_rate;
+    stats->fft_size = size;
+    stats->frames = frames;
+    stats->width = width;
+    stats->height = height;
+
+    free(window);
+    free(frame);
+    free(power);
+    free(columns);
+    free(column_frames);
+    free(pixels);
+    return result;
+}
+
+// <dir>/<name>.wav -> SPECTROGRAM_DIRECTORY/<name>.png
+static void png_path_for(const char *recording_path, char *out, size_t size)
+{
+    const char *name = strrchr(recording_path, '/');
+    name = name ? name + 1 : recording_path;
+    const char *extension = strrchr(name, '.');
+    int name_len = extension ? (int)(extension - name) : (int)strlen(name);
+    snprintf(out, size, "%s/%.*s.png", SPECTROGRAM_DIRECTORY, name_len, name);
+}
+
+static void spectrogram_job(FftPlan *plan, const SpectrogramJob *job)
+{
+    char png_path[1024];
+    png_path_for(job->recording_path, png_path, sizeof(png_path));
+
+    SpectrogramStats stats;
+    if (spectrogram_write(plan, job->samples, job->count, job->sample_rate, png_path, &stats) != 0)
+        return;
+
+    double audio_seconds = (double)stats.samples / stats.sample_rate;
+    double total = stats.fft_seconds + stats.render_seconds;
+    printf("[SPECTROGRAM] %s | Audio: %.2fs | %zu frames of %zu -> %dx%d | FFT: %.1f ms | Render: %.1f ms (%.0f ms per minute) | %zu KB\n",
+           png_path,
+           audio_seconds,
+           stats.frames,
+           stats.fft_size,
+           stats.width,
+           stats.height,
+           stats.fft_seconds * 1000,
+           stats.render_seconds * 1000,
+           audio_seconds > 0 ? total * 1000 * 60 / audio_seconds : 0,
+           stats.png_bytes / 1024);
+
+    if (written_callback)
+        written_callback(png_path, job->recording_path);
+}
+
+static void *spectrogram_worker(void *arg)
+{
+    // Only this thread; the rest of the process keeps its priority
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), SPECTROGRAM_NICE);
+
+    FftPlan plan;
+    memset(&plan, 0, sizeof(plan));
+
+    while (1)
+    {
+        pthread_mutex_lock(&queue_lock);
+        while (queue_count == 0)
+            pthread_cond_wait(&queue_ready, &queue_lock);
+        SpectrogramJob job = queue[queue_head];
+        queue_head = (queue_head + 1) % SPECTROGRAM_QUEUE_SIZE;
+        queue_count--;
+        pthread_mutex_unlock(&queue_lock);
+
+        spectrogram_job(&plan, &job);
+        free(job.samples);
+    }
+    return NULL;
+}
+
+int spectrogram_start(SpectrogramCallback on_written)
+{
+    if (SPECTROGRAM_DIRECTORY[0] == '\0')
+        return 0;
+
+    mkdir(SPECTROGRAM_DIRECTORY, 0700);
+    written_callback = on_written;
+
+    int threads = SPECTROGRAM_THREADS;
+    if (threads < 1)
+        threads = 1;
+    if (threads > SPECTROGRAM_MAX_THREADS)
+        threads = SPECTROGRAM_MAX_THREADS;
+
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, spectrogram_worker, NULL) != 0)
+        {
+            perror("Failed to create spectrogram thread");
+            break;
+        }
+        pthread_detach(thread);
+        worker_count++;
+    }
+
+    if (worker_count == 0)
+        return -1;
+    printf("Writing spectrograms to %s (%d thread(s))\n", SPECTROGRAM_DIRECTORY, worker_count);
+    return 0;
+}
+
+int spectrogram_enabled(void)
+{
+    return worker_count > 0;
+}
+
+void spectrogram_submit(const char *recording_path, short *samples, size_t count, int sample_rate)
+{
+    if (worker_count == 0)
+    {
+        free(samples);
+        return;
+    }
+
+    pthread_mutex_lock(&queue_lock);
+    if (queue_count == SPECTROGRAM_QUEUE_SIZE)
+    {
+        pthread_mutex_unlock(&queue_lock);
+        fprintf(stderr, "Spectrogram queue full, skipping %s\n", recording_path);
+        free(samples);
+        return;
+    }
+
+    SpectrogramJob *job = &queue[(queue_head + queue_count) % SPECTROGRAM_QUEUE_SIZE];
+    snprintf(job->recording_path, sizeof(job->recording_path), "%s", recording_path);
+    job->samples = samples;
+    job->count = count;
+    job->sample_rate = sample_rate;
+    queue_count++;
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+}
@@ -8,7 +8,11 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "h/config.h"
+#include "h/write_wav_file.h"
+#include "h/latency.h"
+#include "h/file_move.h"
 
 void get_current_datetime(char *datetime_str, size_t size)
 {
@@ -19,11 +23,49 @@ void get_current_datetime(char *datetime_str, size_t size)
 
 void escape_markdown_v2(char *dest, const char *src, size_t size);
 
-void extract_timestamp(const char *file_path, char *base_name, char *timestamp, size_t base_size, size_t time_size)
+// Each upload re-reads the sender settings from .env, which frees and
+// reallocates CHAT_IDS, while other upload workers may be sending to them. Senders hold this for reading;
+// a reload is skipped while any other sender is using the settings.
+static pthread_rwlock_t settings_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static void lock_settings(bool reload)
+{
+    if (reload && pthread_rwlock_trywrlock(&settings_lock) == 0)
+    {
+        load_telegram_env(".env");
+        pthread_rwlock_unlock(&settings_lock);
+    }
+    pthread_rwlock_rdlock(&settings_lock);
+}
+
+static void unlock_settings(void)
 {
-    const char *pattern = "(.+)_([0-9]{8}_[0-9]{6})\\.wav$";
+    pthread_rwlock_unlock(&settings_lock);
+}
+
+// Not thread-safe in older libcurl, so it runs once before any upload thread
+void telegram_init(void)
+{
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+}
+
+static const char *recording_extension(const char *file_path)
+{
+    const char *extension = strrchr(file_path, '.');
+    const char *slash = strrchr(file_path, '/');
+    if (!extension || (slash && extension < slash))
+        return ".wav";
+    return extension;
+}
+
+void extract_timestamp(const char *file_path, char *base_name, char *timestamp, size_t base_size, size_t time_size, int *part)
+{
+    // <name>_<YYYYMMDD_HHMMSS>[_<ms>][-<n>][_part<N>].<wav|opus|flac>; older names carry no milliseconds
+    const char *pattern = "(.+)_([0-9]{8}_[0-9]{6})(_[0-9]{3})?(-[0-9]+)?(_part([0-9]+))?\\.(wav|opus|flac)$";
     regex_t regex;
-    regmatch_t matches[3];
+    regmatch_t matches[8];
+
+    *part = 0;
 
     if (regcomp(&regex, pattern, REG_EXTENDED) != 0)
     {
@@ -31,19 +73,26 @@ void extract_timestamp(const char *file_path, char *base_name, char *timestamp,
         return;
     }
 
-    if (regexec(&regex, file_path, 3, matches, 0) == 0)
+    if (regexec(&regex, file_path, 8, matches, 0) == 0)
     {
+        if (matches[6].rm_so != -1)
+            *part = atoi(file_path + matches[6].rm_so);
+
         snprintf(base_name, base_size, "%.*s", (int)(matches[1].rm_eo - matches[1].rm_so), file_path + matches[1].rm_so);
         snprintf(timestamp, time_size, "%.*s", (int)(matches[2].rm_eo - matches[2].rm_so), file_path + matches[2].rm_so);
 
+        const char *millis = matches[3].rm_so != -1 ? file_path + matches[3].rm_so + 1 : NULL;
+
         char formatted_timestamp[32];
-        sprintf(formatted_timestamp, "%.4s-%.2s-%.2s %.2s:%.2s:%.2s",
-                timestamp,
-                timestamp + 4,
-                timestamp + 6,
-                timestamp + 9,
-                timestamp + 11,
-                timestamp + 13);
+        int len = sprintf(formatted_timestamp, "%.4s-%.2s-%.2s %.2s:%.2s:%.2s",
+                          timestamp,
+                          timestamp + 4,
+                          timestamp + 6,
+                          timestamp + 9,
+                          timestamp + 11,
+                          timestamp + 13);
+        if (millis)
+            sprintf(formatted_timestamp + len, ".%.3s", millis);
         strncpy(timestamp, formatted_timestamp, time_size);
     }
     else
@@ -56,46 +105,55 @@ void extract_timestamp(const char *file_path, char *base_name, char *timestamp,
     regfree(&regex);
 }
 
-// Internal unified sender handling retries and offline recovery logic
-static int send_to_telegram_internal(const char *file_path, const char *bot_token, char **chat_ids, bool is_offline)
+// Opus recordings go out as voice messages, everything else as audio files
+static int is_voice_file(const char *file_path)
 {
-    CURL *curl;
-    CURLcode res;
-    char url[256];
-    char base_name[256];
-    char timestamp[32];
+    const char *extension = strrchr(file_path, '.');
+    return extension && strcmp(extension, ".opus") == 0;
+}
 
-    // Backup the original path to easily recover timestamped filename if connection fails
-    char original_path[512];
-    strncpy(original_path, file_path, sizeof(original_path) - 1);
-    original_path[sizeof(original_path) - 1] = '\0';
+static void recording_caption(char *caption, size_t size, const char *timestamp, int part_number, bool is_offline)
+{
+    char escaped_caption[512];
+    escape_markdown_v2(escaped_caption, timestamp, sizeof(escaped_caption));
 
-    load_env(".env");
-    extract_timestamp(file_path, base_name, timestamp, sizeof(base_name), sizeof(timestamp));
+    char escaped_extra[256] = "";
+    if (EXTRA_TEXT[0] != '\0')
+        escape_markdown_v2(escaped_extra, EXTRA_TEXT, sizeof(escaped_extra));
 
-    char new_file_path[512];
-    if (strlen(base_name) >= 4 && strcmp(base_name + strlen(base_name) - 4, ".wav") == 0)
+    char offline_tag[64] = "";
+    if (is_offline)
     {
-        strncpy(new_file_path, base_name, sizeof(new_file_path));
-        new_file_path[sizeof(new_file_path) - 1] = '\0';
+        strcpy(offline_tag, "\n*OFFLINE FILES*");
     }
+
+    // Long transmissions arrive in several files while they are still going
+    char part_tag[32] = "";
+    if (part_number > 0)
+        snprintf(part_tag, sizeof(part_tag), " *PART %d*", part_number);
+
+    if (escaped_extra[0] != '\0')
+        snprintf(caption, size, "%s%s\n*COŚ SIĘ DZIEJE*\n%s%s", escaped_caption, part_tag, escaped_extra, offline_tag);
     else
-    {
-        snprintf(new_file_path, sizeof(new_file_path), "%s.wav", base_name);
-    }
+        snprintf(caption, size, "%s%s\n*COŚ SIĘ DZIEJE*%s", escaped_caption, part_tag, offline_tag);
+}
 
-    if (rename(file_path, new_file_path) != 0)
-    {
-        fprintf(stderr, "Failed to rename file from %s to %s: %s\n", file_path, new_file_path, strerror(errno));
-        return 0;
-    }
+// Posts one recording to every chat, with retries. upload_name, if set,
+// names the file for Telegram. Returns 1 once every chat has it.
+static int post_recording(const char *file_path, const char *upload_name, const char *caption, const char *latency_path, const char *bot_token, char **chat_ids)
+{
+    CURL *curl;
+    CURLcode res;
+    char url[256];
+
+    int voice = is_voice_file(file_path);
+    const char *method = voice ? "sendVoice" : "sendAudio";
+    const char *field = voice ? "voice" : "audio";
 
     int max_retries = 3;
-    int success = 0;
 
     for (int retry = 0; retry < max_retries; retry++)
     {
-        curl_global_init(CURL_GLOBAL_DEFAULT);
         curl = curl_easy_init();
         if (!curl)
         {
@@ -109,38 +167,21 @@ static int send_to_telegram_internal(const char *file_path, const char *bot_toke
             struct curl_mime *mime;
             struct curl_mimepart *part;
 
-            snprintf(url, sizeof(url), "https://api.telegram.org/bot%s/sendAudio", bot_token);
+            snprintf(url, sizeof(url), "https://api.telegram.org/bot%s/%s", bot_token, method);
             mime = curl_mime_init(curl);
 
             part = curl_mime_addpart(mime);
-            curl_mime_name(part, "audio");
-            curl_mime_filedata(part, new_file_path);
+            curl_mime_name(part, field);
+            curl_mime_filedata(part, file_path);
+            if (upload_name)
+                curl_mime_filename(part, upload_name);
 
             part = curl_mime_addpart(mime);
             curl_mime_name(part, "chat_id");
             curl_mime_data(part, chat_ids[i], CURL_ZERO_TERMINATED);
 
-            if (timestamp[0] != '\0')
+            if (caption[0] != '\0')
             {
-                char escaped_caption[512];
-                escape_markdown_v2(escaped_caption, timestamp, sizeof(escaped_caption));
-
-                char escaped_extra[256] = "";
-                if (EXTRA_TEXT[0] != '\0')
-                    escape_markdown_v2(escaped_extra, EXTRA_TEXT, sizeof(escaped_extra));
-
-                char caption[1024];
-                char offline_tag[64] = "";
-                if (is_offline)
-                {
-                    strcpy(offline_tag, "\n*OFFLINE FILES*");
-                }
-
-                if (escaped_extra[0] != '\0')
-                    snprintf(caption, sizeof(caption), "%s\n*COŚ SIĘ DZIEJE*\n%s%s", escaped_caption, escaped_extra, offline_tag);
-                else
-                    snprintf(caption, sizeof(caption), "%s\n*COŚ SIĘ DZIEJE*%s", escaped_caption, offline_tag);
-
                 part = curl_mime_addpart(mime);
                 curl_mime_name(part, "caption");
                 curl_mime_data(part, caption, CURL_ZERO_TERMINATED);
@@ -152,12 +193,13 @@ static int send_to_telegram_internal(const char *file_path, const char *bot_toke
 
             curl_easy_setopt(curl, CURLOPT_URL, url);
             curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
+            latency_upload_started(latency_path);
             res = curl_easy_perform(curl);
             curl_mime_free(mime);
 
             if (res != CURLE_OK)
             {
-                fprintf(stderr, "Failed to send audio %s to chat %s: %s (Attempt %d/%d)\n", new_file_path, chat_ids[i], curl_easy_strerror(res), retry + 1, max_retries);
+                fprintf(stderr, "Failed to send audio %s to chat %s: %s (Attempt %d/%d)\n", file_path, chat_ids[i], curl_easy_strerror(res), retry + 1, max_retries);
                 all_chats_done = 0;
                 break;
             }
@@ -166,70 +208,222 @@ static int send_to_telegram_internal(const char *file_path, const char *bot_toke
         curl_easy_cleanup(curl);
 
         if (all_chats_done)
-        {
-            success = 1;
-            break;
-        }
+            return 1;
         sleep(2); // Wait briefly before trying again
     }
+    return 0;
+}
 
-    if (success)
+// Recovery Logic: If transmission completely fails, put it into the offline fallback cache
+static void cache_offline(const char *file_path, const char *original_path)
+{
+    struct stat st = {0};
+    if (stat("./offline", &st) == -1)
     {
-        if (remove(new_file_path) != 0)
-        {
-            fprintf(stderr, "Failed to remove processed file %s: %s\n", new_file_path, strerror(errno));
-        }
-        return 1;
+        mkdir("./offline", 0700);
+    }
+
+    const char *filename_only = strrchr(original_path, '/');
+    if (filename_only)
+        filename_only++;
+    else
+        filename_only = original_path;
+
+    char offline_path[512], offline_part[520];
+    snprintf(offline_path, sizeof(offline_path), "./offline/%s", filename_only);
+    snprintf(offline_part, sizeof(offline_part), "%s" WAV_PART_SUFFIX, offline_path);
+
+    // RECORDING_DIRECTORY may be on another filesystem, e.g. a RAM disk, and
+    // the offline sync must not pick up a half-copied file. Compressing the
+    // backlog is left to the offline sync too, off the thread that got here.
+    FileMoveStats move;
+    if (file_move(file_path, offline_part, MOVE_FSYNC, &move) == 0 && rename(offline_part, offline_path) == 0)
+    {
+        printf("[OFFLINE] Connection down. Recovered and saved to cache: %s\n", offline_path);
     }
     else
     {
-        // Recovery Logic: If transmission completely fails, put it into the offline fallback cache
-        if (!is_offline)
-        {
-            struct stat st = {0};
-            if (stat("./offline", &st) == -1)
-            {
-                mkdir("./offline", 0700);
-            }
+        fprintf(stderr, "Failed to move file to offline folder: %s\n", offline_path);
+    }
+}
 
-            const char *filename_only = strrchr(original_path, '/');
-            if (filename_only)
-                filename_only++;
-            else
-                filename_only = original_path;
+// Internal unified sender handling retries and offline recovery logic
+static int send_to_telegram_internal(const char *file_path, const char *bot_token, char **chat_ids, bool is_offline)
+{
+    char base_name[256];
+    char timestamp[32];
 
-            char offline_path[512];
-            snprintf(offline_path, sizeof(offline_path), "./offline/%s", filename_only);
+    int part_number;
+    extract_timestamp(file_path, base_name, timestamp, sizeof(base_name), sizeof(timestamp), &part_number);
 
-            if (rename(new_file_path, offline_path) == 0)
-            {
-                printf("[OFFLINE] Connection down. Recovered and saved to cache: %s\n", offline_path);
-            }
-            else
-            {
-                fprintf(stderr, "Failed to move file to offline folder: %s\n", strerror(errno));
-            }
-        }
-        else
+    const char *extension = recording_extension(file_path);
+
+    // Telegram shows the name without its timestamp, which goes in the
+    // caption instead. The file itself keeps its name: uploads run in
+    // parallel, and two recordings of one radio would share the short name.
+    char upload_name[512];
+    const char *short_name = strrchr(base_name, '/');
+    short_name = short_name ? short_name + 1 : base_name;
+    size_t short_len = strlen(short_name);
+    if (short_len >= strlen(extension) && strcmp(short_name + short_len - strlen(extension), extension) == 0)
+        snprintf(upload_name, sizeof(upload_name), "%s", short_name);
+    else
+        snprintf(upload_name, sizeof(upload_name), "%s%s", short_name, extension);
+
+    char caption[1024] = "";
+    if (timestamp[0] != '\0')
+        recording_caption(caption, sizeof(caption), timestamp, part_number, is_offline);
+
+    if (post_recording(file_path, upload_name, caption, file_path, bot_token, chat_ids))
+    {
+        if (remove(file_path) != 0)
         {
-            // Already an offline file; rename it back to its original timestamped state to try later
-            if (rename(new_file_path, original_path) != 0)
-            {
-                fprintf(stderr, "Failed to restore offline file name: %s\n", strerror(errno));
-            }
+            fprintf(stderr, "Failed to remove processed file %s: %s\n", file_path, strerror(errno));
         }
-        return 0;
+        return 1;
     }
+
+    // An offline file just stays where it is to be tried again later
+    if (!is_offline)
+        cache_offline(file_path, file_path);
+    return 0;
 }
 
 int send_to_telegram(const char *file_path, const char *bot_token, char **chat_ids)
 {
-    return send_to_telegram_internal(file_path, bot_token, chat_ids, false);
+    lock_settings(true);
+    int success = send_to_telegram_internal(file_path, bot_token, chat_ids, false);
+    unlock_settings();
+    return success;
 }
 
 int send_offline_to_telegram(const char *file_path, const char *bot_token, char **chat_ids)
 {
-    return send_to_telegram_internal(file_path, bot_token, chat_ids, true);
+    lock_settings(true);
+    int success = send_to_telegram_internal(file_path, bot_token, chat_ids, true);
+    unlock_settings();
+    return success;
+}
+
+void cache_offline_recording(const char *file_path, const char *name_path)
+{
+    cache_offline(file_path, name_path);
+}
+
+// Recordings handed over by the recorder come with their metadata, so the
+// caption and the name Telegram shows are built from it and the file is sent
+// from where it was published, without a copy or rename
+int send_recording_to_telegram(const char *file_path, const RecordingInfo *info, const char *bot_token, char **chat_ids)
+{
+    lock_settings(true);
+
+    struct tm tm_info;
+    localtime_r(&info->start.tv_sec, &tm_info);
+    char timestamp[32];
+    size_t len = strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &tm_info);
+    snprintf(timestamp + len, sizeof(timestamp) - len, ".%03ld", info->start.tv_nsec / 1000000);
+
+    char caption[1024];
+    recording_caption(caption, sizeof(caption), timestamp, info->part, false);
+
+    const char *extension = recording_extension(file_path);
+
+    char upload_name[384];
+    if (info->prefix[0] != '\0')
+        snprintf(upload_name, sizeof(upload_name), "%s_%s%s", info->prefix, info->radio, extension);
+    else
+        snprintf(upload_name, sizeof(upload_name), "%s%s", info->radio, extension);
+
+    int success = post_recording(file_path, upload_name, caption, file_path, bot_token, chat_ids);
+
+    if (success)
+    {
+        if (remove(file_path) != 0)
+            fprintf(stderr, "Failed to remove processed file %s: %s\n", file_path, strerror(errno));
+    }
+    else
+    {
+        cache_offline(file_path, file_path);
+    }
+    unlock_settings();
+    return success;
+}
+
+// Sends a picture that belongs to a recording, captioned like the recording.
+// One attempt per chat: the audio has already gone out on its own.
+static int post_photo(const char *photo_path, const char *recording_path, const char *bot_token, char **chat_ids)
+{
+    char base_name[256];
+    char timestamp[32];
+    int part_number;
+    extract_timestamp(recording_path, base_name, timestamp, sizeof(base_name), sizeof(timestamp), &part_number);
+
+    char caption[256] = "";
+    if (timestamp[0] != '\0')
+    {
+        char escaped_caption[128];
+        escape_markdown_v2(escaped_caption, timestamp, sizeof(escaped_caption));
+        char part_tag[32] = "";
+        if (part_number > 0)
+            snprintf(part_tag, sizeof(part_tag), " *PART %d*", part_number);
+        snprintf(caption, sizeof(caption), "%s%s\n*SPEKTROGRAM*", escaped_caption, part_tag);
+    }
+
+    char url[256];
+    snprintf(url, sizeof(url), "https://api.telegram.org/bot%s/sendPhoto", bot_token);
+
+    CURL *curl = curl_easy_init();
+    if (!curl)
+        return 0;
+
+    int success = 1;
+    for (int i = 0; chat_ids[i] != NULL; i++)
+    {
+        struct curl_mime *mime = curl_mime_init(curl);
+        struct curl_mimepart *part;
+
+        part = curl_mime_addpart(mime);
+        curl_mime_name(part, "photo");
+        curl_mime_filedata(part, photo_path);
+
+        part = curl_mime_addpart(mime);
+        curl_mime_name(part, "chat_id");
+        curl_mime_data(part, chat_ids[i], CURL_ZERO_TERMINATED);
+
+        if (caption[0] != '\0')
+        {
+            part = curl_mime_addpart(mime);
+            curl_mime_name(part, "caption");
+            curl_mime_data(part, caption, CURL_ZERO_TERMINATED);
+
+            part = curl_mime_addpart(mime);
+            curl_mime_name(part, "parse_mode");
+            curl_mime_data(part, "MarkdownV2", CURL_ZERO_TERMINATED);
+        }
+
+        curl_easy_setopt(curl, CURLOPT_URL, url);
+        curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
+        CURLcode res = curl_easy_perform(curl);
+        curl_mime_free(mime);
+
+        if (res != CURLE_OK)
+        {
+            fprintf(stderr, "Failed to send spectrogram %s to chat %s: %s\n", photo_path, chat_ids[i], curl_easy_strerror(res));
+            success = 0;
+            break;
+        }
+    }
+
+    curl_easy_cleanup(curl);
+    return success;
+}
+
+int send_telegram_photo(const char *photo_path, const char *recording_path, const char *bot_token, char **chat_ids)
+{
+    lock_settings(false);
+    int success = post_photo(photo_path, recording_path, bot_token, chat_ids);
+    unlock_settings();
+    return success;
 }
 
 void escape_markdown_v2(char *dest, const char *src, size_t size)
@@ -256,7 +450,7 @@ void escape_markdown_v2(char *dest, const char *src, size_t size)
     dest[j] = '\0';
 }
 
-int send_telegram_status(const char *bot_token, char **chat_ids, const char *message)
+static int post_status(const char *bot_token, char **chat_ids, const char *message)
 {
     CURL *curl;
     CURLcode res;
@@ -264,8 +458,6 @@ int send_telegram_status(const char *bot_token, char **chat_ids, const char *mes
     char url[256];
     char message_escaped[1024];
 
-    load_env(".env");
-
     char full_message[1280];
     if (EXTRA_TEXT[0] != '\0')
     {
@@ -287,7 +479,6 @@ int send_telegram_status(const char *bot_token, char **chat_ids, const char *mes
 
     snprintf(url, sizeof(url), "https://api.telegram.org/bot%s/sendMessage", bot_token);
 
-    curl_global_init(CURL_GLOBAL_DEFAULT);
     curl = curl_easy_init();
     if (!curl)
     {
@@ -320,4 +511,12 @@ int send_telegram_status(const char *bot_token, char **chat_ids, const char *mes
     curl_easy_cleanup(curl);
     curl_slist_free_all(headers);
     return 1;
-}
\ No newline at end of file
+}
+
+int send_telegram_status(const char *bot_token, char **chat_ids, const char *message)
+{
+    lock_settings(true);
+    int success = post_status(bot_token, chat_ids, message);
+    unlock_settings();
+    return success;
+}
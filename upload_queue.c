@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "h/upload_queue.h"
+#include "h/latency.h"
+#include "h/profiler.h"
+
+typedef struct
+{
+    UploadJob job;
+    // Keeps jobs of equal priority first in, first out
+    unsigned long sequence;
+    uint64_t queued_ticks;
+} QueuedUpload;
+
+// Binary min-heap on (priority, sequence)
+static QueuedUpload queue[UPLOAD_QUEUE_SIZE];
+static size_t queue_count;
+static size_t queue_high_water;
+static unsigned long next_sequence;
+// File name each worker is uploading, empty when idle
+static char in_flight[UPLOAD_MAX_WORKERS][UPLOAD_PATH_MAX];
+static int busy_workers;
+static int worker_count;
+static unsigned long uploads_done;
+static unsigned long uploads_overflowed;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+static UploadHandler upload_handler;
+static UploadOverflowHandler overflow_handler;
+
+static const char *file_name(const char *path)
+{
+    const char *name = strrchr(path, '/');
+    return name ? name + 1 : path;
+}
+
+static int runs_before(const QueuedUpload *a, const QueuedUpload *b)
+{
+    if (a->job.priority != b->job.priority)
+        return a->job.priority < b->job.priority;
+    return a->sequence < b->sequence;
+}
+
+static void swap_jobs(size_t a, size_t b)
+{
+    QueuedUpload swap = queue[a];
+    queue[a] = queue[b];
+    queue[b] = swap;
+}
+
+// Called with the lock held and room in the queue
+static void push_job(const UploadJob *job)
+{
+    size_t i = queue_count++;
+    queue[i].job = *job;
+    queue[i].sequence = next_sequence++;
+    queue[i].queued_ticks = profiler_ticks();
+    while (i > 0 && runs_before(&queue[i], &queue[(i - 1) / 2]))
+    {
+        swap_jobs(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+
+    if (queue_count > queue_high_water)
+        queue_high_water = queue_count;
+    pthread_cond_signal(&queue_ready);
+}
+
+// Called with the lock held and at least one job queued
+static QueuedUpload pop_job(void)
+{
+    QueuedUpload next = queue[0];
+    queue[0] = queue[--queue_count];
+    size_t i = 0;
+    while (1)
+    {
+        size_t first = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < queue_count && runs_before(&queue[left], &queue[first]))
+            first = left;
+        if (right < queue_count && runs_before(&queue[right], &queue[first]))
+            first = right;
+        if (first == i)
+            break;
+        swap_jobs(i, first);
+        i = first;
+    }
+    return next;
+}
+
+static void *upload_worker(void *arg)
+{
+    char *current = arg;
+    while (1)
+    {
+        pthread_mutex_lock(&queue_lock);
+        while (queue_count == 0)
+            pthread_cond_wait(&queue_ready, &queue_lock);
+        QueuedUpload next = pop_job();
+        snprintf(current, sizeof(in_flight[0]), "%s", file_name(next.job.path));
+        busy_workers++;
+        pthread_mutex_unlock(&queue_lock);
+
+        profiler_record(PROFILE_QUEUE, next.queued_ticks, 0);
+        upload_handler(&next.job);
+
+        pthread_mutex_lock(&queue_lock);
+        current[0] = '\0';
+        busy_workers--;
+        uploads_done++;
+        pthread_mutex_unlock(&queue_lock);
+    }
+    return NULL;
+}
+
+int upload_queue_start(int workers, UploadHandler handler, UploadOverflowHandler overflow)
+{
+    upload_handler = handler;
+    overflow_handler = overflow;
+    if (workers < 1)
+        workers = 1;
+    if (workers > UPLOAD_MAX_WORKERS)
+        workers = UPLOAD_MAX_WORKERS;
+
+    pthread_mutex_lock(&queue_lock);
+    for (int i = 0; i < workers; i++)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, upload_worker, in_flight[i]) != 0)
+        {
+            perror("Failed to create upload worker");
+            break;
+        }
+        pthread_detach(thread);
+        worker_count++;
+    }
+    int started = worker_count;
+    pthread_mutex_unlock(&queue_lock);
+
+    if (started == 0)
+    {
+        fprintf(stderr, "No upload workers, leaving uploads to the directory watcher\n");
+        return -1;
+    }
+    printf("Upload workers: %d | Queue: %d\n", started, UPLOAD_QUEUE_SIZE);
+    return 0;
+}
+
+int upload_queue_publish(const char *part_path, const char *final_path, const RecordingInfo *info)
+{
+    // The rename happens under the lock, so the watcher either finds the
+    // job already queued or no file yet. A recording with no room left is
+    // never renamed into place, so the watcher does not see it at all.
+    // A job never carries a cut-off name
+    if (info && strlen(final_path) >= UPLOAD_PATH_MAX)
+    {
+        fprintf(stderr, "Upload path too long to queue, leaving %s to the watcher\n", final_path);
+        info = NULL;
+    }
+
+    pthread_mutex_lock(&queue_lock);
+    int overflow = info && worker_count > 0 && queue_count == UPLOAD_QUEUE_SIZE;
+    if (!overflow && rename(part_path, final_path) != 0)
+    {
+        pthread_mutex_unlock(&queue_lock);
+        fprintf(stderr, "Error: Could not rename %s to %s\n", part_path, final_path);
+        return -1;
+    }
+    if (!info)
+    {
+        pthread_mutex_unlock(&queue_lock);
+        return 0;
+    }
+
+    latency_published(final_path);
+    if (overflow)
+    {
+        uploads_overflowed++;
+    }
+    else if (worker_count > 0)
+    {
+        UploadJob job = {.priority = UPLOAD_PRIORITY_LIVE, .has_info = 1, .info = *info};
+        snprintf(job.path, sizeof(job.path), "%s", final_path);
+        push_job(&job);
+    }
+    pthread_mutex_unlock(&queue_lock);
+
+    if (overflow)
+    {
+        fprintf(stderr, "Upload queue full, caching %s offline\n", final_path);
+        overflow_handler(part_path, final_path);
+    }
+    return 0;
+}
+
+int upload_queue_submit(const char *path, UploadPriority priority)
+{
+    if (strlen(path) >= UPLOAD_PATH_MAX)
+    {
+        fprintf(stderr, "Upload path too long to queue: %s\n", path);
+        return -1;
+    }
+
+    pthread_mutex_lock(&queue_lock);
+    if (worker_count == 0)
+    {
+        pthread_mutex_unlock(&queue_lock);
+        return -1;
+    }
+    if (queue_count == UPLOAD_QUEUE_SIZE)
+    {
+        uploads_overflowed++;
+        pthread_mutex_unlock(&queue_lock);
+        fprintf(stderr, "Upload queue full, caching %s offline\n", path);
+        overflow_handler(path, path);
+        return 1;
+    }
+
+    UploadJob job = {.priority = priority};
+    snprintf(job.path, sizeof(job.path), "%s", path);
+    push_job(&job);
+    pthread_mutex_unlock(&queue_lock);
+    return 0;
+}
+
+int upload_queue_owns(const char *path)
+{
+    const char *name = file_name(path);
+    pthread_mutex_lock(&queue_lock);
+    int owned = 0;
+    for (int i = 0; i < worker_count && !owned; i++)
+        owned = strcmp(in_flight[i], name) == 0;
+    for (size_t i = 0; i < queue_count && !owned; i++)
+        owned = strcmp(file_name(queue[i].job.path), name) == 0;
+    pthread_mutex_unlock(&queue_lock);
+    return owned;
+}
+
+void upload_queue_poll(int force)
+{
+    if (!force)
+        return;
+
+    pthread_mutex_lock(&queue_lock);
+    size_t queued = queue_count;
+    size_t high_water = queue_high_water;
+    int busy = busy_workers;
+    int workers = worker_count;
+    unsigned long done = uploads_done;
+    unsigned long overflowed = uploads_overflowed;
+    queue_high_water = queue_count;
+    pthread_mutex_unlock(&queue_lock);
+
+    if (workers == 0 || (done == 0 && overflowed == 0 && high_water == 0 && busy == 0))
+        return;
+
+    // Time spent queued is in the [PROFILE] line for the queue stage
+    printf("[UPLOAD] Queued: %zu/%d | High water: %zu | In flight: %d/%d | Done: %lu | Sent offline when full: %lu\n",
+           queued,
+           UPLOAD_QUEUE_SIZE,
+           high_water,
+           busy,
+           workers,
+           done,
+           overflowed);
+}
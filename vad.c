@@ -0,0 +1,231 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <time.h>
+#include "h/vad.h"
+
+#define FULL_SCALE_DB 90.309
+#define NOISE_FLOOR_INITIAL_DB -60.0
+#define NOISE_FLOOR_MIN_DB -80.0
+#define NOISE_FLOOR_FALL_SECONDS 0.5
+#define NOISE_FLOOR_RISE_SECONDS 10.0
+#define FLATNESS_HYSTERESIS 0.1
+#define FLATNESS_LOW_HZ 300
+#define FLATNESS_HIGH_HZ 3400
+#define FLATNESS_SMOOTHING 0.3f
+
+// Legacy trigger: any sample above AMPLITUDE_THRESHOLD
+static int peak_process(VoiceDetector *vad, const short *samples, size_t count, const BlockStats *stats)
+{
+    return stats->peak > vad->config.amplitude_threshold;
+}
+
+static int rms_init(VoiceDetector *vad)
+{
+    vad->noise_floor_db = NOISE_FLOOR_INITIAL_DB;
+    return 0;
+}
+
+// Opens when the block level clears the noise floor by open_db (and the peak
+// clears AMPLITUDE_THRESHOLD as an absolute minimum), closes once it drops
+// below floor + close_db. The floor only adapts while the detector is closed:
+// quickly downwards, slowly upwards.
+static int rms_process(VoiceDetector *vad, const short *samples, size_t count, const BlockStats *stats)
+{
+    if (count == 0)
+        return vad->active;
+
+    double mean_square = (double)stats->sum_squares / count;
+    vad->level_db = 10.0 * log10(mean_square + 1.0) - FULL_SCALE_DB;
+
+    if (vad->active)
+    {
+        if (vad->level_db < vad->noise_floor_db + vad->config.close_db)
+            vad->active = 0;
+    }
+    else if (vad->level_db > vad->noise_floor_db + vad->config.open_db &&
+             stats->peak > vad->config.amplitude_threshold)
+    {
+        vad->active = 1;
+    }
+
+    if (!vad->active)
+    {
+        double seconds = (double)count / vad->config.sample_rate;
+        double tau = vad->level_db < vad->noise_floor_db ? NOISE_FLOOR_FALL_SECONDS : NOISE_FLOOR_RISE_SECONDS;
+        double alpha = seconds / (tau + seconds);
+        vad->noise_floor_db += alpha * (vad->level_db - vad->noise_floor_db);
+        if (vad->noise_floor_db < NOISE_FLOOR_MIN_DB)
+            vad->noise_floor_db = NOISE_FLOOR_MIN_DB;
+    }
+
+    return vad->active;
+}
+
+static void flatness_destroy(VoiceDetector *vad)
+{
+    fft_plan_free(&vad->fft);
+    free(vad->window);
+    free(vad->frame);
+    free(vad->power);
+    free(vad->smoothed);
+    vad->window = vad->frame = vad->power = vad->smoothed = NULL;
+}
+
+static int flatness_init(VoiceDetector *vad)
+{
+    rms_init(vad);
+    vad->flatness = 1.0;
+
+    vad->window = malloc(VAD_FFT_SIZE * sizeof(float));
+    vad->frame = malloc(VAD_FFT_SIZE * sizeof(float));
+    vad->power = malloc((VAD_FFT_SIZE / 2 + 1) * sizeof(float));
+    vad->smoothed = calloc(VAD_FFT_SIZE / 2 + 1, sizeof(float));
+    if (!vad->window || !vad->frame || !vad->power || !vad->smoothed || fft_plan_init(&vad->fft, VAD_FFT_SIZE) != 0)
+    {
+        flatness_destroy(vad);
+        return -1;
+    }
+
+    fft_hann_window(vad->window, VAD_FFT_SIZE);
+    return 0;
+}
+
+// Ratio of geometric to arithmetic mean of the power spectrum over the voice
+// band: near 1 for hiss and static crashes, well below 1 for voiced speech.
+// The spectrum is averaged over a few frames, since the flatness of a single
+// noise periodogram scatters around 0.56 rather than 1.
+static double spectral_flatness(VoiceDetector *vad)
+{
+    fft_real_power(&vad->fft, vad->frame, vad->power);
+    for (size_t k = 0; k <= VAD_FFT_SIZE / 2; k++)
+        vad->smoothed[k] += FLATNESS_SMOOTHING * (vad->power[k] - vad->smoothed[k]);
+
+    size_t low = (size_t)FLATNESS_LOW_HZ * VAD_FFT_SIZE / vad->config.sample_rate;
+    size_t high = (size_t)FLATNESS_HIGH_HZ * VAD_FFT_SIZE / vad->config.sample_rate;
+    if (high > VAD_FFT_SIZE / 2)
+        high = VAD_FFT_SIZE / 2;
+    if (low < 1)
+        low = 1;
+    if (high <= low)
+        return 1.0;
+
+    double log_sum = 0, sum = 0;
+    for (size_t k = low; k <= high; k++)
+    {
+        double p = vad->smoothed[k] + 1e-3;
+        log_sum += log(p);
+        sum += p;
+    }
+
+    size_t bins = high - low + 1;
+    return exp(log_sum / bins) / (sum / bins);
+}
+
+static int flatness_process(VoiceDetector *vad, const short *samples, size_t count, const BlockStats *stats)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        vad->frame[vad->frame_fill] = samples[i] * vad->window[vad->frame_fill];
+        if (++vad->frame_fill == VAD_FFT_SIZE)
+        {
+            vad->flatness = spectral_flatness(vad);
+            vad->frame_fill = 0;
+        }
+    }
+
+    // Energy gating and hysteresis come from the RMS detector; the spectral
+    // test then rejects energetic blocks that do not look like speech.
+    int was_active = vad->active;
+    int energetic = rms_process(vad, samples, count, stats);
+    double limit = vad->config.max_flatness + (was_active ? FLATNESS_HYSTERESIS : 0.0);
+
+    vad->active = energetic && vad->flatness <= limit;
+    return vad->active;
+}
+
+static const VadBackend backends[] = {
+    {"peak", NULL, peak_process, NULL},
+    {"rms", rms_init, rms_process, NULL},
+    {"flatness", flatness_init, flatness_process, flatness_destroy},
+};
+
+int vad_backend_count(void)
+{
+    return (int)(sizeof(backends) / sizeof(backends[0]));
+}
+
+const VadBackend *vad_backend_at(int index)
+{
+    return index >= 0 && index < vad_backend_count() ? &backends[index] : NULL;
+}
+
+const VadBackend *vad_find_backend(const char *name)
+{
+    for (int i = 0; i < vad_backend_count(); i++)
+    {
+        if (strcasecmp(backends[i].name, name) == 0)
+            return &backends[i];
+    }
+    return NULL;
+}
+
+int vad_init(VoiceDetector *vad, const VadBackend *backend, const VadConfig *config)
+{
+    memset(vad, 0, sizeof(*vad));
+    vad->backend = backend;
+    vad->config = *config;
+    return backend->init ? backend->init(vad) : 0;
+}
+
+void vad_destroy(VoiceDetector *vad)
+{
+    if (vad->backend && vad->backend->destroy)
+        vad->backend->destroy(vad);
+    vad->backend = NULL;
+}
+
+int vad_process(VoiceDetector *vad, const short *samples, size_t count, const BlockStats *stats)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int voice = vad->backend->process(vad, samples, count, stats);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    vad->cpu_ns += (uint64_t)((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec));
+    vad->frames += count;
+
+    if (voice)
+    {
+        if (!vad->in_session)
+        {
+            vad->in_session = 1;
+            vad->session_voiced = 0;
+            vad->triggers++;
+        }
+        vad->session_voiced += count;
+        vad->session_silence = 0;
+    }
+    else if (vad->in_session)
+    {
+        vad->session_silence += count;
+        if (vad->session_silence > vad->config.hang_frames)
+        {
+            if (vad->session_voiced < vad->config.min_voice_frames)
+                vad->false_triggers++;
+            vad->in_session = 0;
+        }
+    }
+
+    return voice;
+}
+
+// Detector CPU time as a percentage of the audio time it has processed
+double vad_cpu_percent(const VoiceDetector *vad)
+{
+    if (vad->frames == 0)
+        return 0.0;
+    double audio_ns = (double)vad->frames * 1e9 / vad->config.sample_rate;
+    return 100.0 * vad->cpu_ns / audio_ns;
+}
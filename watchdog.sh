@@ -33,10 +33,14 @@ fi
 
 cd "$WORKDIR" || { echo "Failed to cd to $WORKDIR"; exit 1; }
 
+SOURCES="main.c open_serial_port.c recordAudio.c telegramSend.c config.c write_wav_file.c \
+    ring_buffer.c block_pool.c audio_stats.c preroll.c sample_clock.c fft.c vad.c resampler.c encoder.c wav_codec.c flac.c latency.c monitor.c dsp.c spectrogram.c profiler.c replay.c journal.c upload_queue.c file_move.c"
+CFLAGS="-I/usr/include/opus"
+LIBS="-lportaudio -lm -lserialport -lpthread -lcurl -lasound -ljack -lopusenc -lopus"
+
 # === Compile the recorder program ===
 echo "Compiling recorder..."
-if ! gcc -o recorder main.c open_serial_port.c recordAudio.c telegramSend.c config.c write_wav_file.c \
-    -lportaudio -lm -lserialport -lpthread -lcurl -luv -lasound -ljack; then
+if ! gcc $CFLAGS -o recorder $SOURCES $LIBS; then
     echo "Compilation failed."
     exit 1
 fi
@@ -69,8 +73,7 @@ while true; do
         fi
 
         echo "Recompiling recorder after git pull..."
-        if ! gcc -o recorder main.c open_serial_port.c recordAudio.c telegramSend.c config.c write_wav_file.c \
-            -lportaudio -lm -lserialport -lpthread -lcurl -luv -lasound -ljack; then
+        if ! gcc $CFLAGS -o recorder $SOURCES $LIBS; then
             echo "Compilation failed after pull."
             exit 1
         fi
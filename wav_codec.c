@@ -0,0 +1,154 @@
+#include <string.h>
+#include "h/wav_codec.h"
+
+#define MULAW_BIAS 0x84
+#define MULAW_CLIP 32635
+
+static const int ima_index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8};
+
+static const int ima_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767};
+
+// The segment number is the position of the top bit above bit 7, which a
+// count-leading-zeros gives directly instead of a search loop
+static inline uint8_t mulaw_encode_sample(int pcm)
+{
+    int mask = 0xFF;
+    if (pcm < 0)
+    {
+        pcm = -pcm;
+        mask = 0x7F;
+    }
+    if (pcm > MULAW_CLIP)
+        pcm = MULAW_CLIP;
+    pcm += MULAW_BIAS;
+
+    int segment = 31 - __builtin_clz((unsigned)pcm | 0xFF) - 7;
+    int mantissa = (pcm >> (segment + 3)) & 0x0F;
+    return (uint8_t)(((segment << 4) | mantissa) ^ mask);
+}
+
+void mulaw_encode(const short *samples, size_t count, uint8_t *out)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = mulaw_encode_sample(samples[i]);
+}
+
+void mulaw_decode(const uint8_t *in, size_t count, short *samples)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        int u = ~in[i] & 0xFF;
+        int t = (((u & 0x0F) << 3) + MULAW_BIAS) << ((u & 0x70) >> 4);
+        samples[i] = (short)((u & 0x80) ? (MULAW_BIAS - t) : (t - MULAW_BIAS));
+    }
+}
+
+size_t ima_adpcm_samples_per_block(size_t block_align)
+{
+    return (block_align - 4) * 2 + 1;
+}
+
+static inline int ima_encode_sample(int sample, int *predictor, int *step_index)
+{
+    int step = ima_step_table[*step_index];
+    int diff = sample - *predictor;
+    int nibble = 0;
+    if (diff < 0)
+    {
+        nibble = 8;
+        diff = -diff;
+    }
+
+    // Quantise and reconstruct exactly as the decoder will
+    int delta = step >> 3;
+    if (diff >= step)
+    {
+        nibble |= 4;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step)
+    {
+        nibble |= 2;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step)
+    {
+        nibble |= 1;
+        delta += step;
+    }
+
+    int value = *predictor + ((nibble & 8) ? -delta : delta);
+    *predictor = value > 32767 ? 32767 : value < -32768 ? -32768 : value;
+
+    int index = *step_index + ima_index_table[nibble];
+    *step_index = index < 0 ? 0 : index > 88 ? 88 : index;
+    return nibble;
+}
+
+static inline int ima_decode_sample(int nibble, int *predictor, int *step_index)
+{
+    int step = ima_step_table[*step_index];
+    int delta = step >> 3;
+    if (nibble & 4)
+        delta += step;
+    if (nibble & 2)
+        delta += step >> 1;
+    if (nibble & 1)
+        delta += step >> 2;
+
+    int value = *predictor + ((nibble & 8) ? -delta : delta);
+    *predictor = value > 32767 ? 32767 : value < -32768 ? -32768 : value;
+
+    int index = *step_index + ima_index_table[nibble];
+    *step_index = index < 0 ? 0 : index > 88 ? 88 : index;
+    return *predictor;
+}
+
+void ima_adpcm_encode_block(ImaAdpcmState *state, const short *samples, size_t samples_per_block, uint8_t *out)
+{
+    int predictor = samples[0];
+    int step_index = state->step_index;
+
+    out[0] = (uint8_t)(predictor & 0xFF);
+    out[1] = (uint8_t)((predictor >> 8) & 0xFF);
+    out[2] = (uint8_t)step_index;
+    out[3] = 0;
+    out += 4;
+
+    for (size_t i = 1; i + 1 < samples_per_block; i += 2)
+    {
+        int low = ima_encode_sample(samples[i], &predictor, &step_index);
+        int high = ima_encode_sample(samples[i + 1], &predictor, &step_index);
+        *out++ = (uint8_t)(low | (high << 4));
+    }
+
+    state->step_index = step_index;
+}
+
+void ima_adpcm_decode_block(const uint8_t *in, size_t samples_per_block, short *samples)
+{
+    int predictor = (short)(in[0] | (in[1] << 8));
+    int step_index = in[2] > 88 ? 88 : in[2];
+    in += 4;
+
+    samples[0] = (short)predictor;
+    for (size_t i = 1; i + 1 < samples_per_block; i += 2)
+    {
+        uint8_t byte = *in++;
+        samples[i] = (short)ima_decode_sample(byte & 0x0F, &predictor, &step_index);
+        samples[i + 1] = (short)ima_decode_sample(byte >> 4, &predictor, &step_index);
+    }
+}
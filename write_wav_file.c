@@ -2,24 +2,218 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <unistd.h>
 #include "h/open_serial_port.h"
+#include "h/write_wav_file.h"
 
+#define WAV_MAX_HEADER 64
+
+// What the header of a file says, plus where its sample data starts
 typedef struct
 {
-    char chunkID[4];
-    uint32_t chunkSize;
-    char format[4];
-    char subchunk1ID[4];
-    uint32_t subchunk1Size;
-    uint16_t audioFormat;
-    uint16_t numChannels;
-    uint32_t sampleRate;
-    uint32_t byteRate;
-    uint16_t blockAlign;
-    uint16_t bitsPerSample;
-    char subchunk2ID[4];
-    uint32_t subchunk2Size;
-} WAVHeader;
+    int format;
+    int sample_rate;
+    int bits_per_sample;
+    size_t block_align;
+    size_t samples_per_block;
+    size_t frames;
+    long data_offset;
+    size_t data_bytes;
+    long fact_offset;
+} WavInfo;
+
+static void put_u16(uint8_t *p, unsigned v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static unsigned get_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Block size of an IMA ADPCM file, scaled with the rate like other encoders do
+static size_t adpcm_block_align(int sampleRate)
+{
+    if (sampleRate <= 11025)
+        return 256;
+    if (sampleRate <= 22050)
+        return 512;
+    return 1024;
+}
+
+static void describe_encoding(WavEncoding encoding, int sampleRate, WavInfo *info)
+{
+    memset(info, 0, sizeof(*info));
+    info->sample_rate = sampleRate;
+    switch (encoding)
+    {
+    case WAV_ENCODING_MULAW:
+        info->format = WAVE_FORMAT_MULAW;
+        info->bits_per_sample = 8;
+        info->block_align = 1;
+        info->samples_per_block = 1;
+        break;
+    case WAV_ENCODING_IMA_ADPCM:
+        info->format = WAVE_FORMAT_IMA_ADPCM;
+        info->bits_per_sample = 4;
+        info->block_align = adpcm_block_align(sampleRate);
+        info->samples_per_block = ima_adpcm_samples_per_block(info->block_align);
+        break;
+    default:
+        info->format = WAVE_FORMAT_PCM;
+        info->bits_per_sample = 16;
+        info->block_align = 2;
+        info->samples_per_block = 1;
+        break;
+    }
+}
+
+// PCM keeps the canonical 44-byte header. The compressed formats need the
+// extended fmt chunk and a fact chunk holding the real sample count.
+static size_t build_header(uint8_t *header, const WavInfo *info, size_t frames, size_t data_bytes)
+{
+    size_t fmt_size = info->format == WAVE_FORMAT_PCM ? 16 : info->format == WAVE_FORMAT_MULAW ? 18 : 20;
+    int has_fact = info->format != WAVE_FORMAT_PCM;
+    size_t header_size = 12 + 8 + fmt_size + (has_fact ? 12 : 0) + 8;
+
+    uint32_t byte_rate = info->format == WAVE_FORMAT_IMA_ADPCM
+                             ? (uint32_t)((uint64_t)info->sample_rate * info->block_align / info->samples_per_block)
+                             : (uint32_t)(info->sample_rate * info->block_align);
+
+    uint8_t *p = header;
+    memcpy(p, "RIFF", 4);
+    put_u32(p + 4, (uint32_t)(header_size - 8 + data_bytes));
+    memcpy(p + 8, "WAVE", 4);
+    p += 12;
+
+    memcpy(p, "fmt ", 4);
+    put_u32(p + 4, (uint32_t)fmt_size);
+    put_u16(p + 8, info->format);
+    put_u16(p + 10, 1);
+    put_u32(p + 12, (uint32_t)info->sample_rate);
+    put_u32(p + 16, byte_rate);
+    put_u16(p + 20, (unsigned)info->block_align);
+    put_u16(p + 22, (unsigned)info->bits_per_sample);
+    if (info->format == WAVE_FORMAT_MULAW)
+        put_u16(p + 24, 0);
+    if (info->format == WAVE_FORMAT_IMA_ADPCM)
+    {
+        put_u16(p + 24, 2);
+        put_u16(p + 26, (unsigned)info->samples_per_block);
+    }
+    p += 8 + fmt_size;
+
+    if (has_fact)
+    {
+        memcpy(p, "fact", 4);
+        put_u32(p + 4, 4);
+        put_u32(p + 8, (uint32_t)frames);
+        p += 12;
+    }
+
+    memcpy(p, "data", 4);
+    put_u32(p + 4, (uint32_t)data_bytes);
+    return header_size;
+}
+
+// Walks the chunks up to "data". Sizes are left as the header states them.
+static int parse_header(FILE *file, WavInfo *info)
+{
+    uint8_t riff[12];
+    memset(info, 0, sizeof(*info));
+    info->fact_offset = -1;
+
+    if (fread(riff, 1, 12, file) != 12 || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0)
+        return -1;
+
+    int have_fmt = 0;
+    uint32_t fact_frames = 0;
+    while (1)
+    {
+        uint8_t chunk[8];
+        if (fread(chunk, 1, 8, file) != 8)
+            return -1;
+        uint32_t size = get_u32(chunk + 4);
+        long body = ftell(file);
+
+        if (memcmp(chunk, "fmt ", 4) == 0)
+        {
+            uint8_t fmt[20];
+            size_t want = size < sizeof(fmt) ? size : sizeof(fmt);
+            if (size < 16 || fread(fmt, 1, want, file) != want)
+                return -1;
+            info->format = (int)get_u16(fmt);
+            info->sample_rate = (int)get_u32(fmt + 4);
+            info->block_align = get_u16(fmt + 12);
+            info->bits_per_sample = (int)get_u16(fmt + 14);
+            if (get_u16(fmt + 2) != 1 || info->block_align == 0)
+                return -1;
+            if (info->format == WAVE_FORMAT_IMA_ADPCM)
+            {
+                if (want < 20 || info->block_align < 5)
+                    return -1;
+                info->samples_per_block = get_u16(fmt + 18);
+            }
+            else
+            {
+                info->samples_per_block = 1;
+            }
+            have_fmt = 1;
+        }
+        else if (memcmp(chunk, "fact", 4) == 0 && size >= 4)
+        {
+            uint8_t fact[4];
+            if (fread(fact, 1, 4, file) != 4)
+                return -1;
+            info->fact_offset = body;
+            fact_frames = get_u32(fact);
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            if (!have_fmt)
+                return -1;
+            info->data_offset = body;
+            info->data_bytes = size;
+            break;
+        }
+
+        if (fseek(file, body + size + (size & 1), SEEK_SET) != 0)
+            return -1;
+    }
+
+    switch (info->format)
+    {
+    case WAVE_FORMAT_PCM:
+        if (info->bits_per_sample != 16)
+            return -1;
+        info->frames = info->data_bytes / 2;
+        break;
+    case WAVE_FORMAT_MULAW:
+        info->frames = info->data_bytes;
+        break;
+    case WAVE_FORMAT_IMA_ADPCM:
+        info->frames = info->fact_offset >= 0 ? fact_frames : info->data_bytes / info->block_align * info->samples_per_block;
+        break;
+    default:
+        return -1;
+    }
+    return 0;
+}
 
 int write_wav_file(const char *filename, short *data, size_t numSamples, int sampleRate)
 {
@@ -30,25 +224,305 @@ int write_wav_file(const char *filename, short *data, size_t numSamples, int sam
         return -1;
     }
 
-    WAVHeader header;
-    memcpy(header.chunkID, "RIFF", 4);
-    memcpy(header.format, "WAVE", 4);
-    memcpy(header.subchunk1ID, "fmt ", 4);
-    memcpy(header.subchunk2ID, "data", 4);
+    WavInfo info;
+    uint8_t header[WAV_MAX_HEADER];
+    describe_encoding(WAV_ENCODING_PCM, sampleRate, &info);
+    size_t header_size = build_header(header, &info, numSamples, numSamples * sizeof(short));
 
-    header.subchunk1Size = 16;
-    header.audioFormat = 1;
-    header.numChannels = 1;
-    header.sampleRate = sampleRate;
-    header.bitsPerSample = 16;
-    header.blockAlign = (header.numChannels * header.bitsPerSample) / 8;
-    header.byteRate = header.sampleRate * header.blockAlign;
-    header.subchunk2Size = numSamples * sizeof(short);
-    header.chunkSize = 36 + header.subchunk2Size;
-
-    fwrite(&header, sizeof(WAVHeader), 1, file);
+    fwrite(header, 1, header_size, file);
     fwrite(data, sizeof(short), numSamples, file);
 
     fclose(file);
     return 0;
 }
+
+WavEncoding wav_encoding_from_name(const char *name)
+{
+    if (strcmp(name, "mulaw") == 0)
+        return WAV_ENCODING_MULAW;
+    if (strcmp(name, "adpcm") == 0)
+        return WAV_ENCODING_IMA_ADPCM;
+    if (strcmp(name, "pcm") != 0)
+        fprintf(stderr, "Unknown WAV format \"%s\", writing PCM\n", name);
+    return WAV_ENCODING_PCM;
+}
+
+static int write_header(WavWriter *writer)
+{
+    WavInfo info;
+    uint8_t header[WAV_MAX_HEADER];
+    describe_encoding(writer->encoding, writer->sample_rate, &info);
+    size_t header_size = build_header(header, &info, writer->frames, writer->data_bytes);
+    return fwrite(header, 1, header_size, writer->file) == header_size ? 0 : -1;
+}
+
+int wav_writer_open(WavWriter *writer, const char *filename, int sampleRate, WavEncoding encoding)
+{
+    memset(writer, 0, sizeof(*writer));
+    snprintf(writer->final_path, sizeof(writer->final_path), "%s", filename);
+    snprintf(writer->part_path, sizeof(writer->part_path), "%s%s", filename, WAV_PART_SUFFIX);
+    writer->sample_rate = sampleRate;
+    writer->encoding = encoding;
+
+    if (encoding == WAV_ENCODING_IMA_ADPCM)
+    {
+        writer->block_align = adpcm_block_align(sampleRate);
+        writer->samples_per_block = ima_adpcm_samples_per_block(writer->block_align);
+    }
+
+    writer->file = fopen(writer->part_path, "wb");
+    if (!writer->file)
+    {
+        fprintf(stderr, "Error: Could not open file for writing: %s\n", writer->part_path);
+        return -1;
+    }
+    setvbuf(writer->file, NULL, _IOFBF, WAV_WRITER_BUFFER_SIZE);
+
+    // Sizes are placeholders until finalize; wav_file_repair() fixes them after a crash
+    if (write_header(writer) != 0)
+    {
+        fprintf(stderr, "Error: Could not write WAV header: %s\n", writer->part_path);
+        fclose(writer->file);
+        remove(writer->part_path);
+        writer->file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static int write_adpcm_block(WavWriter *writer)
+{
+    ima_adpcm_encode_block(&writer->adpcm, writer->pending, writer->samples_per_block, writer->encoded);
+    if (fwrite(writer->encoded, 1, writer->block_align, writer->file) != writer->block_align)
+        return -1;
+    writer->data_bytes += writer->block_align;
+    writer->pending_count = 0;
+    return 0;
+}
+
+int wav_writer_append(WavWriter *writer, const short *data, size_t numSamples)
+{
+    if (!writer->file)
+        return -1;
+
+    size_t done = 0;
+    int result = 0;
+    switch (writer->encoding)
+    {
+    case WAV_ENCODING_MULAW:
+        while (done < numSamples)
+        {
+            size_t count = numSamples - done < sizeof(writer->encoded) ? numSamples - done : sizeof(writer->encoded);
+            mulaw_encode(data + done, count, writer->encoded);
+            size_t written = fwrite(writer->encoded, 1, count, writer->file);
+            writer->data_bytes += written;
+            done += written;
+            if (written != count)
+            {
+                result = -1;
+                break;
+            }
+        }
+        break;
+
+    case WAV_ENCODING_IMA_ADPCM:
+        // Samples wait in pending until a whole block can be encoded
+        while (done < numSamples)
+        {
+            size_t count = writer->samples_per_block - writer->pending_count;
+            if (count > numSamples - done)
+                count = numSamples - done;
+            memcpy(writer->pending + writer->pending_count, data + done, count * sizeof(short));
+            writer->pending_count += count;
+            done += count;
+
+            if (writer->pending_count == writer->samples_per_block && write_adpcm_block(writer) != 0)
+            {
+                result = -1;
+                break;
+            }
+        }
+        break;
+
+    default:
+        done = fwrite(data, sizeof(short), numSamples, writer->file);
+        writer->data_bytes += done * sizeof(short);
+        if (done != numSamples)
+            result = -1;
+        break;
+    }
+
+    writer->frames += done;
+    if (result != 0)
+        fprintf(stderr, "Error: Short write to %s\n", writer->part_path);
+    return result;
+}
+
+// Patches the RIFF and data sizes but leaves the file at its .part name, for
+// callers that publish it themselves once a later stage is done with it
+int wav_writer_close(WavWriter *writer)
+{
+    if (!writer->file)
+        return -1;
+
+    int result = 0;
+
+    // The last ADPCM block is padded with its final sample; the fact chunk
+    // keeps the true length so players stop before the padding
+    if (writer->encoding == WAV_ENCODING_IMA_ADPCM && writer->pending_count > 0)
+    {
+        short last = writer->pending[writer->pending_count - 1];
+        for (size_t i = writer->pending_count; i < writer->samples_per_block; i++)
+            writer->pending[i] = last;
+        if (write_adpcm_block(writer) != 0)
+            result = -1;
+    }
+
+    if (fseek(writer->file, 0, SEEK_SET) != 0 || write_header(writer) != 0)
+    {
+        fprintf(stderr, "Error: Could not update WAV header: %s\n", writer->part_path);
+        result = -1;
+    }
+
+    if (fclose(writer->file) != 0)
+        result = -1;
+    writer->file = NULL;
+    return result;
+}
+
+// Patches the RIFF and data sizes and moves the file to its final name
+int wav_writer_finalize(WavWriter *writer)
+{
+    int result = wav_writer_close(writer);
+    if (result == 0 && rename(writer->part_path, writer->final_path) != 0)
+    {
+        fprintf(stderr, "Error: Could not rename %s to %s\n", writer->part_path, writer->final_path);
+        result = -1;
+    }
+    return result;
+}
+
+void wav_writer_discard(WavWriter *writer)
+{
+    if (!writer->file)
+        return;
+
+    fclose(writer->file);
+    writer->file = NULL;
+    remove(writer->part_path);
+}
+
+// Rewrites the header of an interrupted recording from the file length.
+// Returns the number of recovered samples, or -1 if the file is not a WAV.
+long wav_file_repair(const char *filename)
+{
+    FILE *file = fopen(filename, "r+b");
+    if (!file)
+        return -1;
+
+    WavInfo info;
+    if (parse_header(file, &info) != 0 || fseek(file, 0, SEEK_END) != 0)
+    {
+        fclose(file);
+        return -1;
+    }
+    long length = ftell(file);
+    if (length < info.data_offset)
+    {
+        fclose(file);
+        return -1;
+    }
+
+    // Only whole samples, or whole ADPCM blocks, are kept
+    size_t data_bytes = (size_t)(length - info.data_offset);
+    data_bytes -= data_bytes % info.block_align;
+    size_t frames = data_bytes / info.block_align * info.samples_per_block;
+
+    uint8_t header[WAV_MAX_HEADER];
+    size_t header_size = build_header(header, &info, frames, data_bytes);
+
+    int ok = (long)header_size == info.data_offset &&
+             fseek(file, 0, SEEK_SET) == 0 && fwrite(header, 1, header_size, file) == header_size;
+    if (fclose(file) != 0 || !ok)
+        return -1;
+
+    // Drop a trailing partial sample or block so the file length matches the header
+    if ((long)(info.data_offset + data_bytes) != length)
+        truncate(filename, info.data_offset + data_bytes);
+
+    return (long)frames;
+}
+
+// Length and rate of a mono PCM, mu-law or IMA ADPCM file
+int wav_file_info(const char *filename, size_t *numSamples, int *sampleRate)
+{
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+        return -1;
+
+    WavInfo info;
+    int result = parse_header(file, &info);
+    fclose(file);
+    if (result != 0)
+        return -1;
+
+    *numSamples = info.frames;
+    *sampleRate = info.sample_rate;
+    return 0;
+}
+
+// Loads and decodes the samples of a mono file into a malloc'd buffer
+short *wav_file_read(const char *filename, size_t *numSamples, int *sampleRate)
+{
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+        return NULL;
+
+    WavInfo info;
+    if (parse_header(file, &info) != 0)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    size_t blocks = info.data_bytes / info.block_align;
+    size_t capacity = blocks * info.samples_per_block;
+    short *samples = malloc(capacity > 0 ? capacity * sizeof(short) : 1);
+    uint8_t *encoded = malloc(info.data_bytes > 0 ? info.data_bytes : 1);
+    if (!samples || !encoded)
+    {
+        free(samples);
+        free(encoded);
+        fclose(file);
+        return NULL;
+    }
+
+    size_t bytes = fread(encoded, 1, info.data_bytes, file);
+    fclose(file);
+    blocks = bytes / info.block_align;
+
+    size_t count;
+    switch (info.format)
+    {
+    case WAVE_FORMAT_MULAW:
+        count = blocks;
+        mulaw_decode(encoded, count, samples);
+        break;
+    case WAVE_FORMAT_IMA_ADPCM:
+        for (size_t b = 0; b < blocks; b++)
+            ima_adpcm_decode_block(encoded + b * info.block_align, info.samples_per_block, samples + b * info.samples_per_block);
+        count = blocks * info.samples_per_block;
+        if (count > info.frames)
+            count = info.frames;
+        break;
+    default:
+        count = blocks;
+        memcpy(samples, encoded, count * sizeof(short));
+        break;
+    }
+
+    free(encoded);
+    *numSamples = count;
+    *sampleRate = info.sample_rate;
+    return samples;
+}